@@ -40,14 +40,209 @@
 
 #include "FreeImage.h"
 #include "Exceptions.h"
-
+#include "encodePolicy.h"
+#include "imageArchive.h"
+#include "imageBufferPool.h"
+#include "imageView.h"
+#include "mappedFile.h"
+#include "pnmCodec.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
 #include <string>
+#include <system_error>
 #include <tuple>
 #include <memory>
+#include <vector>
 #include "/usr/include/string.h"
 
 namespace npp {
 
+// How JPEG files are decoded: with the fast integer IDCT instead of the
+// accurate one, and reduced to 1/2, 1/4 or 1/8 of their size in the DCT
+// domain, which skips most of the decoding work. Other formats are always
+// decoded in full.
+struct DecodeOptions {
+    bool bFast = false;
+    // 1, 2, 4 or 8
+    int nScaleDenominator = 1;
+};
+
+// An image the filters write their result into, encoded to its file by
+// save(). Binary netpbm results are mapped from the file directly; anything
+// else goes into a FreeImage bitmap, as do results for an image archive.
+// The filters leave the channels in the order of the source, so a result
+// whose pixels are laid out otherwise, RGB in a netpbm file against BGR in
+// a bitmap, has its red and blue swapped before it is written.
+class NppResultImage {
+        FIBITMAP *m_pBitmap = NULL;
+        PnmImage m_oPnm;
+        FREE_IMAGE_FORMAT m_eFormat = FIF_UNKNOWN;
+        int m_nFlags = 0;
+        // whether the colour pixels are BGR(A): the filters write them in
+        // the order of the source, toBitmapOrder() may swap them
+        bool m_bBgr = false;
+        // the rows of the netpbm result converted to RGB already
+        int m_nSwappedRows = 0;
+
+        void unload() {
+            if (m_pBitmap != NULL) {
+                FreeImage_Unload(m_pBitmap);
+                m_pBitmap = NULL;
+            }
+        }
+
+        // The bitmap to encode: transcoding colour with alpha into a format
+        // without it, e.g. JPEG or PPM, drops the alpha channel. A converted
+        // copy is unloaded by the caller.
+        FIBITMAP *
+        exportBitmap() const {
+            NPP_ASSERT_NOT_NULL(m_pBitmap);
+            if (FreeImage_FIFSupportsExportBPP(m_eFormat,
+                                               FreeImage_GetBPP(m_pBitmap))) {
+                return m_pBitmap;
+            }
+            FIBITMAP *pBitmap = FreeImage_ConvertTo24Bits(m_pBitmap);
+            NPP_ASSERT_NOT_NULL(pBitmap);
+            return pBitmap;
+        }
+
+        // Swap red and blue of the bitmap if the filters wrote them in the
+        // other order than FreeImage reads them
+        void
+        toBitmapOrder() {
+            const ImageView oView = bitmapView(m_pBitmap);
+            if (oView.nChannels >= 3 && m_bBgr != bitmapIsBgr()) {
+                SwapRedBlue(oView, 0, oView.nHeight);
+                m_bBgr = !m_bBgr;
+            }
+        }
+
+ public:
+        NppResultImage() {}
+        NppResultImage(const NppResultImage &) = delete;
+        NppResultImage &operator=(const NppResultImage &) = delete;
+
+        ~NppResultImage() { unload(); }
+
+        // FreeImage keeps colour pixels in the byte order of the platform,
+        // BGR(A) on little-endian machines; netpbm files hold RGB
+        static bool
+        bitmapIsBgr() {
+            return FI_RGBA_RED == 2;
+        }
+
+        // Top-down view of the rows of a FreeImage bitmap
+        static ImageView
+        bitmapView(FIBITMAP *pBitmap) {
+            ImageView oView;
+            oView.nWidth = FreeImage_GetWidth(pBitmap);
+            oView.nHeight = FreeImage_GetHeight(pBitmap);
+            oView.nChannels = FreeImage_GetBPP(pBitmap) / 8;
+            oView.nPitch = -static_cast<Npp32s>(FreeImage_GetPitch(pBitmap));
+            oView.pData = reinterpret_cast<Npp8u *>(FreeImage_GetBits(pBitmap))
+                          - oView.nPitch * static_cast<ptrdiff_t>(
+                              oView.nHeight - 1);
+            return oView;
+        }
+
+        // An empty rFileName keeps the result in memory until it is saved
+        // into an archive. bSourceBgr tells the channel order of the
+        // source the result is filtered from.
+        ImageView
+        create(const std::string &rFileName, FREE_IMAGE_FORMAT eFormat,
+               int nBitDepth, int nWidth, int nHeight, int nFlags = 0,
+               bool bSourceBgr = bitmapIsBgr()) {
+            unload();
+            m_eFormat = eFormat;
+            m_nFlags = nFlags;
+            m_bBgr = nBitDepth >= 24 && bSourceBgr;
+            m_nSwappedRows = 0;
+            if (rFileName.empty()) {
+                m_pBitmap = FreeImage_Allocate(nWidth, nHeight, nBitDepth);
+                NPP_ASSERT_NOT_NULL(m_pBitmap);
+                return bitmapView(m_pBitmap);
+            }
+            // replace an earlier result instead of writing into it, it may
+            // be a hard link into the result cache
+            std::error_code oError;
+            std::filesystem::remove(rFileName, oError);
+            if ((eFormat == FIF_PGMRAW || eFormat == FIF_PPMRAW) &&
+                (nBitDepth == 8 || nBitDepth == 24)) {
+                m_oPnm.Create(rFileName, nWidth, nHeight, nBitDepth / 8);
+                return m_oPnm.view();
+            }
+            m_pBitmap = FreeImage_Allocate(nWidth, nHeight, nBitDepth);
+            NPP_ASSERT_NOT_NULL(m_pBitmap);
+            return bitmapView(m_pBitmap);
+        }
+
+        // the rows above nRow are written and no longer needed in memory
+        void
+        releaseRows(int nRow) {
+            if (m_oPnm.isOpen() && m_bBgr && nRow > m_nSwappedRows) {
+                SwapRedBlue(m_oPnm.view(), m_nSwappedRows, nRow);
+                m_nSwappedRows = nRow;
+            }
+            m_oPnm.ReleaseRows(nRow);
+        }
+
+        void
+        save(const std::string &rFileName) {
+            if (m_oPnm.isOpen()) {
+                // the samples are in the file already
+                if (m_bBgr) {
+                    SwapRedBlue(m_oPnm.view(), m_nSwappedRows,
+                                m_oPnm.view().nHeight);
+                }
+                m_oPnm.Commit();
+                return;
+            }
+            toBitmapOrder();
+            FIBITMAP *pBitmap = exportBitmap();
+            bool bSuccess =
+                FreeImage_Save(m_eFormat, pBitmap, rFileName.c_str(),
+                               m_nFlags) == TRUE;
+            if (pBitmap != m_pBitmap) {
+                FreeImage_Unload(pBitmap);
+            }
+            NPP_ASSERT_MSG(bSuccess, "Failed to save result image.");
+        }
+
+        // Add the result to pArchive as rName instead of saving it to a
+        // file: binary netpbm results as raw pixels, which are filtered
+        // without decoding when the archive is read, anything else encoded.
+        // Returns the bytes stored.
+        size_t
+        save(ImageArchiveWriter *pArchive, const std::string &rName) {
+            NPP_ASSERT_NOT_NULL(m_pBitmap);
+            if (m_eFormat == FIF_PGMRAW || m_eFormat == FIF_PPMRAW) {
+                return pArchive->AddRaw(rName, bitmapView(m_pBitmap), m_bBgr);
+            }
+            toBitmapOrder();
+            FIBITMAP *pBitmap = exportBitmap();
+            std::unique_ptr<FIMEMORY, decltype(&FreeImage_CloseMemory)>
+                pMemory(FreeImage_OpenMemory(), &FreeImage_CloseMemory);
+            NPP_ASSERT_NOT_NULL(pMemory.get());
+            bool bSuccess = FreeImage_SaveToMemory(m_eFormat, pBitmap,
+                                                   pMemory.get(),
+                                                   m_nFlags) == TRUE;
+            const int nBitDepth = FreeImage_GetBPP(pBitmap);
+            if (pBitmap != m_pBitmap) {
+                FreeImage_Unload(pBitmap);
+            }
+            BYTE *pData = NULL;
+            DWORD nSize = 0;
+            bSuccess = bSuccess && FreeImage_AcquireMemory(pMemory.get(),
+                                                           &pData, &nSize);
+            NPP_ASSERT_MSG(bSuccess, "Failed to save result image.");
+            return pArchive->Add(rName, pData, nSize,
+                                 FreeImage_GetWidth(m_pBitmap),
+                                 FreeImage_GetHeight(m_pBitmap), nBitDepth);
+        }
+};
+
 class NppRetrieveImage{
         // Error handler for FreeImage library.
         //  In case this handler is invoked, it throws an NPP exception.
@@ -56,20 +251,64 @@ class NppRetrieveImage{
             throw npp::Exception(zMessage);
         }
 
-        FIBITMAP *m_pBitmap;
-        std::unique_ptr<ImageCPU_8u_C1> p_oImageC1;
-        std::unique_ptr<ImageCPU_8u_C2> p_oImageC2;
-        std::unique_ptr<ImageCPU_8u_C3> p_oImageC3;
-        std::unique_ptr<ImageCPU_8u_C4> p_oImageC4;
+        FIBITMAP *m_pBitmap = NULL;
+        // result written by the filters in place, see resultView()
+        NppResultImage m_oResult;
+        // P5/P6 files bypass FreeImage and are mapped instead
+        PnmImage m_oPnmSource;
+        // raw pixels of an image archive, used where they are
+        ImageView m_oRawSource;
+        std::unique_ptr<ImagePooledCPU_8u_C1> p_oImageC1;
+        std::unique_ptr<ImagePooledCPU_8u_C2> p_oImageC2;
+        std::unique_ptr<ImagePooledCPU_8u_C3> p_oImageC3;
+        std::unique_ptr<ImagePooledCPU_8u_C4> p_oImageC4;
         FREE_IMAGE_FORMAT m_eFormat;
         std::string m_fileExt = "PGM";
         int m_bitDepth = 8;
+        // the decoded image is 1/m_nDecodeScale of the size of the file's
+        int m_nDecodeScale = 1;
+        // the file probeImageBytes() mapped for the ImageSetup() to follow
+        MappedFile m_oProbed;
+        std::string m_sProbedName;
+
+        // FreeImage flags for a JPEG decode with rOptions. The size hint in
+        // the upper 16 bits makes the loader reduce the image by the largest
+        // of 1/2, 1/4 and 1/8 that keeps its longer side at least that long;
+        // *pnLongSide receives the longer side of the full image then.
+        static int
+        jpegLoadFlags(FIMEMORY *pMemory, const DecodeOptions &rOptions,
+                      int *pnLongSide) {
+            int nFlags = rOptions.bFast ? JPEG_FAST : JPEG_ACCURATE;
+            *pnLongSide = 0;
+            if (rOptions.nScaleDenominator > 1) {
+                // only the header is read to learn the size
+                FIBITMAP *pHeader = FreeImage_LoadFromMemory(
+                    FIF_JPEG, pMemory, FIF_LOAD_NOPIXELS);
+                FreeImage_SeekMemory(pMemory, 0, SEEK_SET);
+                NPP_ASSERT_NOT_NULL(pHeader);
+                *pnLongSide = static_cast<int>(
+                    std::max(FreeImage_GetWidth(pHeader),
+                             FreeImage_GetHeight(pHeader)));
+                FreeImage_Unload(pHeader);
+                const int nHint = std::min(
+                    std::max(*pnLongSide / rOptions.nScaleDenominator, 1),
+                    0xFFFF);
+                nFlags |= nHint << 16;
+            }
+            return nFlags;
+        }
 
- public:
-        // This function sets up the image bitmap and retrieves other
-        // properties such as bit depth and file extension
-        std::tuple<int, std::string> ImageSetup(const std::string &rFileName) {
-            m_eFormat = FreeImage_GetFileType(rFileName.c_str());
+        // Decode the nSize bytes of an image file named rFileName at pData
+        std::tuple<int, std::string> decodeMemory(
+                const unsigned char *pData, size_t nSize,
+                const std::string &rFileName, const DecodeOptions &rOptions) {
+            // FreeImage only reads from the memory, despite the signature
+            std::unique_ptr<FIMEMORY, decltype(&FreeImage_CloseMemory)>
+                pMemory(FreeImage_OpenMemory(const_cast<BYTE *>(pData),
+                                             static_cast<DWORD>(nSize)),
+                        &FreeImage_CloseMemory);
+            NPP_ASSERT_NOT_NULL(pMemory.get());
+            m_eFormat = FreeImage_GetFileTypeFromMemory(pMemory.get());
 
             // no signature? try to guess the file format from the file
             // extension
@@ -77,48 +316,170 @@ class NppRetrieveImage{
                 m_eFormat = FreeImage_GetFIFFromFilename(rFileName.c_str());
             }
 
-            m_fileExt = rFileName.substr(rFileName.find_last_of("."));
-
             NPP_ASSERT(m_eFormat != FIF_UNKNOWN);
             // check that the plugin has reading capabilities ...
 
+            int nFlags = 0;
+            int nLongSide = 0;
+            if (m_eFormat == FIF_JPEG) {
+                nFlags = jpegLoadFlags(pMemory.get(), rOptions, &nLongSide);
+            }
             if (FreeImage_FIFSupportsReading(m_eFormat)) {
-                m_pBitmap = FreeImage_Load(m_eFormat, rFileName.c_str());
+                m_pBitmap = FreeImage_LoadFromMemory(m_eFormat, pMemory.get(),
+                                                     nFlags);
             }
 
             NPP_ASSERT(m_pBitmap != 0);
 
             m_bitDepth = FreeImage_GetBPP(m_pBitmap);
 
-            switch (m_bitDepth) {
-            case 8:
-                p_oImageC1 = std::unique_ptr<ImageCPU_8u_C1>(
-                    new ImageCPU_8u_C1(FreeImage_GetWidth(m_pBitmap),
-                    FreeImage_GetHeight(m_pBitmap)));
-                break;
-            case 16:
-                p_oImageC2 = std::unique_ptr<ImageCPU_8u_C2>(
-                    new ImageCPU_8u_C2(FreeImage_GetWidth(m_pBitmap),
-                    FreeImage_GetHeight(m_pBitmap)));
-                break;
-            case 24:
-                p_oImageC3 = std::unique_ptr<ImageCPU_8u_C3>(
-                    new ImageCPU_8u_C3(FreeImage_GetWidth(m_pBitmap),
-                    FreeImage_GetHeight(m_pBitmap)));
-                break;
-            case 32:
-                p_oImageC4 = std::unique_ptr<ImageCPU_8u_C4>(new ImageCPU_8u_C4(
-                    FreeImage_GetWidth(m_pBitmap),
-                    FreeImage_GetHeight(m_pBitmap)));
-                break;
+            // libjpeg rounds the reduced size up
+            const int nDecodedLongSide = static_cast<int>(std::max(
+                FreeImage_GetWidth(m_pBitmap), FreeImage_GetHeight(m_pBitmap)));
+            for (int nScale = 8; nScale > 1 && nLongSide > 0; nScale /= 2) {
+                if ((nLongSide + nScale - 1) / nScale == nDecodedLongSide) {
+                    m_nDecodeScale = nScale;
+                    break;
+                }
+            }
 
-            default:
-                break;
+            return {m_bitDepth, m_fileExt};
+        }
+
+ public:
+        NppRetrieveImage() {}
+        NppRetrieveImage(const NppRetrieveImage &) = delete;
+        NppRetrieveImage &operator=(const NppRetrieveImage &) = delete;
+
+        ~NppRetrieveImage() {
+            if (m_pBitmap != NULL) {
+                FreeImage_Unload(m_pBitmap);
             }
+        }
+
+        static ImageView
+        bitmapView(FIBITMAP *pBitmap) {
+            return NppResultImage::bitmapView(pBitmap);
+        }
 
+        // The extension of rFileName, dot included, as ImageSetup() returns
+        // it
+        static std::string
+        fileExtension(const std::string &rFileName) {
+            return rFileName.substr(rFileName.find_last_of("."));
+        }
+
+        // The bytes of the pixels of the image in rFileName at full size,
+        // read from its header without decoding it, so that memory can be
+        // set aside before the decode; 0 when the header does not tell. The
+        // file stays mapped for the ImageSetup() of the same name.
+        size_t
+        probeImageBytes(const std::string &rFileName) {
+            m_oProbed.OpenRead(rFileName);
+            m_sProbedName = rFileName;
+            const unsigned char *pData = m_oProbed.data();
+            const size_t nSize = m_oProbed.size();
+            int nWidth = 0, nHeight = 0, nChannels = 0;
+            size_t nPos = 0;
+            if (PnmImage::ReadHeader(pData, nSize, &nWidth, &nHeight,
+                                     &nChannels, &nPos)) {
+                return static_cast<size_t>(nWidth) * nHeight * nChannels;
+            }
+            if (nSize == 0 || nSize > 0xFFFFFFFFu) {
+                return 0;
+            }
+            std::unique_ptr<FIMEMORY, decltype(&FreeImage_CloseMemory)>
+                pMemory(FreeImage_OpenMemory(const_cast<BYTE *>(pData),
+                                             static_cast<DWORD>(nSize)),
+                        &FreeImage_CloseMemory);
+            FREE_IMAGE_FORMAT eFormat = pMemory.get() != NULL
+                ? FreeImage_GetFileTypeFromMemory(pMemory.get())
+                : FIF_UNKNOWN;
+            if (eFormat == FIF_UNKNOWN) {
+                eFormat = FreeImage_GetFIFFromFilename(rFileName.c_str());
+            }
+            // plugins without header-only loading would decode it all
+            if (eFormat == FIF_UNKNOWN ||
+                !FreeImage_FIFSupportsNoPixels(eFormat)) {
+                return 0;
+            }
+            FIBITMAP *pHeader = FreeImage_LoadFromMemory(
+                eFormat, pMemory.get(), FIF_LOAD_NOPIXELS);
+            if (pHeader == NULL) {
+                return 0;
+            }
+            const size_t nBytes = static_cast<size_t>(
+                FreeImage_GetWidth(pHeader)) * FreeImage_GetHeight(pHeader) *
+                std::max<unsigned>(FreeImage_GetBPP(pHeader) / 8, 1);
+            FreeImage_Unload(pHeader);
+            return nBytes;
+        }
+
+        // This function sets up the image bitmap and retrieves other
+        // properties such as bit depth and file extension
+        std::tuple<int, std::string> ImageSetup(
+                const std::string &rFileName,
+                const DecodeOptions &rOptions = DecodeOptions()) {
+            m_fileExt = fileExtension(rFileName);
+
+            // the file is opened and read once: the type check and the
+            // decoder both read from the mapping, which probeImageBytes()
+            // may have made already
+            MappedFile oInput;
+            if (m_oProbed.isOpen() && m_sProbedName == rFileName) {
+                oInput = std::move(m_oProbed);
+            } else {
+                oInput.OpenRead(rFileName);
+            }
+            m_oProbed.Close();
+            NPP_ASSERT_MSG(oInput.size() > 0 && oInput.size() <= 0xFFFFFFFFu,
+                           "Image file empty or too large for FreeImage");
+
+            // binary netpbm files are used as they are on disk
+            if (PnmImage::IsPnmFileName(rFileName) &&
+                m_oPnmSource.Open(&oInput, rFileName)) {
+                const int nChannels = m_oPnmSource.view().nChannels;
+                m_eFormat = nChannels == 1 ? FIF_PGMRAW : FIF_PPMRAW;
+                m_bitDepth = 8 * nChannels;
+                return {m_bitDepth, m_fileExt};
+            }
+            return decodeMemory(oInput.data(), oInput.size(), rFileName,
+                                rOptions);
+        }
+
+        // The same for an image of an archive, which is named after its
+        // entry. Raw entries need no decoding; their results take the format
+        // their name suggests, raw PGM or PPM for netpbm names.
+        std::tuple<int, std::string> ImageSetup(
+                const ImageArchive &rArchive, const ArchiveEntry &rEntry,
+                const DecodeOptions &rOptions = DecodeOptions()) {
+            m_fileExt = fileExtension(rEntry.sName);
+            if (!rEntry.bRaw) {
+                NPP_ASSERT_MSG(rEntry.nSize > 0 &&
+                                   rEntry.nSize <= 0xFFFFFFFFu,
+                               "Image file empty or too large for FreeImage");
+                return decodeMemory(rArchive.data(rEntry), rEntry.nSize,
+                                    rEntry.sName, rOptions);
+            }
+            NPP_ASSERT_MSG(rEntry.nBitDepth == 8 || rEntry.nBitDepth == 24 ||
+                               rEntry.nBitDepth == 32,
+                           "Unsupported image bit depth");
+            m_oRawSource = rArchive.view(rEntry);
+            m_bitDepth = rEntry.nBitDepth;
+            m_eFormat = FreeImage_GetFIFFromFilename(rEntry.sName.c_str());
+            if (m_eFormat == FIF_UNKNOWN ||
+                PnmImage::IsPnmFileName(rEntry.sName)) {
+                m_eFormat = m_bitDepth == 8 ? FIF_PGMRAW : FIF_PPMRAW;
+            }
             return {m_bitDepth, m_fileExt};
         }
 
+        // 2, 4 or 8 when ImageSetup() decoded a reduced image, otherwise 1
+        int
+        decodeScale() const {
+            return m_nDecodeScale;
+        }
+
         // Load a * channel gray-scale/color image from disk.
         void
         loadImage(void *rImage, int nbitDepth) {
@@ -131,11 +492,11 @@ class NppRetrieveImage{
             // swap the user given image with our result image, effecively
             // moving our newly loaded image data into the user provided shell
             if (nbitDepth == 8) {
-                p_oImageC1->swap(*(reinterpret_cast<ImageCPU_8u_C1 *>(rImage)));
+                p_oImageC1->swap(*(reinterpret_cast<ImagePooledCPU_8u_C1 *>(rImage)));
             } else if (nbitDepth == 24) {
-                p_oImageC3->swap(*(reinterpret_cast<ImageCPU_8u_C3 *>(rImage)));
+                p_oImageC3->swap(*(reinterpret_cast<ImagePooledCPU_8u_C3 *>(rImage)));
             } else if (nbitDepth == 32) {
-                p_oImageC4->swap(*(reinterpret_cast<ImageCPU_8u_C4 *>(rImage)));
+                p_oImageC4->swap(*(reinterpret_cast<ImagePooledCPU_8u_C4 *>(rImage)));
             }
         }
 
@@ -146,7 +507,7 @@ class NppRetrieveImage{
             switch (nbitDepth) {
             case 8:
             {
-                ImageCPU_8u_C1 oImage;
+                ImagePooledCPU_8u_C1 oImage;
                 loadImage(&oImage, nbitDepth);
                 ImageNPP_8u_C1 oResult(oImage);
                 (reinterpret_cast<ImageNPP_8u_C1 *>(rImage))->swap(oResult);
@@ -154,7 +515,7 @@ class NppRetrieveImage{
                 break;
             case 16:
             {
-                ImageCPU_8u_C2 oImage;
+                ImagePooledCPU_8u_C2 oImage;
                 loadImage(&oImage, nbitDepth);
                 ImageNPP_8u_C2 oResult(oImage);
                 (reinterpret_cast<ImageNPP_8u_C2 *>(rImage))->swap(oResult);
@@ -162,7 +523,7 @@ class NppRetrieveImage{
                 break;
             case 24:
             {
-                ImageCPU_8u_C3 oImage;
+                ImagePooledCPU_8u_C3 oImage;
                 loadImage(&oImage, nbitDepth);
                 ImageNPP_8u_C3 oResult(oImage);
                 (reinterpret_cast<ImageNPP_8u_C3 *>(rImage))->swap(oResult);
@@ -170,7 +531,7 @@ class NppRetrieveImage{
                 break;
             case 32:
             {
-                ImageCPU_8u_C4 oImage;
+                ImagePooledCPU_8u_C4 oImage;
                 loadImage(&oImage, nbitDepth);
                 ImageNPP_8u_C4 oResult(oImage);
                 (reinterpret_cast<ImageNPP_8u_C4 *>(rImage))->swap(oResult);
@@ -191,16 +552,34 @@ class NppRetrieveImage{
     // set your own FreeImage error handler
     FreeImage_SetOutputMessage(FreeImageErrorHandler);
 
-    // make sure this is an 8-bit single channel image
-    NPP_ASSERT(FreeImage_GetColorType(
-                   m_pBitmap) == (nbitDepth == 8 ? FIC_MINISBLACK : FIC_RGB));
+    // the decoded rows, from a FreeImage bitmap or a mapped netpbm file
+    ImageView oSrc = sourceView();
+    NPP_ASSERT(oSrc.nChannels == nBytesPerPixel);
 
-    // Copy the FreeImage data into the new ImageCPU
-    // std::cout << "Did FreeImage_Load " << std::endl;
-    unsigned int nSrcPitch = FreeImage_GetPitch(m_pBitmap);
-    const Npp8u *pSrcLine = reinterpret_cast<Npp8u *>(
-                                FreeImage_GetBits(m_pBitmap)) +
-                            nSrcPitch * (FreeImage_GetHeight(m_pBitmap) - 1);
+    switch (nbitDepth) {
+    case 8:
+        p_oImageC1 = std::unique_ptr<ImagePooledCPU_8u_C1>(
+            new ImagePooledCPU_8u_C1(oSrc.nWidth, oSrc.nHeight));
+        break;
+    case 16:
+        p_oImageC2 = std::unique_ptr<ImagePooledCPU_8u_C2>(
+            new ImagePooledCPU_8u_C2(oSrc.nWidth, oSrc.nHeight));
+        break;
+    case 24:
+        p_oImageC3 = std::unique_ptr<ImagePooledCPU_8u_C3>(
+            new ImagePooledCPU_8u_C3(oSrc.nWidth, oSrc.nHeight));
+        break;
+    case 32:
+        p_oImageC4 = std::unique_ptr<ImagePooledCPU_8u_C4>(
+            new ImagePooledCPU_8u_C4(oSrc.nWidth, oSrc.nHeight));
+        break;
+
+    default:
+        break;
+    }
+
+    // Copy the source rows into the new ImageCPU
+    const Npp8u *pSrcLine = oSrc.pData;
 
     Npp8u *pDstLine = NULL;
     unsigned int nDstPitch = -1;
@@ -239,18 +618,85 @@ class NppRetrieveImage{
 
     for (size_t iLine = 0; iLine < nHeight; ++iLine) {
         memcpy(pDstLine, pSrcLine, nWidth * sizeof(Npp8u) * nBytesPerPixel);
-        pSrcLine -= nSrcPitch;
+        pSrcLine += oSrc.nPitch;
         pDstLine += nDstPitch;
     }
 }
 
+        // Whether the colour channels of sourceView() are in BGR order: in
+        // a FreeImage bitmap they may be, netpbm files hold RGB
+        bool
+        sourceIsBgr() const {
+            return !m_oPnmSource.isOpen() && m_oRawSource.pData == NULL &&
+                   NppResultImage::bitmapIsBgr();
+        }
+
+        // The decoded pixels in place, without copying them out of the
+        // FreeImage bitmap, the mapped file or the archive
+        ImageView
+        sourceView() {
+            if (m_oPnmSource.isOpen()) {
+                return m_oPnmSource.view();
+            }
+            if (m_oRawSource.pData != NULL) {
+                return m_oRawSource;
+            }
+            NPP_ASSERT_MSG(m_bitDepth == 8 || m_bitDepth == 24 ||
+                           m_bitDepth == 32, "Unsupported image bit depth");
+            // 32-bit bitmaps are RGBA, or RGB with an unused fourth byte
+            const FREE_IMAGE_COLOR_TYPE eColorType =
+                FreeImage_GetColorType(m_pBitmap);
+            NPP_ASSERT(m_bitDepth == 8 ? eColorType == FIC_MINISBLACK
+                                       : (eColorType == FIC_RGB ||
+                                          (m_bitDepth == 32 &&
+                                           eColorType == FIC_RGBALPHA)));
+            return bitmapView(m_pBitmap);
+        }
+
+        // Prepare the image the filters write their result into, with the
+        // bit depth of the source and the format rPolicy picks for it.
+        // Binary netpbm results are mapped from rFileName directly; anything
+        // else goes into a bitmap that saveResult() encodes.
+        ImageView
+        resultView(const std::string &rFileName, int nWidth, int nHeight,
+                   const EncodePolicy &rPolicy = EncodePolicy()) {
+            return resultView(&m_oResult, rFileName, nWidth, nHeight,
+                              rPolicy);
+        }
+
+        // The same for a separate result, so several results can be
+        // filtered from one decoded image and saved independently
+        ImageView
+        resultView(NppResultImage *pResult, const std::string &rFileName,
+                   int nWidth, int nHeight,
+                   const EncodePolicy &rPolicy = EncodePolicy()) {
+            return pResult->create(rFileName,
+                                   rPolicy.Format(m_eFormat, m_bitDepth),
+                                   m_bitDepth, nWidth, nHeight,
+                                   rPolicy.Flags(), sourceIsBgr());
+        }
+
+        // Strip processing no longer needs the source rows above nSourceRow
+        // and the result rows above nResultRow; mapped files give their
+        // memory back, so the footprint does not grow with the image height
+        void
+        releaseRows(int nSourceRow, int nResultRow) {
+            m_oPnmSource.ReleaseRows(nSourceRow);
+            m_oResult.releaseRows(nResultRow);
+        }
+
+        void
+        saveResult(const std::string &rFileName) {
+            m_oResult.save(rFileName);
+        }
+
         //******************************************************************************//
         //******************************************************************************//
 
         // Save a gray-scale image to disk.
         void
         saveImage(const std::string &rFileName, const ImageNPP_8u_C1 &rImage) {
-            ImageCPU_8u_C1 oHostImage(rImage.size());
+            ImagePooledCPU_8u_C1 oHostImage(rImage.size());
             // copy the device result data
             rImage.copyTo(oHostImage.data(), oHostImage.pitch());
             saveImage(
@@ -261,7 +707,7 @@ class NppRetrieveImage{
         // Save an 3 channel color image to disk.
         void
         saveImage(const std::string &rFileName, const ImageNPP_8u_C3 &rImage) {
-            ImageCPU_8u_C3 oHostImage(rImage.size());
+            ImagePooledCPU_8u_C3 oHostImage(rImage.size());
             // copy the device result data
             rImage.copyTo(oHostImage.data(), oHostImage.pitch());
             saveImage(
@@ -272,7 +718,7 @@ class NppRetrieveImage{
         // Save a 4 channel color image to disk.
         void
         saveImage(const std::string &rFileName, const ImageNPP_8u_C4 &rImage) {
-            ImageCPU_8u_C4 oHostImage(rImage.size());
+            ImagePooledCPU_8u_C4 oHostImage(rImage.size());
             // copy the device result data
             rImage.copyTo(oHostImage.data(), oHostImage.pitch());
             saveImage(
@@ -309,6 +755,7 @@ class NppRetrieveImage{
             bSuccess =
             FreeImage_Save(m_eFormat, pResultBitmap, rFileName.c_str(), 0) ==
                 TRUE;
+            FreeImage_Unload(pResultBitmap);
             NPP_ASSERT_MSG(bSuccess, "Failed to save result image.");
         }
 };
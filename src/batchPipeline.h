@@ -0,0 +1,617 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_BATCHPIPELINE_H_
+#define SRC_BATCHPIPELINE_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "boundedQueue.h"
+#include "imageArchive.h"
+#include "memoryBudget.h"
+#include "processImageNPP.h"
+#include "processingLog.h"
+#include "resultCache.h"
+
+// Number of worker threads of each pipeline stage
+struct BatchThreads {
+    int nDecode = 1;
+    int nFilter = 1;
+    int nEncode = 1;
+};
+
+// Maps an input file name and its extension to the result file name
+typedef std::function<std::string(const std::string &, const std::string &)>
+    ResultNameFunction;
+
+// Called with the record of every image once it is done
+typedef std::function<void(const ImageRecord &)> JobDoneFunction;
+
+// A filter applied to every image, with the names of its results
+struct BatchOutput {
+    NppProcessImage oProcessor;
+    ResultNameFunction fResultName;
+};
+
+// One image travelling through the pipeline
+struct BatchJob {
+    // file names, error, sizes and stage times for the log
+    ImageRecord oRecord;
+    // the image in the input archive, if it comes from one
+    const npp::ArchiveEntry *pEntry = NULL;
+    // decoded image, shared by the filters of all outputs
+    npp::NppRetrieveImage oImage;
+    // one result per output
+    std::vector<std::unique_ptr<npp::NppResultImage>> aResults;
+    // cache keys of the results, and which of them came from the cache
+    std::vector<std::string> aCacheKeys;
+    std::vector<char> aCached;
+    // the results of a job are encoded concurrently; the last encode to
+    // finish logs the job
+    std::atomic<int> nPendingEncodes{0};
+    // bytes of the decoded image, and of each result
+    size_t nImageBytes = 0;
+    // bytes charged to the memory budget and not released yet
+    size_t nBudgetBytes = 0;
+    // guards the error, the encode totals of the record and the budget
+    std::mutex oMutex;
+};
+
+// Processes a list of images with separate decode, filter and encode stages
+// connected by bounded queues, so reading, filtering and writing of different
+// files overlap and every stage can use several threads. With several
+// outputs every image is decoded once and filtered once per output, and its
+// results are encoded in parallel. With a batch size above 1 the filter
+// threads take several decoded images at a time and filter those of the same
+// shape in a single call, which pays off for many small images. The images
+// can come from an image archive instead of files, and the results can go
+// into one.
+class BatchPipeline {
+    typedef std::shared_ptr<BatchJob> BatchJobPtr;
+
+    // a filtered result on its way to the encoders
+    struct EncodeTask {
+        BatchJobPtr pJob;
+        size_t nOutput = 0;
+    };
+
+    std::vector<BatchOutput> m_aOutputs;
+    BatchThreads m_oThreads;
+    ResultCache *m_pCache = NULL;
+    JobDoneFunction m_fJobDone;
+    int m_nBatchSize = 1;
+    const npp::ImageArchive *m_pInputArchive = NULL;
+    // directory of the input archive, where results of its images go
+    std::string m_sInputArchiveDir;
+    npp::ImageArchiveWriter *m_pOutputArchive = NULL;
+    MemoryBudget *m_pBudget = NULL;
+
+    // Charge nBytes held by a job to the memory budget, if there is one
+    void Hold(BatchJob *pJob, size_t nBytes) {
+        if (m_pBudget == NULL) {
+            return;
+        }
+        m_pBudget->Charge(nBytes);
+        std::lock_guard<std::mutex> oLock(pJob->oMutex);
+        pJob->nBudgetBytes += nBytes;
+    }
+
+    // Reserve the memory a job will hold at most, estimated from the
+    // header of its image, before it is decoded: the decoded image, a result
+    // for every output not taken from the cache, and about as much as one
+    // result for the working buffers of the filters
+    void Reserve(BatchJob *pJob) {
+        if (m_pBudget == NULL) {
+            return;
+        }
+        const npp::ArchiveEntry *pEntry = pJob->pEntry;
+        const size_t nImageBytes =
+            pEntry != NULL ? static_cast<size_t>(pEntry->nWidth) *
+                                 pEntry->nHeight * (pEntry->nBitDepth / 8)
+                           : pJob->oImage.probeImageBytes(
+                                 pJob->oRecord.sFilename);
+        const size_t nBytes = Footprint(pJob, nImageBytes);
+        m_pBudget->Reserve(nBytes);
+        std::lock_guard<std::mutex> oLock(pJob->oMutex);
+        pJob->nBudgetBytes += nBytes;
+    }
+
+    size_t Footprint(const BatchJob *pJob, size_t nImageBytes) const {
+        const size_t nResults =
+            m_aOutputs.size() - std::count(pJob->aCached.begin(),
+                                           pJob->aCached.end(), 1);
+        return (2 + nResults) * nImageBytes;
+    }
+
+    // Give back the working bytes of the filters once nOutput, the last
+    // output of the job to filter, is done
+    void DropWorking(BatchJob *pJob, size_t nOutput) {
+        for (size_t k = nOutput + 1; k < m_aOutputs.size(); ++k) {
+            if (!pJob->aCached[k]) {
+                return;
+            }
+        }
+        Drop(pJob, pJob->nImageBytes);
+    }
+
+    // Give back nBytes of those, by default all that are left
+    void Drop(BatchJob *pJob, size_t nBytes = SIZE_MAX) {
+        if (m_pBudget == NULL) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> oLock(pJob->oMutex);
+            nBytes = std::min(nBytes, pJob->nBudgetBytes);
+            pJob->nBudgetBytes -= nBytes;
+        }
+        m_pBudget->Release(nBytes);
+    }
+
+    // The name the results of a job are named after: that of its file, or
+    // for an archive image that of a file next to the archive. Results
+    // going into an archive are named relative to the input directory.
+    std::string InputName(const BatchJob *pJob) const {
+        if (pJob->pEntry != NULL) {
+            return m_pOutputArchive != NULL
+                       ? pJob->pEntry->sName
+                       : m_sInputArchiveDir + pJob->pEntry->sName;
+        }
+        return m_pOutputArchive != NULL
+                   ? std::filesystem::path(pJob->oRecord.sFilename)
+                         .filename()
+                         .string()
+                   : pJob->oRecord.sFilename;
+    }
+
+    // Take the results of the job from the cache where it has them; true
+    // when it has all of them and the image need not be decoded
+    bool FetchCached(BatchJob *pJob) {
+        ImageRecord &rRecord = pJob->oRecord;
+        size_t nHits = 0;
+        // the input is hashed once, whatever the number of outputs
+        const uint64_t nContent = ResultCache::ContentHash(rRecord.sFilename);
+        for (size_t k = 0; k < m_aOutputs.size(); ++k) {
+            pJob->aCacheKeys[k] = ResultCache::Key(
+                nContent, m_aOutputs[k].oProcessor.SettingsJson());
+            if (m_pCache->Fetch(pJob->aCacheKeys[k],
+                                rRecord.aResultFilenames[k])) {
+                pJob->aCached[k] = 1;
+                rRecord.nBytesWritten +=
+                    std::filesystem::file_size(rRecord.aResultFilenames[k]);
+                nHits++;
+            }
+        }
+        rRecord.sCache = nHits == m_aOutputs.size() ? "hit"
+                         : nHits == 0              ? "miss"
+                                                   : "partial";
+        return nHits == m_aOutputs.size();
+    }
+
+    void Decode(BatchJob *pJob) {
+        ImageRecord &rRecord = pJob->oRecord;
+        StageClock oClock;
+        rRecord.nBytesRead =
+            pJob->pEntry != NULL
+                ? pJob->pEntry->nSize
+                : std::filesystem::file_size(rRecord.sFilename);
+        const std::string sInputName = InputName(pJob);
+        const std::string sFileExt =
+            npp::NppRetrieveImage::fileExtension(sInputName);
+        for (const BatchOutput &rOutput : m_aOutputs) {
+            rRecord.aResultFilenames.push_back(
+                rOutput.fResultName(
+                    sInputName,
+                    rOutput.oProcessor.GetEncodePolicy().Extension(sFileExt)));
+        }
+        const bool bCached = m_pCache != NULL && FetchCached(pJob);
+        rRecord.oTimings.dCheckMs = oClock.Lap();
+        if (bCached) {
+            return;
+        }
+        // the outputs share one decode and therefore its options
+        const npp::DecodeOptions &rOptions =
+            m_aOutputs[0].oProcessor.GetDecodeOptions();
+        if (m_pBudget != NULL) {
+            Reserve(pJob);
+            oClock.Lap();
+        }
+        auto [nBitDepth, sExt] =
+            pJob->pEntry != NULL
+                ? pJob->oImage.ImageSetup(*m_pInputArchive, *pJob->pEntry,
+                                          rOptions)
+                : pJob->oImage.ImageSetup(rRecord.sFilename, rOptions);
+        rRecord.oTimings.dDecodeMs = oClock.Lap();
+        rRecord.nBitDepth = nBitDepth;
+        rRecord.nDecodeScale = pJob->oImage.decodeScale();
+        NPP_ASSERT_MSG(nBitDepth == 8 || nBitDepth == 24 || nBitDepth == 32,
+                       "Unsupported image bit depth");
+        const npp::ImageView oSrc = pJob->oImage.sourceView();
+        pJob->nImageBytes =
+            static_cast<size_t>(oSrc.nWidth) * oSrc.nHeight * oSrc.nChannels;
+        if (m_pBudget == NULL) {
+            return;
+        }
+        // a reduced decode needs less than reserved; a header that gave no
+        // size, or too small a one, is made up for now
+        const size_t nFootprint = Footprint(pJob, pJob->nImageBytes);
+        size_t nReserved;
+        {
+            std::lock_guard<std::mutex> oLock(pJob->oMutex);
+            nReserved = pJob->nBudgetBytes;
+        }
+        if (nFootprint > nReserved) {
+            Hold(pJob, nFootprint - nReserved);
+        } else {
+            Drop(pJob, nReserved - nFootprint);
+        }
+    }
+
+    // The file result nOutput of a job is written to; none when the results
+    // go into an archive, they are kept in memory until then
+    std::string ResultFile(const BatchJob *pJob, size_t nOutput) const {
+        return m_pOutputArchive != NULL
+                   ? std::string()
+                   : pJob->oRecord.aResultFilenames[nOutput];
+    }
+
+    void Filter(NppProcessImage *pProcessor, BatchJob *pJob, size_t nOutput) {
+        npp::ImageView oSrc = pJob->oImage.sourceView();
+        pJob->oRecord.nWidth = oSrc.nWidth;
+        pJob->oRecord.nHeight = oSrc.nHeight;
+        pJob->aResults[nOutput].reset(new npp::NppResultImage);
+        npp::ImageView oDst = pJob->oImage.resultView(
+            pJob->aResults[nOutput].get(), ResultFile(pJob, nOutput),
+            oSrc.nWidth, oSrc.nHeight, pProcessor->GetEncodePolicy());
+        // a reduced decode is filtered with masks reduced alike
+        NppProcessImage oScaled;
+        if (pJob->oRecord.nDecodeScale > 1) {
+            oScaled = *pProcessor;
+            oScaled.ScaleDown(pJob->oRecord.nDecodeScale);
+            pProcessor = &oScaled;
+        }
+        pProcessor->SetTimings(&pJob->oRecord.oTimings);
+        // the source rows stay mapped while other outputs still read them
+        pProcessor->FilterImage(
+            m_aOutputs.size() == 1 ? &pJob->oImage : NULL, oSrc, oDst);
+        pProcessor->SetTimings(NULL);
+        DropWorking(pJob, nOutput);
+    }
+
+    void Encode(BatchJob *pJob, size_t nOutput) {
+        const std::string &rResultFilename =
+            pJob->oRecord.aResultFilenames[nOutput];
+        StageClock oClock;
+        if (m_pOutputArchive != NULL) {
+            const size_t nBytesWritten =
+                pJob->aResults[nOutput]->save(m_pOutputArchive,
+                                              rResultFilename);
+            pJob->aResults[nOutput].reset();
+            Drop(pJob, pJob->nImageBytes);
+            const double dEncodeMs = oClock.Lap();
+            std::lock_guard<std::mutex> oLock(pJob->oMutex);
+            pJob->oRecord.oTimings.dEncodeMs += dEncodeMs;
+            pJob->oRecord.nBytesWritten += nBytesWritten;
+            return;
+        }
+        pJob->aResults[nOutput]->save(rResultFilename);
+        pJob->aResults[nOutput].reset();
+        Drop(pJob, pJob->nImageBytes);
+        const double dEncodeMs = oClock.Lap();
+        const size_t nBytesWritten = std::filesystem::file_size(rResultFilename);
+        if (m_pCache != NULL) {
+            m_pCache->Store(pJob->aCacheKeys[nOutput], rResultFilename);
+        }
+
+        std::lock_guard<std::mutex> oLock(pJob->oMutex);
+        pJob->oRecord.oTimings.dEncodeMs += dEncodeMs;
+        pJob->oRecord.nBytesWritten += nBytesWritten;
+    }
+
+    // Filter the images of aJobs, which have the same shape, for output
+    // nOutput in one batch; each record gets an even share of the time
+    void FilterBatch(NppProcessImage *pProcessor,
+                     const std::vector<BatchJob *> &aJobs, size_t nOutput) {
+        std::vector<npp::ImageView> aSrc, aDst;
+        for (BatchJob *pJob : aJobs) {
+            npp::ImageView oSrc = pJob->oImage.sourceView();
+            pJob->oRecord.nWidth = oSrc.nWidth;
+            pJob->oRecord.nHeight = oSrc.nHeight;
+            pJob->aResults[nOutput].reset(new npp::NppResultImage);
+            aDst.push_back(pJob->oImage.resultView(
+                pJob->aResults[nOutput].get(), ResultFile(pJob, nOutput),
+                oSrc.nWidth, oSrc.nHeight, pProcessor->GetEncodePolicy()));
+            aSrc.push_back(oSrc);
+        }
+        NppProcessImage oScaled;
+        if (aJobs[0]->oRecord.nDecodeScale > 1) {
+            oScaled = *pProcessor;
+            oScaled.ScaleDown(aJobs[0]->oRecord.nDecodeScale);
+            pProcessor = &oScaled;
+        }
+        StageTimings oTimings;
+        pProcessor->SetTimings(&oTimings);
+        pProcessor->FilterBatch(aSrc, aDst);
+        pProcessor->SetTimings(NULL);
+        oTimings.Scale(1.0 / aJobs.size());
+        for (BatchJob *pJob : aJobs) {
+            DropWorking(pJob, nOutput);
+            // the encoders of other outputs may be adding to the record
+            std::lock_guard<std::mutex> oLock(pJob->oMutex);
+            pJob->oRecord.oTimings.Add(oTimings);
+            pJob->oRecord.nBatchImages = static_cast<int>(aJobs.size());
+        }
+    }
+
+    // Run fStage and return the message of its error, if any
+    template <typename StageFunction>
+    static std::string StageError(StageFunction fStage) {
+        try {
+            fStage();
+        } catch (npp::Exception &rException) {
+            std::ostringstream oMessage;
+            oMessage << rException;
+            return oMessage.str();
+        } catch (std::exception &rException) {
+            return rException.what();
+        }
+        return "";
+    }
+
+    static bool Failed(BatchJob *pJob) {
+        std::lock_guard<std::mutex> oLock(pJob->oMutex);
+        return !pJob->oRecord.sError.empty();
+    }
+
+    static void SetError(BatchJob *pJob, const std::string &rError) {
+        std::lock_guard<std::mutex> oLock(pJob->oMutex);
+        if (pJob->oRecord.sError.empty()) {
+            pJob->oRecord.sError = rError;
+        }
+    }
+
+    // Run one stage, recording instead of propagating errors so a bad file
+    // does not stop the batch
+    template <typename StageFunction>
+    static void RunStage(BatchJob *pJob, StageFunction fStage) {
+        if (Failed(pJob)) {
+            return;
+        }
+        const std::string sError = StageError(fStage);
+        if (!sError.empty()) {
+            SetError(pJob, sError);
+        }
+    }
+
+    // The same for a stage that works on several images at once; its error
+    // is recorded for all of them
+    template <typename StageFunction>
+    static void RunBatchStage(const std::vector<BatchJob *> &aJobs,
+                              StageFunction fStage) {
+        const std::string sError = StageError(fStage);
+        if (!sError.empty()) {
+            for (BatchJob *pJob : aJobs) {
+                SetError(pJob, sError);
+            }
+        }
+    }
+
+    // Filter the images popped together for output nOutput: those of the
+    // same shape and decode scale as one batch, the others alone
+    void FilterGroups(NppProcessImage *pProcessor,
+                      const std::vector<BatchJobPtr> &aJobs, size_t nOutput) {
+        typedef std::tuple<int, int, int, int> Shape;
+        std::map<Shape, std::vector<BatchJob *>> aGroups;
+        for (const BatchJobPtr &pJob : aJobs) {
+            if (Failed(pJob.get()) || pJob->aCached[nOutput]) {
+                continue;
+            }
+            const npp::ImageView oSrc = pJob->oImage.sourceView();
+            aGroups[Shape(oSrc.nWidth, oSrc.nHeight, oSrc.nChannels,
+                          pJob->oRecord.nDecodeScale)]
+                .push_back(pJob.get());
+        }
+        for (const auto &rGroup : aGroups) {
+            const std::vector<BatchJob *> &rJobs = rGroup.second;
+            if (rJobs.size() == 1) {
+                RunStage(rJobs[0],
+                         [&] { Filter(pProcessor, rJobs[0], nOutput); });
+            } else {
+                RunBatchStage(rJobs, [&] {
+                    FilterBatch(pProcessor, rJobs, nOutput);
+                });
+            }
+        }
+    }
+
+ public:
+    BatchPipeline(const std::vector<BatchOutput> &rOutputs,
+                  BatchThreads oThreads)
+        : m_aOutputs(rOutputs), m_oThreads(oThreads) {
+        NPP_ASSERT_MSG(!m_aOutputs.empty(), "No pipeline outputs");
+    }
+
+    // Take results from pCache when it has them and add new ones to it
+    void SetCache(ResultCache *pCache) { m_pCache = pCache; }
+
+    // Also hand every finished record to fJobDone, from the encode threads
+    void SetJobDone(JobDoneFunction fJobDone) { m_fJobDone = fJobDone; }
+
+    // Let every filter thread take up to nImages decoded images at a time
+    // and filter those of the same shape in one batch
+    void SetBatchSize(int nImages) { m_nBatchSize = std::max(nImages, 1); }
+
+    // Hold the images in flight to pBudget: decodes wait while it is used up
+    void SetMemoryBudget(MemoryBudget *pBudget) { m_pBudget = pBudget; }
+
+    // Add the results to pArchive, named after their files relative to the
+    // input directory, instead of writing files; the caller closes it
+    void SetOutputArchive(npp::ImageArchiveWriter *pArchive) {
+        m_pOutputArchive = pArchive;
+    }
+
+    // Process all files and write one record per image to the log, in the
+    // order the images complete. Returns the number of images that failed.
+    int Run(const std::vector<std::string> &rFiles, ProcessingLog *pLog) {
+        return Run(rFiles.size(), [&rFiles](size_t nFile, BatchJob *pJob) {
+            pJob->oRecord.sFilename = rFiles[nFile];
+        }, pLog);
+    }
+
+    // The same for the images of an archive, read straight from its
+    // mapping; they are logged as archive:name
+    int Run(const npp::ImageArchive &rArchive, const std::string &rFileName,
+            ProcessingLog *pLog) {
+        m_pInputArchive = &rArchive;
+        m_sInputArchiveDir =
+            std::filesystem::path(rFileName).remove_filename().string();
+        return Run(rArchive.size(), [&](size_t nImage, BatchJob *pJob) {
+            pJob->pEntry = &rArchive.entry(nImage);
+            pJob->oRecord.sFilename = rFileName + ":" + pJob->pEntry->sName;
+        }, pLog);
+    }
+
+ private:
+    // Run nImages jobs, each set up by fStart with its index
+    int Run(size_t nImages,
+            const std::function<void(size_t, BatchJob *)> &fStart,
+            ProcessingLog *pLog) {
+        const int nDecode = std::max(m_oThreads.nDecode, 1);
+        const int nFilter = std::max(m_oThreads.nFilter, 1);
+        const int nEncode = std::max(m_oThreads.nEncode, 1);
+        const size_t nOutputs = m_aOutputs.size();
+
+        BoundedQueue<BatchJobPtr> oDecoded(2 * nFilter);
+        BoundedQueue<EncodeTask> oFiltered(2 * nEncode);
+        std::atomic<size_t> nNextFile(0);
+        std::atomic<int> nDecodersLeft(nDecode);
+        std::atomic<int> nFiltersLeft(nFilter);
+        std::atomic<int> nFailed(0);
+        std::vector<std::thread> aWorkers;
+
+        for (int i = 0; i < nDecode; ++i) {
+            aWorkers.emplace_back([&] {
+                size_t nFile;
+                while ((nFile = nNextFile++) < nImages) {
+                    BatchJobPtr pJob = std::make_shared<BatchJob>();
+                    fStart(nFile, pJob.get());
+                    pJob->aResults.resize(nOutputs);
+                    pJob->aCacheKeys.resize(nOutputs);
+                    pJob->aCached.resize(nOutputs, 0);
+                    pJob->nPendingEncodes = static_cast<int>(nOutputs);
+                    RunStage(pJob.get(), [&] { Decode(pJob.get()); });
+                    oDecoded.push(std::move(pJob));
+                }
+                if (--nDecodersLeft == 0) {
+                    oDecoded.close();
+                }
+            });
+        }
+        for (int i = 0; i < nFilter; ++i) {
+            aWorkers.emplace_back([&] {
+                std::vector<BatchOutput> aOutputs = m_aOutputs;
+                std::vector<BatchJobPtr> aJobs;
+                BatchJobPtr pJob;
+                while (true) {
+                    aJobs.clear();
+                    // a batch waits for its first image only and then takes
+                    // those decoded already; waiting for more would delay
+                    // the images it holds on a slow input, and hold memory
+                    // the decoders may be waiting for
+                    while (static_cast<int>(aJobs.size()) < m_nBatchSize &&
+                           (aJobs.empty() ? oDecoded.pop(&pJob)
+                                          : oDecoded.tryPop(&pJob))) {
+                        aJobs.push_back(std::move(pJob));
+                    }
+                    if (aJobs.empty()) {
+                        break;
+                    }
+                    // each result is handed to the encoders as soon as it is
+                    // filtered, so its encode overlaps the next filter
+                    for (size_t k = 0; k < nOutputs; ++k) {
+                        FilterGroups(&aOutputs[k].oProcessor, aJobs, k);
+                        for (const BatchJobPtr &pFiltered : aJobs) {
+                            EncodeTask oTask;
+                            oTask.pJob = pFiltered;
+                            oTask.nOutput = k;
+                            oFiltered.push(std::move(oTask));
+                        }
+                    }
+                }
+                if (--nFiltersLeft == 0) {
+                    oFiltered.close();
+                }
+            });
+        }
+        for (int i = 0; i < nEncode; ++i) {
+            aWorkers.emplace_back([&] {
+                EncodeTask oTask;
+                while (oFiltered.pop(&oTask)) {
+                    BatchJob *pJob = oTask.pJob.get();
+                    RunStage(pJob, [&] {
+                        if (!pJob->aCached[oTask.nOutput]) {
+                            Encode(pJob, oTask.nOutput);
+                        }
+                    });
+                    if (--pJob->nPendingEncodes == 0) {
+                        // whatever the job still holds goes with it
+                        Drop(pJob);
+                        if (!pJob->oRecord.sError.empty()) {
+                            nFailed++;
+                        }
+                        pLog->Write(&pJob->oRecord);
+                        if (m_fJobDone) {
+                            m_fJobDone(pJob->oRecord);
+                        }
+                    }
+                    oTask.pJob.reset();
+                }
+            });
+        }
+        for (std::thread &rWorker : aWorkers) {
+            rWorker.join();
+        }
+        return nFailed;
+    }
+};
+#endif  //  SRC_BATCHPIPELINE_H_
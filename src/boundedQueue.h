@@ -0,0 +1,103 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_BOUNDEDQUEUE_H_
+#define SRC_BOUNDEDQUEUE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// Blocking FIFO with a fixed capacity that connects the stages of a pipeline.
+// Producers wait while the queue is full, consumers while it is empty. Once
+// closed, pop() drains the remaining items and then returns false.
+template <typename T>
+class BoundedQueue {
+    std::mutex m_oMutex;
+    std::condition_variable m_oNotFull;
+    std::condition_variable m_oNotEmpty;
+    std::deque<T> m_aItems;
+    size_t m_nCapacity;
+    bool m_bClosed = false;
+
+ public:
+    explicit BoundedQueue(size_t nCapacity)
+        : m_nCapacity(nCapacity > 0 ? nCapacity : 1) {}
+
+    // Returns false if the queue was closed before the item could be added
+    bool push(T oItem) {
+        std::unique_lock<std::mutex> oLock(m_oMutex);
+        m_oNotFull.wait(oLock, [this] {
+            return m_bClosed || m_aItems.size() < m_nCapacity;
+        });
+        if (m_bClosed) {
+            return false;
+        }
+        m_aItems.push_back(std::move(oItem));
+        m_oNotEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T *pItem) {
+        std::unique_lock<std::mutex> oLock(m_oMutex);
+        m_oNotEmpty.wait(oLock, [this] {
+            return m_bClosed || !m_aItems.empty();
+        });
+        if (m_aItems.empty()) {
+            return false;
+        }
+        *pItem = std::move(m_aItems.front());
+        m_aItems.pop_front();
+        m_oNotFull.notify_one();
+        return true;
+    }
+
+    // pop() without waiting; false when the queue is empty
+    bool tryPop(T *pItem) {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        if (m_aItems.empty()) {
+            return false;
+        }
+        *pItem = std::move(m_aItems.front());
+        m_aItems.pop_front();
+        m_oNotFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        m_bClosed = true;
+        m_oNotFull.notify_all();
+        m_oNotEmpty.notify_all();
+    }
+};
+#endif  //  SRC_BOUNDEDQUEUE_H_
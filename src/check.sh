@@ -0,0 +1,236 @@
+#!/usr/bin/env bash
+
+# Regression checks of results that must not depend on how an image is
+# processed: every check filters synthetic images two ways and compares the
+# result files byte for byte. Extra arguments go to every filterNPP run,
+# e.g.
+#   ./check.sh ../bin/filterNPP -backend=cpu
+# filterBench and imageArchive are expected next to filterNPP unless
+# FILTERBENCH and IMAGEARCHIVE name them.
+
+FILTER=${1:-../bin/filterNPP}
+shift
+BENCH=${FILTERBENCH:-$(dirname "$FILTER")/filterBench}
+ARCHIVE=${IMAGEARCHIVE:-$(dirname "$FILTER")/imageArchive}
+ARGS=("$@")
+WORK=$(mktemp -d)
+trap 'rm -rf -- "$WORK"' EXIT
+# single images log next to their directory, which keeps that in $WORK too
+IMAGES=$WORK/images
+mkdir "$IMAGES"
+FAILED=0
+
+# makeImage file P5|P6 width height [seed]: a fixed pattern with a hard edge
+# and fine detail, so that every filter changes it; the seed shifts it
+makeImage() {
+    LC_ALL=C awk -v sMagic="$2" -v nWidth="$3" -v nHeight="$4" \
+        -v nSeed="${5:-0}" 'BEGIN {
+        nChannels = sMagic == "P6" ? 3 : 1
+        printf "%s\n%d %d\n255\n", sMagic, nWidth, nHeight
+        for (y = 0; y < nHeight; y++) {
+            for (x = 0; x < nWidth * nChannels; x++) {
+                nEdge = x > nWidth * nChannels / 2 ? 90 : 0
+                printf "%c", (x * 7 + y * 13 + (x * y) % 31 + nEdge + \
+                    nSeed * 37) % 255 + 1
+            }
+        }
+    }' > "$1"
+}
+
+# filter input output arguments...: filterNPP with the check arguments
+filter() {
+    local sInput=$1 sOutput=$2
+    shift 2
+    "$FILTER" -input="$sInput" -output="$sOutput" "${ARGS[@]}" "$@" \
+        > "$WORK/filterNPP.out" 2>&1 || cat "$WORK/filterNPP.out"
+}
+
+# expectSame name file1 file2
+expectSame() {
+    if cmp -s "$2" "$3"; then
+        echo "ok     $1"
+    else
+        echo "FAILED $1"
+        FAILED=$((FAILED + 1))
+    fi
+}
+
+makeImage "$IMAGES/gray.pgm" P5 301 257
+makeImage "$IMAGES/color.ppm" P6 173 211
+
+# strips of rows give the same result as the whole image
+for sImage in gray.pgm color.ppm; do
+    sExt=${sImage##*.}
+    for sFilter in "-filter=1 -maskSize=9 -anchor=4" "-filter=2 -maskSize=7"; do
+        filter "$IMAGES/$sImage" "$WORK/whole.$sExt" $sFilter
+        filter "$IMAGES/$sImage" "$WORK/strips.$sExt" $sFilter -tileRows=5
+        expectSame "strips: $sImage $sFilter" \
+            "$WORK/whole.$sExt" "$WORK/strips.$sExt"
+    done
+done
+
+# a chain filtered in memory gives the result of filtering step by step
+for sImage in gray.pgm color.ppm; do
+    sExt=${sImage##*.}
+    filter "$IMAGES/$sImage" "$WORK/chain.$sExt" -pipeline=box:5,gauss:7,box:3
+    # the steps are inputs too, so they stay with the images; -maskSize=6
+    # selects the 7x7 Gauss mask
+    filter "$IMAGES/$sImage" "$IMAGES/step1.$sExt" -filter=1 -maskSize=5 \
+        -anchor=2
+    filter "$IMAGES/step1.$sExt" "$IMAGES/step2.$sExt" -filter=2 -maskSize=6
+    filter "$IMAGES/step2.$sExt" "$WORK/step3.$sExt" -filter=1 -maskSize=3 \
+        -anchor=1
+    expectSame "chain: $sImage box:5,gauss:7,box:3" \
+        "$WORK/chain.$sExt" "$WORK/step3.$sExt"
+done
+
+# transcoding keeps the colours, although FreeImage holds colour pixels as BGR
+# and netpbm files as RGB. color.ppm under another name is decoded by
+# FreeImage instead of being mapped; a netpbm result is compared after
+# FreeImage, reading it the same way, converted it to PNG.
+IDENTITY=(-filter=1 -maskSize=1 -anchor=0)
+cp "$IMAGES/color.ppm" "$IMAGES/color.img"
+filter "$IMAGES/color.ppm" "$WORK/mapped.png" "${IDENTITY[@]}" -outFormat=png
+filter "$IMAGES/color.img" "$WORK/decoded.png" "${IDENTITY[@]}" -outFormat=png
+expectSame "transcode: color.ppm to png" "$WORK/mapped.png" "$WORK/decoded.png"
+filter "$IMAGES/color.img" "$IMAGES/color.jpg" "${IDENTITY[@]}" \
+    -outFormat=jpeg:100:444
+filter "$IMAGES/color.jpg" "$WORK/reference.png" "${IDENTITY[@]}" -outFormat=png
+for sStrips in "" -tileRows=5; do
+    filter "$IMAGES/color.jpg" "$IMAGES/fromJpeg.pnm" "${IDENTITY[@]}" \
+        -outFormat=pnm $sStrips
+    mv "$IMAGES/fromJpeg.pnm" "$IMAGES/fromJpeg.img"
+    filter "$IMAGES/fromJpeg.img" "$WORK/fromJpeg.png" "${IDENTITY[@]}" \
+        -outFormat=png
+    expectSame "transcode: color.jpg to pnm${sStrips:+ $sStrips}" \
+        "$WORK/reference.png" "$WORK/fromJpeg.png"
+done
+
+# raw archive entries are RGB like netpbm files, whatever the image was
+# decoded from: packed with -raw and unpacked again, the PPM comes back as it
+# was and the JPEG as the pixels FreeImage decodes from it
+mkdir "$IMAGES/pack"
+cp "$IMAGES/color.ppm" "$IMAGES/color.jpg" "$IMAGES/pack"
+"$ARCHIVE" -pack="$IMAGES/pack" -output="$WORK/raw.nia" -raw \
+    > "$WORK/imageArchive.out" 2>&1 || cat "$WORK/imageArchive.out"
+"$ARCHIVE" -unpack="$WORK/raw.nia" -output="$WORK/unpacked" \
+    > "$WORK/imageArchive.out" 2>&1 || cat "$WORK/imageArchive.out"
+expectSame "archive: color.ppm packed -raw" \
+    "$IMAGES/color.ppm" "$WORK/unpacked/color.ppm"
+mv "$WORK/unpacked/color.pnm" "$IMAGES/unpacked.img"
+filter "$IMAGES/unpacked.img" "$WORK/unpacked.png" "${IDENTITY[@]}" \
+    -outFormat=png
+expectSame "archive: color.jpg packed -raw" \
+    "$WORK/reference.png" "$WORK/unpacked.png"
+
+# images filtered as a batch give the results of filtering them one by one;
+# a directory of images of the same size, and one of another size, so that
+# the batches are split by shape
+mkdir "$IMAGES/batch"
+for nImage in 1 2 3 4 5 6; do
+    makeImage "$IMAGES/batch/gray$nImage.pgm" P5 67 45 $nImage
+done
+makeImage "$IMAGES/batch/color.ppm" P6 45 67
+# more decoders than filter threads, so that batches fill up; how many
+# images were batched depends on the timing and is only reported
+for sFilter in "-filter=1 -maskSize=9 -anchor=4" "-filter=2 -maskSize=7"; do
+    rm -rf "$IMAGES/batch/"*Filter* "$WORK/single"
+    filter "$IMAGES/batch/*" "$WORK/unused" $sFilter -batch=1
+    mv "$IMAGES/batch/"*Filter "$WORK/single"
+    rm "$IMAGES/batch/FilterRecord.log"
+    filter "$IMAGES/batch/*" "$WORK/unused" $sFilter -batch=4 -threads=2,1,1
+    echo "       batch: $(grep -c '"batch":[2-9]' \
+        "$IMAGES/batch/FilterRecord.log") of 7 images batched"
+    for sResult in "$WORK/single/"*; do
+        expectSame "batch: ${sResult##*/} $sFilter" \
+            "$sResult" "$IMAGES/batch/"*Filter/"${sResult##*/}"
+    done
+done
+
+# filtering the channel planes one by one gives the result of filtering the
+# interleaved pixels
+for sFilter in "-filter=1 -maskSize=9 -anchor=4" "-filter=2 -maskSize=7"; do
+    filter "$IMAGES/color.ppm" "$WORK/interleaved.ppm" $sFilter
+    filter "$IMAGES/color.ppm" "$WORK/planar.ppm" $sFilter -planar
+    expectSame "planar: color.ppm $sFilter" \
+        "$WORK/interleaved.ppm" "$WORK/planar.ppm"
+done
+
+# the same for 4 channels, with filterBench: the case and the checksum of
+# every line of one implementation
+benchChecksums() {
+    grep "\"impl\":\"$1\"" "$WORK/filterBench.out" |
+        sed -E 's/.*("filter".*),"reps".*("checksum":"[0-9a-f]*").*/\1 \2/'
+}
+"$BENCH" -impl=cpu-scalar,cpu-scalar-planar,cpu-sse2,cpu-sse2-planar,\
+cpu-avx2,cpu-avx2-planar -channels=3,4 -sizes=67x45,301x257 -warmup=0 \
+    -reps=1 > "$WORK/filterBench.out"
+# instruction sets the machine does not have give no lines and are left out
+for sIsa in scalar sse2 avx2; do
+    benchChecksums cpu-$sIsa > "$WORK/interleaved.txt"
+    benchChecksums cpu-$sIsa-planar > "$WORK/planar.txt"
+    if [ -s "$WORK/planar.txt" ]; then
+        expectSame "planar: filterBench cpu-$sIsa C3 and C4, \
+$(wc -l < "$WORK/planar.txt") cases" "$WORK/interleaved.txt" "$WORK/planar.txt"
+    elif [ $sIsa = scalar ]; then
+        echo "FAILED planar: filterBench gave no results"
+        FAILED=$((FAILED + 1))
+    fi
+done
+
+# the CPU kernels specialized per mask size and channel count give the
+# results of the generic ones; filterBench compares their checksums
+if "$BENCH" -impl=cpu-scalar-generic,cpu-scalar,cpu-sse2-generic,cpu-sse2,\
+cpu-avx2-generic,cpu-avx2 -sizes=67x45,301x257 -warmup=0 -reps=1 \
+        > "$WORK/filterBench.out"; then
+    echo "ok     specialized kernels: $(grep -c '"matches_generic":true' \
+        "$WORK/filterBench.out") cases"
+else
+    echo "FAILED specialized kernels:"
+    grep '"matches_generic":false' "$WORK/filterBench.out"
+    FAILED=$((FAILED + 1))
+fi
+
+# the CPU backend gives the results of NPP, when there is a CUDA device to
+# compare with: box filters with source offsets and anchors anywhere in the
+# mask and every Gauss mask in filterNPP, and every mask in C1, C3 and C4 in
+# filterBench. The backend is chosen here, whatever the check arguments.
+"$FILTER" -input="$IMAGES/gray.pgm" -output="$WORK/probe.pgm" -backend=auto \
+    > "$WORK/filterNPP.out" 2>&1
+if grep -q "^Filter backend: npp" "$WORK/filterNPP.out"; then
+    for sImage in gray.pgm color.ppm; do
+        sExt=${sImage##*.}
+        for sFilter in "-filter=1 -maskSize=3 -anchor=1" \
+                "-filter=1 -maskSize=5 -anchor=0" \
+                "-filter=1 -maskSize=8 -anchor=7 -srcOffset=3" \
+                "-filter=1 -maskSize=25 -anchor=12 -srcOffset=1" \
+                -filter=2\ -maskSize={0..10}; do
+            for sBackend in npp cpu; do
+                "$FILTER" -input="$IMAGES/$sImage" \
+                    -output="$WORK/$sBackend.$sExt" -backend=$sBackend \
+                    $sFilter > "$WORK/filterNPP.out" 2>&1 ||
+                    cat "$WORK/filterNPP.out"
+            done
+            expectSame "npp: $sImage $sFilter" \
+                "$WORK/npp.$sExt" "$WORK/cpu.$sExt"
+        done
+    done
+    "$BENCH" -impl=npp,cpu-scalar,cpu-sse2,cpu-avx2 -channels=1,3,4 \
+        -sizes=67x45,301x257 -warmup=0 -reps=1 > "$WORK/filterBench.out"
+    benchChecksums npp > "$WORK/npp.txt"
+    for sIsa in scalar sse2 avx2; do
+        benchChecksums cpu-$sIsa > "$WORK/cpu.txt"
+        if [ -s "$WORK/cpu.txt" ]; then
+            expectSame "npp: filterBench cpu-$sIsa C1, C3 and C4, \
+$(wc -l < "$WORK/cpu.txt") cases" "$WORK/npp.txt" "$WORK/cpu.txt"
+        fi
+    done
+else
+    echo "skip   npp: no CUDA device"
+fi
+
+if [ $FAILED -gt 0 ]; then
+    echo "$FAILED checks failed"
+    exit 1
+fi
+echo "all checks passed"
@@ -0,0 +1,81 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_CPUFEATURES_H_
+#define SRC_CPUFEATURES_H_
+
+#include <Exceptions.h>
+
+#include <string>
+#include <vector>
+
+// The CPU filter kernels are built for the baseline target and the wider
+// instruction sets are enabled per function, so one binary can pick the best
+// code path for the machine it happens to run on.
+#if defined(__x86_64__) || defined(__i386__)
+#define FILTER_CPU_X86 1
+#include <immintrin.h>
+#define FILTER_TARGET_SSE2 __attribute__((target("sse2")))
+#define FILTER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+    enum enumCpuIsa {
+        CpuIsa_Scalar = 0,
+        CpuIsa_SSE2 = 1,
+        CpuIsa_AVX2 = 2
+    };
+
+const std::vector<std::string> CpuIsaDescription = {"scalar", "sse2", "avx2"};
+
+// Highest instruction set supported by this processor
+inline enumCpuIsa DetectCpuIsa() {
+#ifdef FILTER_CPU_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return CpuIsa_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return CpuIsa_SSE2;
+    }
+#endif
+    return CpuIsa_Scalar;
+}
+
+// Map a name such as "sse2" to the instruction set; throws for unknown names
+inline enumCpuIsa CpuIsaFromString(const std::string &rName) {
+    for (size_t i = 0; i < CpuIsaDescription.size(); ++i) {
+        if (CpuIsaDescription[i] == rName) {
+            return static_cast<enumCpuIsa>(i);
+        }
+    }
+    throw npp::Exception("Unknown instruction set: " + rName);
+}
+#endif  //  SRC_CPUFEATURES_H_
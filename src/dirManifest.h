@@ -0,0 +1,260 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_DIRMANIFEST_H_
+#define SRC_DIRMANIFEST_H_
+
+#include <Exceptions.h>
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "processingLog.h"
+#include "resultCache.h"
+
+// Record of the inputs of a directory that were processed, so a later run
+// processes only new and changed files. One line per input: path, size,
+// modification time, a hash of the settings and the result paths, separated
+// by tabs. The results of inputs that disappeared are removed.
+class DirManifest {
+    struct Entry {
+        uintmax_t nSize = 0;
+        int64_t nModified = 0;
+        std::string sSettings;
+        std::vector<std::string> aResults;
+    };
+
+    std::string m_sPath;
+    std::string m_sSettings;
+    std::mutex m_oMutex;
+    std::map<std::string, Entry> m_aEntries;
+    // size and time of the inputs being processed, taken before they were
+    // read so a change during the run is seen by the next one
+    std::map<std::string, Entry> m_aPending;
+    size_t m_nUnchanged = 0;
+    size_t m_nProcessed = 0;
+    size_t m_nRemoved = 0;
+
+    static bool Stat(const std::string &rFile, Entry *pEntry) {
+        std::error_code oError;
+        pEntry->nSize = std::filesystem::file_size(rFile, oError);
+        if (oError) {
+            return false;
+        }
+        std::filesystem::file_time_type oTime =
+            std::filesystem::last_write_time(rFile, oError);
+        pEntry->nModified = oTime.time_since_epoch().count();
+        return !oError;
+    }
+
+    // Delete a result, and its directory once that is empty. Called with the
+    // mutex held.
+    void RemoveResult(const std::string &rResult) {
+        std::error_code oError;
+        if (std::filesystem::remove(rResult, oError)) {
+            m_nRemoved++;
+        }
+        // fails unless the directory is empty
+        std::filesystem::remove(std::filesystem::path(rResult).parent_path(),
+                                oError);
+    }
+
+ public:
+    // Load the manifest at rPath, if there is one, for results made with
+    // rSettings
+    DirManifest(const std::string &rPath, const std::string &rSettings)
+        : m_sPath(rPath) {
+        char aSettings[20];
+        snprintf(aSettings, sizeof(aSettings), "%016llx",
+                 static_cast<unsigned long long>(HashBytes64(
+                     reinterpret_cast<const unsigned char *>(rSettings.data()),
+                     rSettings.size())));
+        m_sSettings = aSettings;
+
+        std::ifstream oFile(m_sPath);
+        std::string sLine;
+        while (std::getline(oFile, sLine)) {
+            std::vector<std::string> aFields;
+            std::istringstream oLine(sLine);
+            std::string sField;
+            while (std::getline(oLine, sField, '\t')) {
+                aFields.push_back(sField);
+            }
+            // a damaged line only costs processing its input again
+            if (aFields.size() < 4) {
+                continue;
+            }
+            Entry oEntry;
+            oEntry.nSize = strtoull(aFields[1].c_str(), NULL, 10);
+            oEntry.nModified = strtoll(aFields[2].c_str(), NULL, 10);
+            oEntry.sSettings = aFields[3];
+            oEntry.aResults.assign(aFields.begin() + 4, aFields.end());
+            m_aEntries[aFields[0]] = oEntry;
+        }
+    }
+
+    DirManifest(const DirManifest &) = delete;
+    DirManifest &operator=(const DirManifest &) = delete;
+
+    // The files of rFiles that are new, changed, were processed with other
+    // settings or lost a result. Inputs that are no longer among rFiles are
+    // forgotten and their results removed.
+    std::vector<std::string> Changed(const std::vector<std::string> &rFiles) {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        std::set<std::string> aListed(rFiles.begin(), rFiles.end());
+        for (auto it = m_aEntries.begin(); it != m_aEntries.end();) {
+            if (aListed.count(it->first) == 0) {
+                for (const std::string &rResult : it->second.aResults) {
+                    RemoveResult(rResult);
+                }
+                it = m_aEntries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        std::vector<std::string> aChanged;
+        for (const std::string &rFile : rFiles) {
+            Entry oNow;
+            if (!Stat(rFile, &oNow)) {
+                // let the pipeline report it
+                aChanged.push_back(rFile);
+                continue;
+            }
+            std::map<std::string, Entry>::const_iterator it =
+                m_aEntries.find(rFile);
+            bool bCurrent = it != m_aEntries.end() &&
+                            it->second.nSize == oNow.nSize &&
+                            it->second.nModified == oNow.nModified &&
+                            it->second.sSettings == m_sSettings;
+            if (bCurrent) {
+                for (const std::string &rResult : it->second.aResults) {
+                    bCurrent = bCurrent && std::filesystem::exists(rResult);
+                }
+            }
+            if (bCurrent) {
+                m_nUnchanged++;
+            } else {
+                m_aPending[rFile] = oNow;
+                aChanged.push_back(rFile);
+            }
+        }
+        return aChanged;
+    }
+
+    // Note the outcome of processing an input; a failed input is tried again
+    // on the next run. Results of the previous run that were not written
+    // again are removed, and so are all results of a failed input, since
+    // the manifest no longer lists them for a later run to remove.
+    void Record(const ImageRecord &rRecord) {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        std::map<std::string, Entry>::iterator itPending =
+            m_aPending.find(rRecord.sFilename);
+        if (itPending == m_aPending.end()) {
+            return;
+        }
+        Entry oEntry = itPending->second;
+        m_aPending.erase(itPending);
+        if (!rRecord.sError.empty()) {
+            std::map<std::string, Entry>::iterator it =
+                m_aEntries.find(rRecord.sFilename);
+            if (it != m_aEntries.end()) {
+                for (const std::string &rResult : it->second.aResults) {
+                    RemoveResult(rResult);
+                }
+                m_aEntries.erase(it);
+            }
+            // those of its outputs that were written before it failed
+            for (const std::string &rResult : rRecord.aResultFilenames) {
+                RemoveResult(rResult);
+            }
+            return;
+        }
+        oEntry.sSettings = m_sSettings;
+        oEntry.aResults = rRecord.aResultFilenames;
+        std::map<std::string, Entry>::iterator it =
+            m_aEntries.find(rRecord.sFilename);
+        if (it != m_aEntries.end()) {
+            for (const std::string &rResult : it->second.aResults) {
+                if (std::find(oEntry.aResults.begin(), oEntry.aResults.end(),
+                              rResult) == oEntry.aResults.end()) {
+                    RemoveResult(rResult);
+                }
+            }
+        }
+        m_aEntries[rRecord.sFilename] = oEntry;
+        m_nProcessed++;
+    }
+
+    // Write the manifest; it is replaced as a whole so an interrupted run
+    // leaves the previous one
+    void Save() {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        const std::string sTemporary = m_sPath + ".tmp";
+        {
+            std::ofstream oFile(sTemporary, std::ios_base::trunc);
+            for (const auto &rEntry : m_aEntries) {
+                oFile << rEntry.first << '\t' << rEntry.second.nSize << '\t'
+                      << rEntry.second.nModified << '\t'
+                      << rEntry.second.sSettings;
+                for (const std::string &rResult : rEntry.second.aResults) {
+                    oFile << '\t' << rResult;
+                }
+                oFile << '\n';
+            }
+            NPP_ASSERT_MSG(oFile.good(), "Cannot write the manifest");
+        }
+        NPP_ASSERT_MSG(rename(sTemporary.c_str(), m_sPath.c_str()) == 0,
+                       "Cannot replace the manifest");
+    }
+
+    // Counters as a JSON member for the summary of the processing log
+    std::string Summary() {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        std::ostringstream oJson;
+        oJson << "\"incremental\":{\"unchanged\":" << m_nUnchanged
+              << ",\"processed\":" << m_nProcessed
+              << ",\"removed\":" << m_nRemoved << "}";
+        return oJson.str();
+    }
+};
+#endif  //  SRC_DIRMANIFEST_H_
@@ -0,0 +1,188 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_ENCODEPOLICY_H_
+#define SRC_ENCODEPOLICY_H_
+
+#include <Exceptions.h>
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FreeImage.h"
+
+namespace npp {
+
+// The format and encoder options results are written with, parsed from
+// "-outFormat=". "same" re-encodes in the format of the source with default
+// options; the others transcode:
+//   pnm                 raw PGM for gray and PPM for colour images, the
+//                       cheapest encode, e.g. for intermediate products
+//   bmp[:rle]           BMP, optionally run-length encoded
+//   png[:level]         PNG with zlib level 0 (stored) to 9 (default 6)
+//   jpeg[:quality[:subsampling]]
+//                       JPEG of quality 1 to 100 (default 75) and chroma
+//                       subsampling 411, 420 (default), 422 or 444
+//   tiff[:compression]  TIFF with none, packbits, lzw, deflate,
+//                       adobe-deflate or jpeg compression (default lzw)
+struct EncodePolicy {
+    // canonical text of the policy, defaults spelled out, so equal
+    // policies log and hash the same
+    std::string sText = "same";
+    // FIF_UNKNOWN keeps the format of the source
+    FREE_IMAGE_FORMAT eFormat = FIF_UNKNOWN;
+    // raw PGM or PPM, chosen by the bit depth of the result
+    bool bPnm = false;
+    // passed to FreeImage_Save
+    int nFlags = 0;
+    // extension of the result files, dot included
+    std::string sExtension;
+
+    bool KeepsFormat() const { return eFormat == FIF_UNKNOWN && !bPnm; }
+
+    // Extension of the result of a source with extension rSourceExtension
+    std::string Extension(const std::string &rSourceExtension) const {
+        return KeepsFormat() ? rSourceExtension : sExtension;
+    }
+
+    // Format of the result of a source in eSource with nBitDepth bits per
+    // pixel; the flags only apply when the format is not kept
+    FREE_IMAGE_FORMAT Format(FREE_IMAGE_FORMAT eSource, int nBitDepth) const {
+        if (bPnm) {
+            return nBitDepth == 8 ? FIF_PGMRAW : FIF_PPMRAW;
+        }
+        return eFormat == FIF_UNKNOWN ? eSource : eFormat;
+    }
+
+    int Flags() const { return KeepsFormat() ? 0 : nFlags; }
+};
+
+// Parse "-outFormat=" as described above; throws for anything else
+inline EncodePolicy EncodePolicyFromString(const std::string &rText) {
+    std::vector<std::string> aFields;
+    std::istringstream oText(rText);
+    std::string sField;
+    while (std::getline(oText, sField, ':')) {
+        aFields.push_back(sField);
+    }
+    NPP_ASSERT_MSG(!aFields.empty(), "Empty output format");
+    const std::string &rName = aFields[0];
+    auto fNumber = [&aFields](size_t nField, int nDefault, int nLow,
+                              int nHigh) {
+        if (aFields.size() <= nField) {
+            return nDefault;
+        }
+        const int nValue = atoi(aFields[nField].c_str());
+        NPP_ASSERT_MSG(nValue >= nLow && nValue <= nHigh &&
+                           aFields[nField] == std::to_string(nValue),
+                       "Output format option out of range");
+        return nValue;
+    };
+
+    EncodePolicy oPolicy;
+    size_t nMaxFields = 1;
+    if (rName == "same") {
+    } else if (rName == "pnm") {
+        oPolicy.bPnm = true;
+        oPolicy.sText = "pnm";
+        oPolicy.sExtension = ".pnm";
+    } else if (rName == "bmp") {
+        oPolicy.eFormat = FIF_BMP;
+        oPolicy.sExtension = ".bmp";
+        nMaxFields = 2;
+        oPolicy.sText = "bmp";
+        if (aFields.size() > 1) {
+            NPP_ASSERT_MSG(aFields[1] == "rle", "Expected bmp or bmp:rle");
+            oPolicy.nFlags = BMP_SAVE_RLE;
+            oPolicy.sText = "bmp:rle";
+        }
+    } else if (rName == "png") {
+        oPolicy.eFormat = FIF_PNG;
+        oPolicy.sExtension = ".png";
+        nMaxFields = 2;
+        const int nLevel = fNumber(1, 6, 0, 9);
+        // zlib level 0 has a flag of its own, 0 being the default level
+        oPolicy.nFlags = nLevel == 0 ? PNG_Z_NO_COMPRESSION : nLevel;
+        oPolicy.sText = "png:" + std::to_string(nLevel);
+    } else if (rName == "jpeg" || rName == "jpg") {
+        oPolicy.eFormat = FIF_JPEG;
+        oPolicy.sExtension = ".jpg";
+        nMaxFields = 3;
+        const int nQuality = fNumber(1, 75, 1, 100);
+        const int nSubsampling = fNumber(2, 420, 411, 444);
+        oPolicy.nFlags = nQuality;
+        oPolicy.sText = "jpeg:" + std::to_string(nQuality) + ":" +
+                        std::to_string(nSubsampling);
+        if (nSubsampling == 411) {
+            oPolicy.nFlags |= JPEG_SUBSAMPLING_411;
+        } else if (nSubsampling == 420) {
+            oPolicy.nFlags |= JPEG_SUBSAMPLING_420;
+        } else if (nSubsampling == 422) {
+            oPolicy.nFlags |= JPEG_SUBSAMPLING_422;
+        } else {
+            NPP_ASSERT_MSG(nSubsampling == 444,
+                           "JPEG subsampling must be 411, 420, 422 or 444");
+            oPolicy.nFlags |= JPEG_SUBSAMPLING_444;
+        }
+    } else if (rName == "tiff" || rName == "tif") {
+        oPolicy.eFormat = FIF_TIFF;
+        oPolicy.sExtension = ".tif";
+        nMaxFields = 2;
+        const std::string sCompression =
+            aFields.size() > 1 ? aFields[1] : "lzw";
+        if (sCompression == "none") {
+            oPolicy.nFlags = TIFF_NONE;
+        } else if (sCompression == "packbits") {
+            oPolicy.nFlags = TIFF_PACKBITS;
+        } else if (sCompression == "lzw") {
+            oPolicy.nFlags = TIFF_LZW;
+        } else if (sCompression == "deflate") {
+            oPolicy.nFlags = TIFF_DEFLATE;
+        } else if (sCompression == "adobe-deflate") {
+            oPolicy.nFlags = TIFF_ADOBE_DEFLATE;
+        } else if (sCompression == "jpeg") {
+            oPolicy.nFlags = TIFF_JPEG;
+        } else {
+            throw npp::Exception("Unknown TIFF compression: " + sCompression);
+        }
+        oPolicy.sText = "tiff:" + sCompression;
+    } else {
+        throw npp::Exception("Unknown output format: " + rName);
+    }
+    NPP_ASSERT_MSG(aFields.size() <= nMaxFields,
+                   "Too many options for the output format");
+    return oPolicy;
+}
+
+}  // namespace npp
+#endif  //  SRC_ENCODEPOLICY_H_
@@ -0,0 +1,487 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_FILTERBACKEND_H_
+#define SRC_FILTERBACKEND_H_
+
+#include <Exceptions.h>
+
+#include <cuda_runtime.h>
+#include <npp.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpuFeatures.h"
+#include "filterKernelsCPU.h"
+#include "imageBufferPool.h"
+#include "planarLayout.h"
+#include "processingLog.h"
+#include "workStealingPool.h"
+
+    enum enumFilterBackend {
+        FilterBackend_Auto = 0,
+        FilterBackend_NPP = 1,
+        FilterBackend_CPU = 2
+    };
+
+const std::vector<std::string> FilterBackendDescription = {"auto", "npp",
+                                                           "cpu"};
+
+// The filters applied by NppProcessImage. Both entry points take host images
+// and follow the NPP signatures of nppiFilterBoxBorder_8u_C*R and
+// nppiFilterGaussBorder_8u_C*R with NPP_BORDER_REPLICATE, nChannels selecting
+// between the C1, C3 and C4 variants. The steps may be negative: pSrc and pDst
+// point at the top row and the following rows lie at lower addresses. When
+// pTimings is not NULL the time spent is added to its upload, filter and
+// download stages.
+class FilterBackend {
+ public:
+    virtual ~FilterBackend() {}
+    virtual std::string Name() const = 0;
+    // Bytes per row block of the intermediate images of a filter chain;
+    // 0 filters every step of the chain over the whole image
+    virtual size_t ChainBlockBytes() const = 0;
+
+    // A batch of small images is filtered best either stacked into one
+    // image in a single call (see ImageBatch), which saves the fixed cost of
+    // every call, or image by image through ForEachImage()
+    virtual bool StacksBatches() const { return false; }
+    // Run fImage(i) for each of the nImages images of a batch; by default
+    // one after the other
+    virtual void ForEachImage(int nImages,
+                              const std::function<void(int)> &fImage) {
+        for (int i = 0; i < nImages; ++i) {
+            fImage(i);
+        }
+    }
+
+    virtual void FilterBoxBorder(const Npp8u *pSrc, Npp32s nSrcStep,
+                                 NppiSize oSrcSize, NppiPoint oSrcOffset,
+                                 Npp8u *pDst, Npp32s nDstStep,
+                                 NppiSize oSizeROI, NppiSize oMaskSize,
+                                 NppiPoint oAnchor, int nChannels,
+                                 StageTimings *pTimings) = 0;
+
+    virtual void FilterGaussBorder(const Npp8u *pSrc, Npp32s nSrcStep,
+                                   NppiSize oSrcSize, NppiPoint oSrcOffset,
+                                   Npp8u *pDst, Npp32s nDstStep,
+                                   NppiSize oSizeROI, NppiMaskSize eMaskSize,
+                                   int nChannels, StageTimings *pTimings) = 0;
+};
+
+// Runs the filters on the GPU: the host image is uploaded, filtered by NPP and
+// the result copied back.
+class NppFilterBackend : public FilterBackend {
+    static const int kDevicePitchAlignment = 512;
+
+    // Lowest addressed row of a host image; with a negative step the rows run
+    // bottom-up in memory, as in a FreeImage bitmap
+    template <typename T>
+    static T *FirstRowInMemory(T *pImage, Npp32s nStep, int nHeight) {
+        if (nStep >= 0) {
+            return pImage;
+        }
+        return pImage + static_cast<ptrdiff_t>(nStep) * (nHeight - 1);
+    }
+
+    template <size_t N>
+    void FilterOnDevice(const Npp8u *pSrc, Npp32s nSrcStep,
+                        NppiSize oSrcSize, NppiPoint oSrcOffset, Npp8u *pDst,
+                        Npp32s nDstStep, NppiSize oSizeROI,
+                        NppiSize oMaskSize, NppiPoint oAnchor,
+                        const NppiMaskSize *pGaussMaskSize,
+                        StageTimings *pTimings) {
+        StageClock oClock;
+        // device images come from the pool, pitched like nppiMalloc would
+        PooledImageBuffer oDeviceSrc(&DeviceBufferPool(), oSrcSize.width * N,
+                                     oSrcSize.height, kDevicePitchAlignment);
+        PooledImageBuffer oDeviceDst(&DeviceBufferPool(),
+                                     oSizeROI.width * N, oSizeROI.height,
+                                     kDevicePitchAlignment);
+        // the upload keeps the host memory order, so a bottom-up source is
+        // filtered upside down with the vertical offset and anchor mirrored
+        const bool bFlipped = nSrcStep < 0;
+        NPP_CHECK_CUDA(cudaMemcpy2D(
+            oDeviceSrc.data(), oDeviceSrc.pitch(),
+            FirstRowInMemory(pSrc, nSrcStep, oSrcSize.height),
+            std::abs(nSrcStep), oSrcSize.width * N, oSrcSize.height,
+            cudaMemcpyHostToDevice));
+        if (bFlipped) {
+            oSrcOffset.y = oSrcSize.height - oSizeROI.height - oSrcOffset.y;
+            oAnchor.y = oMaskSize.height - 1 - oAnchor.y;
+        }
+        Npp32s nDeviceSrcStep = oDeviceSrc.pitch();
+        Npp32s nDeviceDstStep = oDeviceDst.pitch();
+        if (pTimings != NULL) {
+            pTimings->dUploadMs += oClock.Lap();
+        }
+
+        NppStatus eStatus = NPP_SUCCESS;
+        if (pGaussMaskSize == NULL) {
+            eStatus = (N == 1 ? nppiFilterBoxBorder_8u_C1R :
+                       N == 3 ? nppiFilterBoxBorder_8u_C3R :
+                                nppiFilterBoxBorder_8u_C4R)(
+                oDeviceSrc.data(), nDeviceSrcStep, oSrcSize, oSrcOffset,
+                oDeviceDst.data(), nDeviceDstStep, oSizeROI, oMaskSize,
+                oAnchor, NPP_BORDER_REPLICATE);
+        } else {
+            eStatus = (N == 1 ? nppiFilterGaussBorder_8u_C1R :
+                       N == 3 ? nppiFilterGaussBorder_8u_C3R :
+                                nppiFilterGaussBorder_8u_C4R)(
+                oDeviceSrc.data(), nDeviceSrcStep, oSrcSize, oSrcOffset,
+                oDeviceDst.data(), nDeviceDstStep, oSizeROI, *pGaussMaskSize,
+                NPP_BORDER_REPLICATE);
+        }
+        NPP_CHECK_NPP(eStatus);
+        if (pTimings != NULL) {
+            // the filter runs asynchronously, wait for it to be timed alone
+            NPP_CHECK_CUDA(cudaDeviceSynchronize());
+            pTimings->dFilterMs += oClock.Lap();
+        }
+
+        // turn the result the way the host image runs before copying it back
+        if (bFlipped != (nDstStep < 0)) {
+            NPP_CHECK_NPP((N == 1 ? nppiMirror_8u_C1IR :
+                           N == 3 ? nppiMirror_8u_C3IR :
+                                    nppiMirror_8u_C4IR)(
+                oDeviceDst.data(), nDeviceDstStep, oSizeROI,
+                NPP_HORIZONTAL_AXIS));
+        }
+        NPP_CHECK_CUDA(cudaMemcpy2D(
+            FirstRowInMemory(pDst, nDstStep, oSizeROI.height),
+            std::abs(nDstStep), oDeviceDst.data(), oDeviceDst.pitch(),
+            oSizeROI.width * N, oSizeROI.height, cudaMemcpyDeviceToHost));
+        if (pTimings != NULL) {
+            pTimings->dDownloadMs += oClock.Lap();
+        }
+    }
+
+    template <typename... Args>
+    void Dispatch(int nChannels, Args... args) {
+        switch (nChannels) {
+        case 1:
+            FilterOnDevice<1>(args...);
+            break;
+        case 3:
+            FilterOnDevice<3>(args...);
+            break;
+        case 4:
+            FilterOnDevice<4>(args...);
+            break;
+        default:
+            NPP_ASSERT_MSG(false, "Unsupported channel count");
+        }
+    }
+
+ public:
+    std::string Name() const { return "npp"; }
+    // every call uploads and downloads its images, so a block per step
+    size_t ChainBlockBytes() const { return 0; }
+    // one upload, launch and download for the whole batch
+    bool StacksBatches() const { return true; }
+
+    void FilterBoxBorder(const Npp8u *pSrc, Npp32s nSrcStep,
+                         NppiSize oSrcSize, NppiPoint oSrcOffset, Npp8u *pDst,
+                         Npp32s nDstStep, NppiSize oSizeROI,
+                         NppiSize oMaskSize, NppiPoint oAnchor,
+                         int nChannels, StageTimings *pTimings) {
+        Dispatch(nChannels, pSrc, nSrcStep, oSrcSize, oSrcOffset, pDst,
+                 nDstStep, oSizeROI, oMaskSize, oAnchor,
+                 static_cast<const NppiMaskSize *>(NULL), pTimings);
+    }
+
+    void FilterGaussBorder(const Npp8u *pSrc, Npp32s nSrcStep,
+                           NppiSize oSrcSize, NppiPoint oSrcOffset,
+                           Npp8u *pDst, Npp32s nDstStep, NppiSize oSizeROI,
+                           NppiMaskSize eMaskSize, int nChannels,
+                           StageTimings *pTimings) {
+        NppiSize oUnusedMask = {0, 0};
+        NppiPoint oUnusedAnchor = {0, 0};
+        Dispatch(nChannels, pSrc, nSrcStep, oSrcSize, oSrcOffset, pDst,
+                 nDstStep, oSizeROI, oUnusedMask, oUnusedAnchor,
+                 static_cast<const NppiMaskSize *>(&eMaskSize), pTimings);
+    }
+};
+
+// Runs the filters on the host with the widest instruction set available, so
+// the tool also works on machines without a CUDA device.
+class CpuFilterBackend : public FilterBackend {
+    enumCpuIsa m_eIsa;
+    bool m_bSpecialized;
+    WorkStealingPool *m_pBandPool;
+
+    // Each band reads the halo rows of the mask around it from the shared
+    // source, so bands below this height redo too much of their neighbours'
+    // work to pay off
+    static const int kMinBandRows = 64;
+
+    // Split the ROI into row bands and run fBand(nRowBegin, nRowEnd) for each
+    // on the band pool; a few bands per core let idle threads steal the rest
+    template <typename BandFunction>
+    void RunBands(int nRows, const BandFunction &fBand) {
+        int nBands = 1;
+        if (m_pBandPool != NULL) {
+            nBands = std::min(nRows / kMinBandRows, 4 * m_pBandPool->Cores());
+        }
+        if (nBands <= 1) {
+            fBand(0, nRows);
+            return;
+        }
+        m_pBandPool->ParallelFor(nBands, [&](int nBand) {
+            fBand(nRows * nBand / nBands, nRows * (nBand + 1) / nBands);
+        });
+    }
+
+ public:
+    // eMaxIsa caps the detected instruction set, e.g. to compare code paths;
+    // bSpecialized false runs the generic kernels for every mask size;
+    // pBandPool, if given, filters the rows of each image in parallel bands
+    explicit CpuFilterBackend(enumCpuIsa eMaxIsa = CpuIsa_AVX2,
+                              bool bSpecialized = true,
+                              WorkStealingPool *pBandPool = NULL)
+        : m_eIsa(std::min(DetectCpuIsa(), eMaxIsa)),
+          m_bSpecialized(bSpecialized), m_pBandPool(pBandPool) {}
+
+    enumCpuIsa Isa() const { return m_eIsa; }
+    std::string Name() const {
+        return "cpu (" + CpuIsaDescription[m_eIsa] + ")";
+    }
+    // two intermediate blocks and the row buffers fit in a typical L2 cache
+    size_t ChainBlockBytes() const { return 256 * 1024; }
+
+    // A call costs next to nothing on the host, but small images are too
+    // short to split into bands; the images of a batch run in parallel
+    // instead, without being copied into a stack
+    void ForEachImage(int nImages, const std::function<void(int)> &fImage) {
+        if (m_pBandPool == NULL) {
+            FilterBackend::ForEachImage(nImages, fImage);
+            return;
+        }
+        m_pBandPool->ParallelFor(nImages, fImage);
+    }
+
+    void FilterBoxBorder(const Npp8u *pSrc, Npp32s nSrcStep,
+                         NppiSize oSrcSize, NppiPoint oSrcOffset, Npp8u *pDst,
+                         Npp32s nDstStep, NppiSize oSizeROI,
+                         NppiSize oMaskSize, NppiPoint oAnchor,
+                         int nChannels, StageTimings *pTimings) {
+        cpu::CheckBoxMask(oMaskSize, oAnchor);
+        StageClock oClock;
+        RunBands(oSizeROI.height, [&](int nRowBegin, int nRowEnd) {
+            cpu::FilterBoxBorderRows(pSrc, nSrcStep, oSrcSize, oSrcOffset,
+                                     pDst, nDstStep, oSizeROI, oMaskSize,
+                                     oAnchor, nChannels, m_eIsa, nRowBegin,
+                                     nRowEnd, m_bSpecialized);
+        });
+        if (pTimings != NULL) {
+            pTimings->dFilterMs += oClock.Lap();
+        }
+    }
+
+    void FilterGaussBorder(const Npp8u *pSrc, Npp32s nSrcStep,
+                           NppiSize oSrcSize, NppiPoint oSrcOffset,
+                           Npp8u *pDst, Npp32s nDstStep, NppiSize oSizeROI,
+                           NppiMaskSize eMaskSize, int nChannels,
+                           StageTimings *pTimings) {
+        StageClock oClock;
+        RunBands(oSizeROI.height, [&](int nRowBegin, int nRowEnd) {
+            cpu::FilterGaussBorderRows(pSrc, nSrcStep, oSrcSize, oSrcOffset,
+                                       pDst, nDstStep, oSizeROI, eMaskSize,
+                                       nChannels, m_eIsa, nRowBegin, nRowEnd,
+                                       m_bSpecialized);
+        });
+        if (pTimings != NULL) {
+            pTimings->dFilterMs += oClock.Lap();
+        }
+    }
+};
+
+// Filters colour images one plane at a time. The source rows are split into
+// one plane per channel, the wrapped backend filters every plane as a C1
+// image and the results are interleaved again, so the output is the same as
+// filtering the interleaved image. With bKeepAlpha the fourth channel of a C4
+// image is not filtered: every result pixel keeps the alpha of the source
+// pixel at its position.
+class PlanarFilterBackend : public FilterBackend {
+    std::shared_ptr<FilterBackend> m_pInner;
+    bool m_bKeepAlpha;
+    enumCpuIsa m_eIsa;
+
+    // fFilter(pSrcPlane, nSrcStep, pDstPlane, nDstStep) filters one plane
+    template <typename PlaneFilter>
+    void FilterPlanes(const Npp8u *pSrc, Npp32s nSrcStep, NppiSize oSrcSize,
+                      NppiPoint oSrcOffset, Npp8u *pDst, Npp32s nDstStep,
+                      NppiSize oSizeROI, int nChannels,
+                      StageTimings *pTimings, const PlaneFilter &fFilter) {
+        if (nChannels == 1) {
+            fFilter(pSrc, nSrcStep, pDst, nDstStep);
+            return;
+        }
+        NPP_ASSERT_MSG(nChannels == 3 || nChannels == 4,
+                       "Unsupported channel count");
+        StageClock oClock;
+        // the planes of an image lie one below the other in one buffer
+        PooledImageBuffer oSrcPlanes(&HostBufferPool(), oSrcSize.width,
+                                     oSrcSize.height * nChannels, 64);
+        PooledImageBuffer oDstPlanes(&HostBufferPool(), oSizeROI.width,
+                                     oSizeROI.height * nChannels, 64);
+        Npp8u *apSrcPlanes[cpu::kMaxChannels];
+        Npp8u *apDstPlanes[cpu::kMaxChannels];
+        for (int c = 0; c < nChannels; ++c) {
+            apSrcPlanes[c] = oSrcPlanes.data() + static_cast<ptrdiff_t>(c) *
+                                 oSrcSize.height * oSrcPlanes.pitch();
+            apDstPlanes[c] = oDstPlanes.data() + static_cast<ptrdiff_t>(c) *
+                                 oSizeROI.height * oDstPlanes.pitch();
+        }
+        cpu::DeinterleaveRows(pSrc, nSrcStep, oSrcSize.width, oSrcSize.height,
+                              nChannels, apSrcPlanes, oSrcPlanes.pitch(),
+                              m_eIsa);
+        double dConvertMs = oClock.Lap();
+
+        const bool bKeepAlpha = m_bKeepAlpha && nChannels == 4;
+        for (int c = 0; c < (bKeepAlpha ? 3 : nChannels); ++c) {
+            fFilter(apSrcPlanes[c], oSrcPlanes.pitch(), apDstPlanes[c],
+                    oDstPlanes.pitch());
+        }
+        oClock.Lap();
+        if (bKeepAlpha) {
+            if (oSrcOffset.x == 0 && oSrcOffset.y == 0 &&
+                oSrcSize.width == oSizeROI.width &&
+                oSrcSize.height == oSizeROI.height) {
+                apDstPlanes[3] = apSrcPlanes[3];
+            } else {
+                // a 1x1 box moves the alpha by the source offset and
+                // replicates it at the borders, as the colour filters do
+                NppiSize oPixel = {1, 1};
+                NppiPoint oOrigin = {0, 0};
+                m_pInner->FilterBoxBorder(apSrcPlanes[3], oSrcPlanes.pitch(),
+                                          oSrcSize, oSrcOffset,
+                                          apDstPlanes[3], oDstPlanes.pitch(),
+                                          oSizeROI, oPixel, oOrigin, 1,
+                                          pTimings);
+                oClock.Lap();
+            }
+        }
+        cpu::InterleaveRows(apDstPlanes, oDstPlanes.pitch(), oSizeROI.width,
+                            oSizeROI.height, nChannels, pDst, nDstStep,
+                            m_eIsa);
+        dConvertMs += oClock.Lap();
+        if (pTimings != NULL) {
+            pTimings->dFilterMs += dConvertMs;
+        }
+    }
+
+ public:
+    // eMaxIsa caps the instruction set of the layout conversions
+    PlanarFilterBackend(std::shared_ptr<FilterBackend> pInner,
+                        bool bKeepAlpha, enumCpuIsa eMaxIsa = CpuIsa_AVX2)
+        : m_pInner(pInner), m_bKeepAlpha(bKeepAlpha),
+          m_eIsa(std::min(DetectCpuIsa(), eMaxIsa)) {}
+
+    std::string Name() const {
+        return m_pInner->Name() +
+               (m_bKeepAlpha ? ", planar, alpha kept" : ", planar");
+    }
+    size_t ChainBlockBytes() const { return m_pInner->ChainBlockBytes(); }
+    bool StacksBatches() const { return m_pInner->StacksBatches(); }
+    void ForEachImage(int nImages, const std::function<void(int)> &fImage) {
+        m_pInner->ForEachImage(nImages, fImage);
+    }
+
+    void FilterBoxBorder(const Npp8u *pSrc, Npp32s nSrcStep,
+                         NppiSize oSrcSize, NppiPoint oSrcOffset, Npp8u *pDst,
+                         Npp32s nDstStep, NppiSize oSizeROI,
+                         NppiSize oMaskSize, NppiPoint oAnchor,
+                         int nChannels, StageTimings *pTimings) {
+        FilterPlanes(pSrc, nSrcStep, oSrcSize, oSrcOffset, pDst, nDstStep,
+                     oSizeROI, nChannels, pTimings,
+                     [&](const Npp8u *pSrcPlane, Npp32s nSrcPlaneStep,
+                         Npp8u *pDstPlane, Npp32s nDstPlaneStep) {
+            m_pInner->FilterBoxBorder(pSrcPlane, nSrcPlaneStep, oSrcSize,
+                                      oSrcOffset, pDstPlane, nDstPlaneStep,
+                                      oSizeROI, oMaskSize, oAnchor, 1,
+                                      pTimings);
+        });
+    }
+
+    void FilterGaussBorder(const Npp8u *pSrc, Npp32s nSrcStep,
+                           NppiSize oSrcSize, NppiPoint oSrcOffset,
+                           Npp8u *pDst, Npp32s nDstStep, NppiSize oSizeROI,
+                           NppiMaskSize eMaskSize, int nChannels,
+                           StageTimings *pTimings) {
+        FilterPlanes(pSrc, nSrcStep, oSrcSize, oSrcOffset, pDst, nDstStep,
+                     oSizeROI, nChannels, pTimings,
+                     [&](const Npp8u *pSrcPlane, Npp32s nSrcPlaneStep,
+                         Npp8u *pDstPlane, Npp32s nDstPlaneStep) {
+            m_pInner->FilterGaussBorder(pSrcPlane, nSrcPlaneStep, oSrcSize,
+                                        oSrcOffset, pDstPlane, nDstPlaneStep,
+                                        oSizeROI, eMaskSize, 1, pTimings);
+        });
+    }
+};
+
+// Map a name such as "cpu" to the backend; throws for unknown names
+inline enumFilterBackend FilterBackendFromString(const std::string &rName) {
+    for (size_t i = 0; i < FilterBackendDescription.size(); ++i) {
+        if (FilterBackendDescription[i] == rName) {
+            return static_cast<enumFilterBackend>(i);
+        }
+    }
+    throw npp::Exception("Unknown filter backend: " + rName);
+}
+
+// Resolve FilterBackend_Auto to NPP when a CUDA device is present
+inline enumFilterBackend ResolveFilterBackend(enumFilterBackend eBackend) {
+    if (eBackend != FilterBackend_Auto) {
+        return eBackend;
+    }
+    int nDeviceCount = 0;
+    if (cudaGetDeviceCount(&nDeviceCount) == cudaSuccess && nDeviceCount > 0) {
+        return FilterBackend_NPP;
+    }
+    return FilterBackend_CPU;
+}
+
+// pBandPool only applies to the CPU backend and must outlive it
+inline std::shared_ptr<FilterBackend> CreateFilterBackend(
+        enumFilterBackend eBackend, enumCpuIsa eMaxIsa = CpuIsa_AVX2,
+        WorkStealingPool *pBandPool = NULL) {
+    if (ResolveFilterBackend(eBackend) == FilterBackend_NPP) {
+        return std::make_shared<NppFilterBackend>();
+    }
+    return std::make_shared<CpuFilterBackend>(eMaxIsa, true, pBandPool);
+}
+#endif  //  SRC_FILTERBACKEND_H_
@@ -0,0 +1,573 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+// Micro-benchmark of the filter backends on synthetic images. Every case
+// (implementation, filter, mask, channel count, image size) is run a few
+// times untimed, then timed over a number of repetitions. One JSON object per
+// line is written for every case, preceded by a line describing the machine,
+// so results can be collected and compared over time. Each instruction set of
+// the CPU backend also comes as "-generic", which runs the generic kernels
+// instead of those specialized for the mask size and channel count; when both
+// are selected the specialized cases report their speedup over the generic.
+// "-planar" variants filter colour images one channel plane at a time,
+// conversions included. Every line carries a checksum of the filtered
+// pixels; a specialized case whose result differs from the generic one is
+// flagged, and the benchmark then fails.
+// With "-threads=N" the CPU backend filters each image in row bands on N
+// threads; "-threads=1,2,4,8" runs every case with each of the thread counts
+// and reports the speedup over one thread. "-batch=N" measures every case
+// on N images, once filtered one after the other ("single") and once as a
+// batch ("batched"): stacked into a single call for NPP (see ImageBatch), in
+// parallel on the band threads for the CPU. Both report the time per image,
+// and the batch the per-image overhead it saves.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <helper_string.h>
+
+#include "filterBackend.h"
+#include "imageBatch.h"
+#include "resultCache.h"
+
+#if FILTER_CPU_X86
+#include <x86intrin.h>
+#endif
+
+struct BenchSize {
+  int nWidth;
+  int nHeight;
+};
+
+struct BenchImpl {
+  std::string sName;
+  std::shared_ptr<FilterBackend> pBackend;
+  // the same backend with the generic kernels, if any
+  std::string sGeneric;
+  // threads of its band pool
+  int nThreads = 1;
+};
+
+struct BenchStats {
+  double dMean = 0.0;
+  double dStdDev = 0.0;
+  double dMin = 0.0;
+  double dMedian = 0.0;
+};
+
+// Reference cycles, or 0 where there is no cheap cycle counter
+inline unsigned long long readCycleCounter() {
+#if FILTER_CPU_X86
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+BenchStats computeStats(std::vector<double> aSamples) {
+  BenchStats oStats;
+  if (aSamples.empty()) {
+    return oStats;
+  }
+  std::sort(aSamples.begin(), aSamples.end());
+  double dSum = 0.0;
+  for (double dSample : aSamples) {
+    dSum += dSample;
+  }
+  oStats.dMean = dSum / aSamples.size();
+  double dSquares = 0.0;
+  for (double dSample : aSamples) {
+    dSquares += (dSample - oStats.dMean) * (dSample - oStats.dMean);
+  }
+  if (aSamples.size() > 1) {
+    oStats.dStdDev = std::sqrt(dSquares / (aSamples.size() - 1));
+  }
+  oStats.dMin = aSamples.front();
+  const size_t nMiddle = aSamples.size() / 2;
+  oStats.dMedian = aSamples.size() % 2 ? aSamples[nMiddle]
+                   : 0.5 * (aSamples[nMiddle - 1] + aSamples[nMiddle]);
+  return oStats;
+}
+
+// Comma separated list of integers, e.g. "-boxMasks=3,5,7"
+std::vector<int> parseIntList(const char *zList) {
+  std::vector<int> aValues;
+  std::string sList(zList);
+  size_t nStart = 0;
+  while (nStart <= sList.size()) {
+    size_t nEnd = sList.find(',', nStart);
+    if (nEnd == std::string::npos) {
+      nEnd = sList.size();
+    }
+    if (nEnd > nStart) {
+      aValues.push_back(atoi(sList.substr(nStart, nEnd - nStart).c_str()));
+    }
+    nStart = nEnd + 1;
+  }
+  return aValues;
+}
+
+// "-sizes=256,1024,7680x4320": N is a square image, WxH a rectangle
+std::vector<BenchSize> parseSizeList(const char *zList) {
+  std::vector<BenchSize> aSizes;
+  std::string sList(zList);
+  size_t nStart = 0;
+  while (nStart <= sList.size()) {
+    size_t nEnd = sList.find(',', nStart);
+    if (nEnd == std::string::npos) {
+      nEnd = sList.size();
+    }
+    BenchSize oSize = {0, 0};
+    int nParsed = sscanf(sList.substr(nStart, nEnd - nStart).c_str(),
+                         "%dx%d", &oSize.nWidth, &oSize.nHeight);
+    if (nParsed == 1) {
+      oSize.nHeight = oSize.nWidth;
+    }
+    NPP_ASSERT_MSG(nParsed >= 1 && oSize.nWidth > 0 && oSize.nHeight > 0,
+                   "Expected -sizes=N,WxH,...");
+    aSizes.push_back(oSize);
+    nStart = nEnd + 1;
+  }
+  return aSizes;
+}
+
+const char *getArgument(int argc, char *argv[], const char *zName) {
+  char *zValue = NULL;
+  if (checkCmdLineFlag(argc, (const char **)argv, zName)) {
+    getCmdLineArgumentString(argc, (const char **)argv, zName, &zValue);
+  }
+  return zValue;
+}
+
+// The implementations to compare: every instruction set of the CPU backend
+// this machine supports and NPP when a CUDA device is present. "-impl=" picks
+// some of them by name, e.g. "-impl=cpu-avx2,npp"; the generic kernels run
+// and the planar variants only when picked, e.g.
+// "-impl=cpu-avx2-generic,cpu-avx2,cpu-avx2-planar".
+std::vector<BenchImpl> makeImplementations(const char *zSelection,
+                                           WorkStealingPool *pBandPool) {
+  std::vector<BenchImpl> aImpls;
+  for (int nIsa = CpuIsa_Scalar; nIsa <= DetectCpuIsa(); ++nIsa) {
+    // the generic kernels go first, so their times are known when the
+    // specialized ones are measured
+    BenchImpl oGeneric;
+    oGeneric.sName = "cpu-" + CpuIsaDescription[nIsa] + "-generic";
+    oGeneric.pBackend = std::make_shared<CpuFilterBackend>(
+        static_cast<enumCpuIsa>(nIsa), false, pBandPool);
+    BenchImpl oImpl;
+    oImpl.sName = "cpu-" + CpuIsaDescription[nIsa];
+    oImpl.pBackend = std::make_shared<CpuFilterBackend>(
+        static_cast<enumCpuIsa>(nIsa), true, pBandPool);
+    oImpl.sGeneric = oGeneric.sName;
+    BenchImpl oPlanar;
+    oPlanar.sName = "cpu-" + CpuIsaDescription[nIsa] + "-planar";
+    oPlanar.pBackend = std::make_shared<PlanarFilterBackend>(
+        oImpl.pBackend, false, static_cast<enumCpuIsa>(nIsa));
+    if (zSelection != NULL) {
+      aImpls.push_back(oGeneric);
+    }
+    aImpls.push_back(oImpl);
+    if (zSelection != NULL) {
+      aImpls.push_back(oPlanar);
+    }
+  }
+  int nDevices = 0;
+  if (cudaGetDeviceCount(&nDevices) == cudaSuccess && nDevices > 0) {
+    BenchImpl oImpl;
+    // timings include the upload and download of the images
+    oImpl.sName = "npp";
+    oImpl.pBackend = std::make_shared<NppFilterBackend>();
+    aImpls.push_back(oImpl);
+  }
+  if (zSelection == NULL) {
+    return aImpls;
+  }
+  std::string sSelection = std::string(",") + zSelection + ",";
+  std::vector<BenchImpl> aSelected;
+  for (const BenchImpl &rImpl : aImpls) {
+    if (sSelection.find("," + rImpl.sName + ",") != std::string::npos) {
+      aSelected.push_back(rImpl);
+    }
+  }
+  return aSelected;
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    int nWarmup = 2;
+    int nReps = 10;
+    std::vector<int> aChannels = {1, 3, 4};
+    std::vector<BenchSize> aSizes = {{256, 256},   {512, 512},
+                                     {1024, 1024}, {2048, 2048},
+                                     {4096, 4096}, {7680, 4320}};
+    // box masks are square with the anchor in the center; gauss masks use
+    // the -maskSize numbering of filterNPP, 0 (1x3) to 10 (15x15)
+    std::vector<int> aBoxMasks = {3, 5, 7, 9, 15, 25};
+    std::vector<int> aGaussMasks = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    const NppiMaskSize aGaussMaskSizes[] = {
+        NPP_MASK_SIZE_1_X_3, NPP_MASK_SIZE_1_X_5, NPP_MASK_SIZE_3_X_1,
+        NPP_MASK_SIZE_5_X_1, NPP_MASK_SIZE_3_X_3, NPP_MASK_SIZE_5_X_5,
+        NPP_MASK_SIZE_7_X_7, NPP_MASK_SIZE_9_X_9, NPP_MASK_SIZE_11_X_11,
+        NPP_MASK_SIZE_13_X_13, NPP_MASK_SIZE_15_X_15};
+    std::string sFilters = "box,gauss";
+    std::vector<int> aThreads = {1};
+    int nBatch = 1;
+
+    const char *zValue;
+    if ((zValue = getArgument(argc, argv, "warmup")) != NULL) {
+      nWarmup = std::max(atoi(zValue), 0);
+    }
+    if ((zValue = getArgument(argc, argv, "reps")) != NULL) {
+      nReps = std::max(atoi(zValue), 1);
+    }
+    if ((zValue = getArgument(argc, argv, "channels")) != NULL) {
+      aChannels = parseIntList(zValue);
+    }
+    if ((zValue = getArgument(argc, argv, "sizes")) != NULL) {
+      aSizes = parseSizeList(zValue);
+    }
+    if ((zValue = getArgument(argc, argv, "boxMasks")) != NULL) {
+      aBoxMasks = parseIntList(zValue);
+    }
+    if ((zValue = getArgument(argc, argv, "gaussMasks")) != NULL) {
+      aGaussMasks = parseIntList(zValue);
+    }
+    if ((zValue = getArgument(argc, argv, "filter")) != NULL) {
+      sFilters = zValue;
+    }
+    if ((zValue = getArgument(argc, argv, "threads")) != NULL) {
+      aThreads = parseIntList(zValue);
+      for (int &rThreads : aThreads) {
+        rThreads = std::max(rThreads, 1);
+      }
+    }
+    if ((zValue = getArgument(argc, argv, "batch")) != NULL) {
+      nBatch = std::max(atoi(zValue), 1);
+    }
+    FILE *pOutput = stdout;
+    if ((zValue = getArgument(argc, argv, "output")) != NULL) {
+      pOutput = fopen(zValue, "w");
+      NPP_ASSERT_MSG(pOutput != NULL, "Cannot open the benchmark output");
+    }
+    // the implementations once per thread count, each with its own band
+    // pool; NPP does not use them and runs once
+    std::vector<std::unique_ptr<WorkStealingPool>> aBandPools;
+    std::vector<BenchImpl> aImpls;
+    std::string sThreadList;
+    for (int nThreads : aThreads) {
+      aBandPools.push_back(std::make_unique<WorkStealingPool>(nThreads));
+      for (BenchImpl oImpl : makeImplementations(
+               getArgument(argc, argv, "impl"), aBandPools.back().get())) {
+        oImpl.nThreads = nThreads;
+        if (oImpl.sName != "npp" || nThreads == aThreads[0]) {
+          aImpls.push_back(oImpl);
+        }
+      }
+      sThreadList += (sThreadList.empty() ? "" : ",") +
+                     std::to_string(nThreads);
+    }
+
+    fprintf(pOutput,
+            "{\"benchmark\":\"filterBench\",\"cpu_isa\":\"%s\","
+            "\"cores\":%u,\"threads\":[%s],\"batch\":%d,\"warmup\":%d,"
+            "\"reps\":%d,\"cycles\":\"%s\"}\n",
+            CpuIsaDescription[DetectCpuIsa()].c_str(),
+            std::thread::hardware_concurrency(), sThreadList.c_str(), nBatch,
+            nWarmup, nReps, FILTER_CPU_X86 ? "tsc" : "none");
+    fflush(pOutput);
+
+    // one source image of the largest size, filled with the same pseudo
+    // random pixels on every run; smaller cases use its first bytes
+    size_t nMaxBytes = 0;
+    for (const BenchSize &rSize : aSizes) {
+      nMaxBytes = std::max(nMaxBytes,
+                           static_cast<size_t>(rSize.nWidth) * 4 *
+                               rSize.nHeight);
+    }
+    std::vector<Npp8u> aSrc(nMaxBytes), aDst(nMaxBytes);
+    std::mt19937 oRandom(20231);
+    for (Npp8u &rPixel : aSrc) {
+      rPixel = static_cast<Npp8u>(oRandom() >> 24);
+    }
+    // median times and result checksums of every case, to compare
+    // implementations with
+    std::map<std::string, double> aMedians;
+    std::map<std::string, uint64_t> aChecksums;
+    int nMismatches = 0;
+
+    for (const BenchImpl &rImpl : aImpls) {
+      for (int nChannels : aChannels) {
+        for (const BenchSize &rSize : aSizes) {
+          const NppiSize oSize = {rSize.nWidth, rSize.nHeight};
+          const Npp32s nPitch = rSize.nWidth * nChannels;
+          const NppiPoint oOffset = {0, 0};
+
+          // the images of a batch, each in its own buffer like decoded
+          // images, with different pixels
+          const size_t nImageBytes = static_cast<size_t>(nPitch) *
+                                     rSize.nHeight;
+          std::vector<std::vector<Npp8u>> aBatchSrc, aBatchDst;
+          std::vector<npp::ImageView> aSrcViews, aDstViews;
+          for (int i = 0; i < nBatch && nBatch > 1; ++i) {
+            aBatchSrc.emplace_back(nImageBytes);
+            aBatchDst.emplace_back(nImageBytes);
+            for (size_t j = 0; j < nImageBytes; ++j) {
+              aBatchSrc[i][j] = aSrc[(j + 7919 * i) % aSrc.size()];
+            }
+            npp::ImageView oView;
+            oView.nPitch = nPitch;
+            oView.nWidth = rSize.nWidth;
+            oView.nHeight = rSize.nHeight;
+            oView.nChannels = nChannels;
+            oView.pData = aBatchSrc[i].data();
+            aSrcViews.push_back(oView);
+            oView.pData = aBatchDst[i].data();
+            aDstViews.push_back(oView);
+          }
+
+          // run one case and write its line; rMode is "single" or
+          // "batched" for the nBatch images of a batch case, otherwise
+          // empty
+          auto fMeasure = [&](const char *zFilter, const std::string &rMask,
+                              const std::string &rMode, auto fRun) {
+            for (int i = 0; i < nWarmup; ++i) {
+              fRun();
+            }
+            std::vector<double> aMillis, aCycles;
+            for (int i = 0; i < nReps; ++i) {
+              auto oStart = std::chrono::steady_clock::now();
+              unsigned long long nStartCycles = readCycleCounter();
+              fRun();
+              unsigned long long nEndCycles = readCycleCounter();
+              auto oEnd = std::chrono::steady_clock::now();
+              aMillis.push_back(
+                  std::chrono::duration<double, std::milli>(oEnd - oStart)
+                      .count());
+              aCycles.push_back(static_cast<double>(nEndCycles -
+                                                    nStartCycles));
+            }
+            BenchStats oTime = computeStats(aMillis);
+            BenchStats oCycles = computeStats(aCycles);
+            const std::string sSize = std::to_string(rSize.nWidth) + "x" +
+                                      std::to_string(rSize.nHeight);
+            const std::string sCase = std::string(zFilter) + "/" + rMask +
+                                      "/" + std::to_string(nChannels) + "/" +
+                                      sSize;
+            // cases are compared with those of the same thread count
+            const std::string sThreads = "@" + std::to_string(rImpl.nThreads);
+            aMedians[rImpl.sName + sThreads + "/" + sCase + "/" + rMode] =
+                oTime.dMedian;
+            // the result of the last repetition
+            uint64_t nChecksum = 0;
+            if (rMode.empty()) {
+              nChecksum = HashBytes64(aDst.data(), nImageBytes);
+            } else {
+              for (const std::vector<Npp8u> &rDst : aBatchDst) {
+                nChecksum = HashBytes64(rDst.data(), rDst.size(), nChecksum);
+              }
+            }
+            aChecksums[rImpl.sName + sThreads + "/" + sCase + "/" + rMode] =
+                nChecksum;
+            char aSpeedup[128] = "";
+            auto itGeneric = aMedians.find(rImpl.sGeneric + sThreads + "/" +
+                                           sCase + "/" + rMode);
+            if (!rImpl.sGeneric.empty() && itGeneric != aMedians.end()) {
+              const bool bMatches =
+                  aChecksums[rImpl.sGeneric + sThreads + "/" + sCase + "/" +
+                             rMode] == nChecksum;
+              nMismatches += bMatches ? 0 : 1;
+              snprintf(aSpeedup, sizeof(aSpeedup),
+                       ",\"generic_ms\":%.4f,\"speedup\":%.3f,"
+                       "\"matches_generic\":%s",
+                       itGeneric->second, itGeneric->second / oTime.dMedian,
+                       bMatches ? "true" : "false");
+            }
+            const int nImages = rMode.empty() ? 1 : nBatch;
+            char aBatch[160] = "";
+            if (!rMode.empty()) {
+              const double dPerImage = oTime.dMedian / nImages;
+              int nChars = snprintf(aBatch, sizeof(aBatch),
+                                    ",\"mode\":\"%s\",\"images\":%d,"
+                                    "\"per_image_ms\":%.4f",
+                                    rMode.c_str(), nImages, dPerImage);
+              // the time per image the batch saves, mostly per-call setup
+              // and transfers
+              auto itSingle = aMedians.find(rImpl.sName + sThreads + "/" +
+                                            sCase + "/single");
+              if (rMode == "batched" && itSingle != aMedians.end()) {
+                snprintf(aBatch + nChars, sizeof(aBatch) - nChars,
+                         ",\"overhead_ms\":%.4f",
+                         itSingle->second / nImages - dPerImage);
+              }
+            }
+            char aScaling[48] = "";
+            auto itOneThread =
+                aMedians.find(rImpl.sName + "@1/" + sCase + "/" + rMode);
+            if (rImpl.nThreads > 1 && itOneThread != aMedians.end()) {
+              snprintf(aScaling, sizeof(aScaling),
+                       ",\"speedup_vs_1_thread\":%.3f",
+                       itOneThread->second / oTime.dMedian);
+            }
+            const double dPixels =
+                static_cast<double>(rSize.nWidth) * rSize.nHeight * nImages;
+            // every pixel is read once and written once
+            const double dBytes = 2.0 * dPixels * nChannels;
+            fprintf(pOutput,
+                    "{\"impl\":\"%s\",\"threads\":%d,\"filter\":\"%s\","
+                    "\"mask\":\"%s\",\"channels\":%d,\"width\":%d,"
+                    "\"height\":%d,\"reps\":%d,"
+                    "\"mean_ms\":%.4f,\"stddev_ms\":%.4f,"
+                    "\"min_ms\":%.4f,\"median_ms\":%.4f,"
+                    "\"mpixel_per_s\":%.2f,\"bytes_per_cycle\":%.4f,"
+                    "\"checksum\":\"%016llx\"%s%s%s}\n",
+                    rImpl.sName.c_str(), rImpl.nThreads, zFilter,
+                    rMask.c_str(), nChannels,
+                    rSize.nWidth, rSize.nHeight, nReps, oTime.dMean,
+                    oTime.dStdDev, oTime.dMin, oTime.dMedian,
+                    dPixels / (oTime.dMedian * 1000.0),
+                    oCycles.dMedian > 0 ? dBytes / oCycles.dMedian : 0.0,
+                    static_cast<unsigned long long>(nChecksum), aSpeedup,
+                    aScaling, aBatch);
+            fflush(pOutput);
+          };
+
+          // the images of a batch filtered one after the other, then as a
+          // batch; fFilter(pSrc, nStep, oSrcSize, oSrcOffset, pDst, oROI)
+          // runs the filter of the case
+          auto fMeasureBatch = [&](const char *zFilter,
+                                   const std::string &rMask, int nMaskAbove,
+                                   int nMaskBelow, auto fFilter) {
+            fMeasure(zFilter, rMask, "single", [&] {
+              for (int i = 0; i < nBatch; ++i) {
+                fFilter(aSrcViews[i].pData, nPitch, oSize, oOffset,
+                        aDstViews[i].pData, oSize);
+              }
+            });
+            int nAbove = 0, nBelow = 0;
+            ImageBatch::Halo(nMaskAbove, nMaskBelow, oOffset.y, &nAbove,
+                             &nBelow);
+            fMeasure(zFilter, rMask, "batched", [&] {
+              if (!rImpl.pBackend->StacksBatches()) {
+                rImpl.pBackend->ForEachImage(nBatch, [&](int i) {
+                  fFilter(aSrcViews[i].pData, nPitch, oSize, oOffset,
+                          aDstViews[i].pData, oSize);
+                });
+                return;
+              }
+              ImageBatch oBatch(&HostBufferPool(), aSrcViews, nAbove,
+                                nBelow);
+              fFilter(oBatch.src(), oBatch.pitch(), oBatch.srcSize(),
+                      oBatch.srcOffset(oOffset), oBatch.dst(),
+                      oBatch.roiSize());
+              oBatch.Unstack(aDstViews);
+            });
+          };
+
+          if (sFilters.find("box") != std::string::npos) {
+            for (int nMask : aBoxMasks) {
+              const NppiSize oMask = {nMask, nMask};
+              const NppiPoint oAnchor = {nMask / 2, nMask / 2};
+              const std::string sMask =
+                  std::to_string(nMask) + "x" + std::to_string(nMask);
+              auto fFilter = [&](const Npp8u *pSrc, Npp32s nStep,
+                                 NppiSize oSrcSize, NppiPoint oSrcOffset,
+                                 Npp8u *pDst, NppiSize oROI) {
+                rImpl.pBackend->FilterBoxBorder(
+                    pSrc, nStep, oSrcSize, oSrcOffset, pDst, nStep,
+                    oROI, oMask, oAnchor, nChannels, NULL);
+              };
+              if (nBatch == 1) {
+                fMeasure("box", sMask, "", [&] {
+                  fFilter(aSrc.data(), nPitch, oSize, oOffset, aDst.data(),
+                          oSize);
+                });
+              } else {
+                fMeasureBatch("box", sMask, oAnchor.y,
+                              oMask.height - 1 - oAnchor.y, fFilter);
+              }
+            }
+          }
+          if (sFilters.find("gauss") != std::string::npos) {
+            for (int nMask : aGaussMasks) {
+              NPP_ASSERT_MSG(nMask >= 0 && nMask <= 10,
+                             "Gauss masks are numbered 0 to 10");
+              const NppiMaskSize eMask = aGaussMaskSizes[nMask];
+              const NppiSize oDims = cpu::GaussMaskDims(eMask);
+              const std::string sMask = std::to_string(oDims.width) + "x" +
+                                        std::to_string(oDims.height);
+              auto fFilter = [&](const Npp8u *pSrc, Npp32s nStep,
+                                 NppiSize oSrcSize, NppiPoint oSrcOffset,
+                                 Npp8u *pDst, NppiSize oROI) {
+                rImpl.pBackend->FilterGaussBorder(
+                    pSrc, nStep, oSrcSize, oSrcOffset, pDst, nStep,
+                    oROI, eMask, nChannels, NULL);
+              };
+              if (nBatch == 1) {
+                fMeasure("gauss", sMask, "", [&] {
+                  fFilter(aSrc.data(), nPitch, oSize, oOffset, aDst.data(),
+                          oSize);
+                });
+              } else {
+                fMeasureBatch("gauss", sMask, oDims.height / 2,
+                              oDims.height / 2, fFilter);
+              }
+            }
+          }
+        }
+      }
+    }
+    if (pOutput != stdout) {
+      fclose(pOutput);
+    }
+    if (nMismatches > 0) {
+      std::cerr << nMismatches
+                << " cases differ from the generic kernels" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  catch (npp::Exception &rException) {
+    std::cerr << "Program error! The following exception occurred: \n";
+    std::cerr << rException << std::endl;
+    std::cerr << "Aborting." << std::endl;
+
+    exit(EXIT_FAILURE);
+  }
+  return 0;
+}
@@ -0,0 +1,978 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_FILTERKERNELSCPU_H_
+#define SRC_FILTERKERNELSCPU_H_
+
+#include <npp.h>
+#include <string.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "cpuFeatures.h"
+
+// Host implementations of nppiFilterBoxBorder_8u_C*R and
+// nppiFilterGaussBorder_8u_C*R with NPP_BORDER_REPLICATE. All kernels work on
+// interleaved rows as plain bytes: moving one pixel to the right is a step of
+// nChannels bytes, so a single code path serves the C1, C3 and C4 layouts.
+//
+// The inner kernels are templates over the tap count kTaps and the channel
+// count kChannels. The masks in common use get kernels with both fixed at
+// compile time, so their loops unroll and the weights stay in registers; a
+// template argument of 0 takes the count from the runtime argument instead,
+// which is the generic kernel for any other mask.
+namespace cpu {
+
+// Above this mask area the float reciprocal used to divide box sums is no
+// longer exact for every 8-bit sum, so the integer division is used instead.
+const int kMaxFloatDivideArea = 8192;
+
+// Most interleaved channels of an image, as in NPP's C4 layout
+const int kMaxChannels = 4;
+
+// kFixed when a kernel is specialized for it, otherwise nRuntime
+template <int kFixed>
+inline int FixedOr(int nRuntime) {
+    return kFixed > 0 ? kFixed : nRuntime;
+}
+
+inline int ClampInt(int nValue, int nLow, int nHigh) {
+    return nValue < nLow ? nLow : (nValue > nHigh ? nHigh : nValue);
+}
+
+inline const Npp8u *SrcRow(const Npp8u *pSrc, Npp32s nSrcStep, int nY) {
+    return pSrc + static_cast<ptrdiff_t>(nY) * nSrcStep;
+}
+
+inline Npp8u *DstRow(Npp8u *pDst, Npp32s nDstStep, int nY) {
+    return pDst + static_cast<ptrdiff_t>(nY) * nDstStep;
+}
+
+// Per-thread scratch memory that keeps its capacity between calls, so the
+// kernels stop allocating once they have seen the largest image. nTag tells
+// apart buffers of the same type that are in use at the same time.
+template <typename T, int nTag>
+inline T *ScratchBuffer(size_t nCount) {
+    thread_local std::vector<T> aBuffer;
+    if (aBuffer.size() < nCount) {
+        aBuffer.resize(nCount);
+    }
+    return aBuffer.data();
+}
+
+// Number of horizontal and vertical taps of an NPP Gauss mask. The
+// NPP_MASK_SIZE_W_X_H names list the width first, the same order as NppiSize.
+inline NppiSize GaussMaskDims(NppiMaskSize eMaskSize) {
+    switch (eMaskSize) {
+    case NPP_MASK_SIZE_1_X_3:
+        return {1, 3};
+    case NPP_MASK_SIZE_1_X_5:
+        return {1, 5};
+    case NPP_MASK_SIZE_3_X_1:
+        return {3, 1};
+    case NPP_MASK_SIZE_5_X_1:
+        return {5, 1};
+    case NPP_MASK_SIZE_3_X_3:
+        return {3, 3};
+    case NPP_MASK_SIZE_7_X_7:
+        return {7, 7};
+    case NPP_MASK_SIZE_9_X_9:
+        return {9, 9};
+    case NPP_MASK_SIZE_11_X_11:
+        return {11, 11};
+    case NPP_MASK_SIZE_13_X_13:
+        return {13, 13};
+    case NPP_MASK_SIZE_15_X_15:
+        return {15, 15};
+    case NPP_MASK_SIZE_5_X_5:
+    default:
+        return {5, 5};
+    }
+}
+
+// Largest number of taps of a Gauss mask, NPP_MASK_SIZE_15_X_15
+const int kMaxGaussTaps = 15;
+
+// Normalized 1D Gaussian weights as used by nppiFilterGaussBorder, which
+// derives sigma from the mask size as 0.4 + (size / 2) * 0.6.
+inline void GaussKernel1D(int nTaps, float *aWeights) {
+    const float fSigma = 0.4f + (nTaps / 2) * 0.6f;
+    float fSum = 0.0f;
+    for (int i = 0; i < nTaps; ++i) {
+        const float fX = static_cast<float>(i - nTaps / 2);
+        aWeights[i] = expf(-(fX * fX) / (2.0f * fSigma * fSigma));
+        fSum += aWeights[i];
+    }
+    for (int i = 0; i < nTaps; ++i) {
+        aWeights[i] /= fSum;
+    }
+}
+
+// Copy nPaddedWidth pixels starting at column nStartX of a source row into
+// pDst, replicating the first and last pixel for columns outside the row.
+template <typename T>
+inline void PadRowReplicate(const T *pSrcRow, int nSrcWidth, int nChannels,
+                            int nStartX, int nPaddedWidth, T *pDst) {
+    const int nLeft = std::min(std::max(-nStartX, 0), nPaddedWidth);
+    const int nCopyBegin = std::max(nStartX, 0);
+    const int nCopyEnd = std::min(nStartX + nPaddedWidth, nSrcWidth);
+    const int nCopy = std::max(nCopyEnd - nCopyBegin, 0);
+    const int nRight = nPaddedWidth - nLeft - nCopy;
+    const size_t nPixelBytes = sizeof(T) * nChannels;
+    const T *pLast = pSrcRow + (nSrcWidth - 1) * nChannels;
+
+    for (int i = 0; i < nLeft; ++i) {
+        memcpy(pDst + i * nChannels, pSrcRow, nPixelBytes);
+    }
+    memcpy(pDst + nLeft * nChannels, pSrcRow + nCopyBegin * nChannels,
+           nCopy * nPixelBytes);
+    for (int i = 0; i < nRight; ++i) {
+        memcpy(pDst + (nLeft + nCopy + i) * nChannels, pLast, nPixelBytes);
+    }
+}
+
+// Rows of type T cached in a ring keyed by the unclamped source row number.
+// Moving the destination down by one row then computes only the single row
+// that entered the mask.
+template <typename T>
+class RowRing {
+    size_t m_nRowSize;
+    int m_nRows;
+    T *m_pBuffer;
+    int *m_pRowIndex;
+
+ public:
+    RowRing(size_t nRowSize, int nRows)
+        : m_nRowSize(nRowSize), m_nRows(nRows),
+          m_pBuffer(ScratchBuffer<T, 0>(nRowSize * nRows)),
+          m_pRowIndex(ScratchBuffer<int, 0>(nRows)) {
+        std::fill(m_pRowIndex, m_pRowIndex + nRows, INT_MIN);
+    }
+
+    // Slot for row nY; *pbCached tells whether it already holds that row
+    T *Slot(int nY, bool *pbCached) {
+        const int nSlot = ((nY % m_nRows) + m_nRows) % m_nRows;
+        *pbCached = m_pRowIndex[nSlot] == nY;
+        m_pRowIndex[nSlot] = nY;
+        return m_pBuffer + nSlot * m_nRowSize;
+    }
+};
+
+//******************************************************************************//
+// Box filter
+//
+// The box filter is computed with running sums. Column sums over the mask
+// height are updated by adding the source row that enters the mask and
+// subtracting the one that leaves it, and each output row is a running sum of
+// those column sums along x. The cost per pixel is therefore the same for a
+// 3x3 and a 25x25 mask.
+
+// pColumns[b] += pAdd[b] - pSub[b] for bytes nBegin <= b < nEnd
+inline void BoxColumnUpdateScalar(const Npp8u *pAdd, const Npp8u *pSub,
+                                  int nBegin, int nEnd, Npp32s *pColumns) {
+    for (int b = nBegin; b < nEnd; ++b) {
+        pColumns[b] += static_cast<Npp32s>(pAdd[b]) - pSub[b];
+    }
+}
+
+// Sliding sum of nTaps padded column sums along the row, one per byte. The
+// running sums of the channels of a pixel are kept apart, which a fixed
+// channel count keeps in registers.
+template <int kTaps, int kChannels>
+inline void BoxRowSumScalar(const Npp32s *pPadded, int nTaps, int nChannels,
+                            int nBytes, Npp32u *pSums) {
+    nTaps = FixedOr<kTaps>(nTaps);
+    nChannels = FixedOr<kChannels>(nChannels);
+    if (nBytes <= 0) {
+        return;
+    }
+    Npp32s aSums[kMaxChannels];
+    for (int c = 0; c < nChannels; ++c) {
+        aSums[c] = 0;
+        for (int i = 0; i < nTaps; ++i) {
+            aSums[c] += pPadded[c + i * nChannels];
+        }
+        pSums[c] = aSums[c];
+    }
+    const Npp32s *pEnter = pPadded + nTaps * nChannels;
+    for (int b = nChannels; b < nBytes; b += nChannels) {
+        for (int c = 0; c < nChannels; ++c) {
+            aSums[c] += pEnter[b - nChannels + c] - pPadded[b - nChannels + c];
+            pSums[b + c] = aSums[c];
+        }
+    }
+}
+
+// Rounded quotient (nSum + nArea / 2) / nArea for bytes nBegin <= b < nEnd
+inline void BoxDivideScalar(const Npp32u *pSums, int nBegin, int nEnd,
+                            int nArea, Npp8u *pDst) {
+    if (nArea <= kMaxFloatDivideArea) {
+        // same arithmetic as the vector paths so every ISA rounds alike
+        const float fInv = 1.0f / nArea;
+        const float fBias = 0.5f + 0.25f / nArea;
+        for (int b = nBegin; b < nEnd; ++b) {
+            pDst[b] = static_cast<Npp8u>(
+                static_cast<int>(static_cast<float>(pSums[b]) * fInv + fBias));
+        }
+    } else {
+        const Npp32u nHalf = nArea / 2;
+        for (int b = nBegin; b < nEnd; ++b) {
+            pDst[b] = static_cast<Npp8u>((pSums[b] + nHalf) / nArea);
+        }
+    }
+}
+
+#ifdef FILTER_CPU_X86
+// BoxRowSumScalar with the running sums of a C3 or C4 pixel in one register.
+// A C3 pixel is loaded and stored as four lanes: the extra lane is overwritten
+// by the next pixel, and pPadded and pSums have room for one more element
+// after the last pixel.
+template <int kTaps, int kChannels>
+FILTER_TARGET_SSE2 inline void BoxRowSumSSE2(const Npp32s *pPadded,
+                                             int nTaps, int nBytes,
+                                             Npp32u *pSums) {
+    static_assert(kChannels == 3 || kChannels == 4,
+                  "A pixel of C3 or C4 fits in one register");
+    nTaps = FixedOr<kTaps>(nTaps);
+    if (nBytes <= 0) {
+        return;
+    }
+    __m128i vSum = _mm_setzero_si128();
+    for (int i = 0; i < nTaps; ++i) {
+        vSum = _mm_add_epi32(vSum, _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(pPadded + i * kChannels)));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(pSums), vSum);
+    const Npp32s *pEnter = pPadded + nTaps * kChannels;
+    for (int b = kChannels; b < nBytes; b += kChannels) {
+        const __m128i vDelta = _mm_sub_epi32(
+            _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(pEnter + b - kChannels)),
+            _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(pPadded + b - kChannels)));
+        vSum = _mm_add_epi32(vSum, vDelta);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pSums + b), vSum);
+    }
+}
+
+FILTER_TARGET_SSE2 inline void BoxColumnUpdateSSE2(
+        const Npp8u *pAdd, const Npp8u *pSub, int nBegin, int nEnd,
+        Npp32s *pColumns) {
+    const __m128i vZero = _mm_setzero_si128();
+    int b = nBegin;
+    for (; b + 16 <= nEnd; b += 16) {
+        const __m128i vAdd = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(pAdd + b));
+        const __m128i vSub = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(pSub + b));
+        // differences of two bytes fit in 16 bits, then sign extend to 32
+        const __m128i vLo = _mm_sub_epi16(_mm_unpacklo_epi8(vAdd, vZero),
+                                          _mm_unpacklo_epi8(vSub, vZero));
+        const __m128i vHi = _mm_sub_epi16(_mm_unpackhi_epi8(vAdd, vZero),
+                                          _mm_unpackhi_epi8(vSub, vZero));
+        __m128i vDelta[4];
+        vDelta[0] = _mm_srai_epi32(_mm_unpacklo_epi16(vZero, vLo), 16);
+        vDelta[1] = _mm_srai_epi32(_mm_unpackhi_epi16(vZero, vLo), 16);
+        vDelta[2] = _mm_srai_epi32(_mm_unpacklo_epi16(vZero, vHi), 16);
+        vDelta[3] = _mm_srai_epi32(_mm_unpackhi_epi16(vZero, vHi), 16);
+        __m128i *pOut = reinterpret_cast<__m128i *>(pColumns + b);
+        for (int k = 0; k < 4; ++k) {
+            _mm_storeu_si128(pOut + k, _mm_add_epi32(
+                _mm_loadu_si128(pOut + k), vDelta[k]));
+        }
+    }
+    BoxColumnUpdateScalar(pAdd, pSub, b, nEnd, pColumns);
+}
+
+FILTER_TARGET_SSE2 inline void BoxDivideSSE2(const Npp32u *pSums, int nBytes,
+                                             int nArea, Npp8u *pDst) {
+    if (nArea > kMaxFloatDivideArea) {
+        BoxDivideScalar(pSums, 0, nBytes, nArea, pDst);
+        return;
+    }
+    const __m128 vInv = _mm_set1_ps(1.0f / nArea);
+    const __m128 vBias = _mm_set1_ps(0.5f + 0.25f / nArea);
+    int b = 0;
+    for (; b + 16 <= nBytes; b += 16) {
+        __m128i vQ[4];
+        for (int k = 0; k < 4; ++k) {
+            const __m128 vSum = _mm_cvtepi32_ps(_mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(pSums + b + 4 * k)));
+            vQ[k] = _mm_cvttps_epi32(
+                _mm_add_ps(_mm_mul_ps(vSum, vInv), vBias));
+        }
+        const __m128i vLo = _mm_packs_epi32(vQ[0], vQ[1]);
+        const __m128i vHi = _mm_packs_epi32(vQ[2], vQ[3]);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + b),
+                         _mm_packus_epi16(vLo, vHi));
+    }
+    BoxDivideScalar(pSums, b, nBytes, nArea, pDst);
+}
+
+FILTER_TARGET_AVX2 inline void BoxColumnUpdateAVX2(
+        const Npp8u *pAdd, const Npp8u *pSub, int nBegin, int nEnd,
+        Npp32s *pColumns) {
+    int b = nBegin;
+    for (; b + 16 <= nEnd; b += 16) {
+        for (int k = 0; k < 2; ++k) {
+            const __m256i vAdd = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+                reinterpret_cast<const __m128i *>(pAdd + b + 8 * k)));
+            const __m256i vSub = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+                reinterpret_cast<const __m128i *>(pSub + b + 8 * k)));
+            __m256i *pOut = reinterpret_cast<__m256i *>(pColumns + b + 8 * k);
+            _mm256_storeu_si256(pOut, _mm256_add_epi32(
+                _mm256_loadu_si256(pOut), _mm256_sub_epi32(vAdd, vSub)));
+        }
+    }
+    BoxColumnUpdateScalar(pAdd, pSub, b, nEnd, pColumns);
+}
+
+FILTER_TARGET_AVX2 inline void BoxDivideAVX2(const Npp32u *pSums, int nBytes,
+                                             int nArea, Npp8u *pDst) {
+    if (nArea > kMaxFloatDivideArea) {
+        BoxDivideScalar(pSums, 0, nBytes, nArea, pDst);
+        return;
+    }
+    const __m256 vInv = _mm256_set1_ps(1.0f / nArea);
+    const __m256 vBias = _mm256_set1_ps(0.5f + 0.25f / nArea);
+    int b = 0;
+    for (; b + 16 <= nBytes; b += 16) {
+        __m256i vQ[2];
+        for (int k = 0; k < 2; ++k) {
+            const __m256 vSum = _mm256_cvtepi32_ps(_mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(pSums + b + 8 * k)));
+            vQ[k] = _mm256_cvttps_epi32(
+                _mm256_add_ps(_mm256_mul_ps(vSum, vInv), vBias));
+        }
+        // packs work per 128-bit lane, so restore the pixel order afterwards
+        const __m256i vWords = _mm256_permute4x64_epi64(
+            _mm256_packs_epi32(vQ[0], vQ[1]), 0xD8);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + b),
+                         _mm_packus_epi16(_mm256_castsi256_si128(vWords),
+                                          _mm256_extracti128_si256(vWords, 1)));
+    }
+    BoxDivideScalar(pSums, b, nBytes, nArea, pDst);
+}
+#endif  // FILTER_CPU_X86
+
+inline void BoxColumnUpdate(const Npp8u *pAdd, const Npp8u *pSub, int nBegin,
+                            int nEnd, Npp32s *pColumns, enumCpuIsa eIsa) {
+    switch (eIsa) {
+#ifdef FILTER_CPU_X86
+    case CpuIsa_AVX2:
+        BoxColumnUpdateAVX2(pAdd, pSub, nBegin, nEnd, pColumns);
+        break;
+    case CpuIsa_SSE2:
+        BoxColumnUpdateSSE2(pAdd, pSub, nBegin, nEnd, pColumns);
+        break;
+#endif
+    default:
+        BoxColumnUpdateScalar(pAdd, pSub, nBegin, nEnd, pColumns);
+        break;
+    }
+}
+
+template <int kTaps, int kChannels>
+inline void BoxRowSum(const Npp32s *pPadded, int nTaps, int nChannels,
+                      int nBytes, Npp32u *pSums, enumCpuIsa eIsa) {
+    switch (eIsa) {
+#ifdef FILTER_CPU_X86
+    case CpuIsa_AVX2:
+    case CpuIsa_SSE2:
+        if constexpr (kChannels == 3 || kChannels == 4) {
+            BoxRowSumSSE2<kTaps, kChannels>(pPadded, nTaps, nBytes, pSums);
+            break;
+        }
+        BoxRowSumScalar<kTaps, kChannels>(pPadded, nTaps, nChannels, nBytes,
+                                          pSums);
+        break;
+#endif
+    default:
+        BoxRowSumScalar<kTaps, kChannels>(pPadded, nTaps, nChannels, nBytes,
+                                          pSums);
+        break;
+    }
+}
+
+inline void BoxDivide(const Npp32u *pSums, int nBytes, int nArea,
+                      Npp8u *pDst, enumCpuIsa eIsa) {
+    switch (eIsa) {
+#ifdef FILTER_CPU_X86
+    case CpuIsa_AVX2:
+        BoxDivideAVX2(pSums, nBytes, nArea, pDst);
+        break;
+    case CpuIsa_SSE2:
+        BoxDivideSSE2(pSums, nBytes, nArea, pDst);
+        break;
+#endif
+    default:
+        BoxDivideScalar(pSums, 0, nBytes, nArea, pDst);
+        break;
+    }
+}
+
+typedef void (*BoxRowSumFunction)(const Npp32s *pPadded, int nTaps,
+                                  int nChannels, int nBytes, Npp32u *pSums,
+                                  enumCpuIsa eIsa);
+
+// Index of the specialized kernels of the C1, C3 and C4 layouts, or -1
+inline int ChannelIndex(int nChannels) {
+    return nChannels == 1 ? 0 : nChannels == 3 ? 1 : nChannels == 4 ? 2 : -1;
+}
+
+// BoxRowSum for a mask nTaps wide, specialized for the box sizes in common
+// use; the generic kernel for the other sizes or when bSpecialized is false
+inline BoxRowSumFunction SelectBoxRowSum(int nTaps, int nChannels,
+                                         bool bSpecialized) {
+    static const int aTaps[] = {3, 5, 7, 9, 15, 25};
+    static const BoxRowSumFunction aKernels[][3] = {
+        {BoxRowSum<3, 1>, BoxRowSum<3, 3>, BoxRowSum<3, 4>},
+        {BoxRowSum<5, 1>, BoxRowSum<5, 3>, BoxRowSum<5, 4>},
+        {BoxRowSum<7, 1>, BoxRowSum<7, 3>, BoxRowSum<7, 4>},
+        {BoxRowSum<9, 1>, BoxRowSum<9, 3>, BoxRowSum<9, 4>},
+        {BoxRowSum<15, 1>, BoxRowSum<15, 3>, BoxRowSum<15, 4>},
+        {BoxRowSum<25, 1>, BoxRowSum<25, 3>, BoxRowSum<25, 4>}};
+    const int nChannelIndex = ChannelIndex(nChannels);
+    for (size_t i = 0; bSpecialized && nChannelIndex >= 0 &&
+                       i < sizeof(aTaps) / sizeof(aTaps[0]); ++i) {
+        if (aTaps[i] == nTaps) {
+            return aKernels[i][nChannelIndex];
+        }
+    }
+    return BoxRowSum<0, 0>;
+}
+
+// Reject the masks nppiFilterBoxBorder fails with NPP_MASK_SIZE_ERROR or
+// NPP_ANCHOR_ERROR, before any row is written
+inline void CheckBoxMask(NppiSize oMaskSize, NppiPoint oAnchor) {
+    NPP_ASSERT_MSG(oMaskSize.width > 0 && oMaskSize.height > 0,
+                   "Box filter mask size must be positive");
+    NPP_ASSERT_MSG(oAnchor.x >= 0 && oAnchor.x < oMaskSize.width &&
+                       oAnchor.y >= 0 && oAnchor.y < oMaskSize.height,
+                   "Box filter anchor outside the mask");
+}
+
+// Box filter for the destination rows nRowBegin <= y < nRowEnd of the ROI.
+// Only the mask height of source rows around the band is read, so bands can
+// be filtered independently of each other. bSpecialized false runs the
+// generic kernels whatever the mask, to compare the two.
+inline void FilterBoxBorderRows(const Npp8u *pSrc, Npp32s nSrcStep,
+                                NppiSize oSrcSize, NppiPoint oSrcOffset,
+                                Npp8u *pDst, Npp32s nDstStep,
+                                NppiSize oSizeROI, NppiSize oMaskSize,
+                                NppiPoint oAnchor, int nChannels,
+                                enumCpuIsa eIsa, int nRowBegin, int nRowEnd,
+                                bool bSpecialized = true) {
+    if (nRowBegin >= nRowEnd || oSizeROI.width <= 0) {
+        return;
+    }
+    const int nBytes = oSizeROI.width * nChannels;
+    const int nArea = oMaskSize.width * oMaskSize.height;
+    const int nStartX = oSrcOffset.x - oAnchor.x;
+    const int nPaddedWidth = oSizeROI.width + oMaskSize.width - 1;
+    // source columns that replicate borders can reach
+    const int nColBegin =
+        ClampInt(nStartX, 0, oSrcSize.width - 1) * nChannels;
+    const int nColEnd = (ClampInt(nStartX + nPaddedWidth - 1, 0,
+                                  oSrcSize.width - 1) + 1) * nChannels;
+
+    const BoxRowSumFunction fRowSum =
+        SelectBoxRowSum(oMaskSize.width, nChannels, bSpecialized);
+
+    Npp32s *aColumns = ScratchBuffer<Npp32s, 0>(oSrcSize.width * nChannels);
+    // one element to spare for the C3 row sums, see BoxRowSumSSE2
+    Npp32s *aPadded = ScratchBuffer<Npp32s, 1>(nPaddedWidth * nChannels + 1);
+    Npp32u *aSums = ScratchBuffer<Npp32u, 0>(nBytes + 1);
+    std::fill(aColumns, aColumns + oSrcSize.width * nChannels, 0);
+
+    // column sums over the mask rows of the first destination row
+    const int nTop = nRowBegin + oSrcOffset.y - oAnchor.y;
+    for (int j = 0; j < oMaskSize.height; ++j) {
+        const Npp8u *pRow = SrcRow(pSrc, nSrcStep,
+                                   ClampInt(nTop + j, 0, oSrcSize.height - 1));
+        for (int b = nColBegin; b < nColEnd; ++b) {
+            aColumns[b] += pRow[b];
+        }
+    }
+
+    for (int y = nRowBegin; y < nRowEnd; ++y) {
+        if (y > nRowBegin) {
+            const int nLeave = y - 1 + oSrcOffset.y - oAnchor.y;
+            const int nEnter = nLeave + oMaskSize.height;
+            BoxColumnUpdate(
+                SrcRow(pSrc, nSrcStep,
+                       ClampInt(nEnter, 0, oSrcSize.height - 1)),
+                SrcRow(pSrc, nSrcStep,
+                       ClampInt(nLeave, 0, oSrcSize.height - 1)),
+                nColBegin, nColEnd, aColumns, eIsa);
+        }
+        PadRowReplicate(aColumns, oSrcSize.width, nChannels, nStartX,
+                        nPaddedWidth, aPadded);
+        fRowSum(aPadded, oMaskSize.width, nChannels, nBytes, aSums, eIsa);
+        BoxDivide(aSums, nBytes, nArea, DstRow(pDst, nDstStep, y), eIsa);
+    }
+}
+
+inline void FilterBoxBorder(const Npp8u *pSrc, Npp32s nSrcStep,
+                            NppiSize oSrcSize, NppiPoint oSrcOffset,
+                            Npp8u *pDst, Npp32s nDstStep, NppiSize oSizeROI,
+                            NppiSize oMaskSize, NppiPoint oAnchor,
+                            int nChannels, enumCpuIsa eIsa,
+                            bool bSpecialized = true) {
+    CheckBoxMask(oMaskSize, oAnchor);
+    FilterBoxBorderRows(pSrc, nSrcStep, oSrcSize, oSrcOffset, pDst, nDstStep,
+                        oSizeROI, oMaskSize, oAnchor, nChannels, eIsa, 0,
+                        oSizeROI.height, bSpecialized);
+}
+
+//******************************************************************************//
+// Gauss filter
+//
+// The Gauss filter is separable, so it runs as a horizontal pass over each
+// source row followed by a vertical pass over the horizontally filtered rows,
+// both in fixed point with 32-bit sums. The horizontal weights are scaled to
+// sum to 1 << 14, so they fit the signed 16-bit operands of pmaddwd, and the
+// filtered rows are rounded to 8 fraction bits, which keeps them within 16
+// bits. The vertical weights sum to 65536. All instruction sets share the
+// same integer arithmetic and give identical results.
+
+const int kGaussRowBits = 14;
+const int kGaussColumnBits = 16;
+// fraction bits of the horizontally filtered rows
+const int kGaussRowPassBits = 8;
+const int kGaussRowPassShift = kGaussRowBits - kGaussRowPassBits;
+
+// GaussKernel1D scaled to integers that sum to exactly 1 << nFractionBits.
+// The rounding residue goes to the center tap so the kernel stays symmetric.
+inline void GaussKernelFixed(int nTaps, int nFractionBits, Npp32u *aFixed) {
+    float aWeights[kMaxGaussTaps];
+    GaussKernel1D(nTaps, aWeights);
+    const Npp32s nOne = 1 << nFractionBits;
+    Npp32s nSum = 0;
+    for (int i = 0; i < nTaps; ++i) {
+        aFixed[i] = static_cast<Npp32u>(lroundf(aWeights[i] * nOne));
+        nSum += aFixed[i];
+    }
+    aFixed[nTaps / 2] += nOne - nSum;
+}
+
+// pDst[b] = sum of aKernel[i] * pPadded[b + i * nChannels], nBegin <= b < nEnd
+template <int kTaps, int kChannels>
+inline void GaussRowPassScalar(const Npp8u *pPadded, const Npp32u *aKernel,
+                               int nTaps, int nChannels, int nBegin, int nEnd,
+                               Npp16u *pDst) {
+    nTaps = FixedOr<kTaps>(nTaps);
+    nChannels = FixedOr<kChannels>(nChannels);
+    for (int b = nBegin; b < nEnd; ++b) {
+        Npp32u nSum = 1u << (kGaussRowPassShift - 1);
+        for (int i = 0; i < nTaps; ++i) {
+            nSum += aKernel[i] * pPadded[b + i * nChannels];
+        }
+        pDst[b] = static_cast<Npp16u>(nSum >> kGaussRowPassShift);
+    }
+}
+
+// pDst[b] = rounded sum of aKernel[j] * aRows[j][b], nBegin <= b < nEnd
+template <int kTaps>
+inline void GaussColumnPassScalar(const Npp16u *const *aRows,
+                                  const Npp32u *aKernel, int nTaps,
+                                  int nBegin, int nEnd, Npp8u *pDst) {
+    nTaps = FixedOr<kTaps>(nTaps);
+    const int nShift = kGaussRowPassBits + kGaussColumnBits;
+    for (int b = nBegin; b < nEnd; ++b) {
+        Npp32u nSum = 1u << (nShift - 1);
+        for (int j = 0; j < nTaps; ++j) {
+            nSum += aKernel[j] * aRows[j][b];
+        }
+        pDst[b] = static_cast<Npp8u>(nSum >> nShift);
+    }
+}
+
+#ifdef FILTER_CPU_X86
+template <int kTaps, int kChannels>
+FILTER_TARGET_SSE2 inline void GaussRowPassSSE2(
+        const Npp8u *pPadded, const Npp32u *aKernel, int nTaps,
+        int nChannels, int nBytes, Npp16u *pDst) {
+    nTaps = FixedOr<kTaps>(nTaps);
+    nChannels = FixedOr<kChannels>(nChannels);
+    const __m128i vZero = _mm_setzero_si128();
+    const __m128i vRound = _mm_set1_epi32(1 << (kGaussRowPassShift - 1));
+    // packs_epi32 saturates to signed words, so the sums are packed offset
+    // by -32768 and the offset taken out again by flipping the top bit
+    const __m128i vOffset32 = _mm_set1_epi32(32768);
+    const __m128i vOffset16 = _mm_set1_epi16(static_cast<short>(0x8000));
+    // pmaddwd multiplies and adds two taps at a time: the weights of taps
+    // i and i + 1 in every 32-bit lane, an odd last tap paired with 0
+    __m128i vK[(kMaxGaussTaps + 1) / 2];
+    for (int i = 0; i < nTaps; i += 2) {
+        const Npp32u nNext = i + 1 < nTaps ? aKernel[i + 1] : 0;
+        vK[i / 2] = _mm_set1_epi32(static_cast<int>(nNext << 16 | aKernel[i]));
+    }
+    int b = 0;
+    for (; b + 16 <= nBytes; b += 16) {
+        __m128i vSum[4] = {vRound, vRound, vRound, vRound};
+        for (int i = 0; i < nTaps; i += 2) {
+            const Npp8u *p = pPadded + b + i * nChannels;
+            const __m128i v = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(p));
+            const __m128i vNext = i + 1 < nTaps
+                ? _mm_loadu_si128(
+                      reinterpret_cast<const __m128i *>(p + nChannels))
+                : v;
+            const __m128i aWords[2][2] = {
+                {_mm_unpacklo_epi8(v, vZero), _mm_unpacklo_epi8(vNext, vZero)},
+                {_mm_unpackhi_epi8(v, vZero),
+                 _mm_unpackhi_epi8(vNext, vZero)}};
+            for (int k = 0; k < 2; ++k) {
+                vSum[2 * k] = _mm_add_epi32(
+                    vSum[2 * k],
+                    _mm_madd_epi16(_mm_unpacklo_epi16(aWords[k][0],
+                                                      aWords[k][1]),
+                                   vK[i / 2]));
+                vSum[2 * k + 1] = _mm_add_epi32(
+                    vSum[2 * k + 1],
+                    _mm_madd_epi16(_mm_unpackhi_epi16(aWords[k][0],
+                                                      aWords[k][1]),
+                                   vK[i / 2]));
+            }
+        }
+        for (int k = 0; k < 2; ++k) {
+            const __m128i vWords = _mm_xor_si128(
+                _mm_packs_epi32(
+                    _mm_sub_epi32(
+                        _mm_srli_epi32(vSum[2 * k], kGaussRowPassShift),
+                        vOffset32),
+                    _mm_sub_epi32(
+                        _mm_srli_epi32(vSum[2 * k + 1], kGaussRowPassShift),
+                        vOffset32)),
+                vOffset16);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + b + 8 * k),
+                             vWords);
+        }
+    }
+    GaussRowPassScalar<kTaps, kChannels>(pPadded, aKernel, nTaps, nChannels,
+                                         b, nBytes, pDst);
+}
+
+template <int kTaps>
+FILTER_TARGET_SSE2 inline void GaussColumnPassSSE2(
+        const Npp16u *const *aRows, const Npp32u *aKernel, int nTaps,
+        int nBytes, Npp8u *pDst) {
+    nTaps = FixedOr<kTaps>(nTaps);
+    const int nShift = kGaussRowPassBits + kGaussColumnBits;
+    const __m128i vRound = _mm_set1_epi32(1 << (nShift - 1));
+    int b = 0;
+    if (nTaps == 1) {
+        // a single tap of weight 65536 only drops the row pass scaling
+        const __m128i vRound16 = _mm_set1_epi16(1 << (kGaussRowPassBits - 1));
+        for (; b + 16 <= nBytes; b += 16) {
+            const __m128i *p = reinterpret_cast<const __m128i *>(aRows[0] + b);
+            const __m128i vLo = _mm_srli_epi16(
+                _mm_add_epi16(_mm_loadu_si128(p), vRound16),
+                kGaussRowPassBits);
+            const __m128i vHi = _mm_srli_epi16(
+                _mm_add_epi16(_mm_loadu_si128(p + 1), vRound16),
+                kGaussRowPassBits);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + b),
+                             _mm_packus_epi16(vLo, vHi));
+        }
+    }
+    __m128i vK[kMaxGaussTaps];
+    for (int j = 0; j < nTaps; ++j) {
+        vK[j] = _mm_set1_epi16(static_cast<short>(aKernel[j]));
+    }
+    for (; b + 16 <= nBytes; b += 16) {
+        __m128i vSum[4] = {vRound, vRound, vRound, vRound};
+        for (int j = 0; j < nTaps; ++j) {
+            const __m128i *p = reinterpret_cast<const __m128i *>(aRows[j] + b);
+            for (int k = 0; k < 2; ++k) {
+                // 16 x 16 bit products widened to 32 bits
+                const __m128i v = _mm_loadu_si128(p + k);
+                const __m128i vProdLo = _mm_mullo_epi16(v, vK[j]);
+                const __m128i vProdHi = _mm_mulhi_epu16(v, vK[j]);
+                vSum[2 * k] = _mm_add_epi32(
+                    vSum[2 * k], _mm_unpacklo_epi16(vProdLo, vProdHi));
+                vSum[2 * k + 1] = _mm_add_epi32(
+                    vSum[2 * k + 1], _mm_unpackhi_epi16(vProdLo, vProdHi));
+            }
+        }
+        const __m128i vLo = _mm_packs_epi32(_mm_srli_epi32(vSum[0], nShift),
+                                            _mm_srli_epi32(vSum[1], nShift));
+        const __m128i vHi = _mm_packs_epi32(_mm_srli_epi32(vSum[2], nShift),
+                                            _mm_srli_epi32(vSum[3], nShift));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + b),
+                         _mm_packus_epi16(vLo, vHi));
+    }
+    GaussColumnPassScalar<kTaps>(aRows, aKernel, nTaps, b, nBytes, pDst);
+}
+
+template <int kTaps, int kChannels>
+FILTER_TARGET_AVX2 inline void GaussRowPassAVX2(
+        const Npp8u *pPadded, const Npp32u *aKernel, int nTaps,
+        int nChannels, int nBytes, Npp16u *pDst) {
+    nTaps = FixedOr<kTaps>(nTaps);
+    nChannels = FixedOr<kChannels>(nChannels);
+    const __m256i vRound = _mm256_set1_epi32(1 << (kGaussRowPassShift - 1));
+    // the weights of taps i and i + 1 for pmaddwd, as in the SSE2 pass
+    __m256i vK[(kMaxGaussTaps + 1) / 2];
+    for (int i = 0; i < nTaps; i += 2) {
+        const Npp32u nNext = i + 1 < nTaps ? aKernel[i + 1] : 0;
+        vK[i / 2] =
+            _mm256_set1_epi32(static_cast<int>(nNext << 16 | aKernel[i]));
+    }
+    int b = 0;
+    for (; b + 16 <= nBytes; b += 16) {
+        __m256i vSumLo = vRound, vSumHi = vRound;
+        for (int i = 0; i < nTaps; i += 2) {
+            const Npp8u *p = pPadded + b + i * nChannels;
+            const __m256i v = _mm256_cvtepu8_epi16(
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+            const __m256i vNext = i + 1 < nTaps
+                ? _mm256_cvtepu8_epi16(_mm_loadu_si128(
+                      reinterpret_cast<const __m128i *>(p + nChannels)))
+                : v;
+            vSumLo = _mm256_add_epi32(
+                vSumLo, _mm256_madd_epi16(_mm256_unpacklo_epi16(v, vNext),
+                                          vK[i / 2]));
+            vSumHi = _mm256_add_epi32(
+                vSumHi, _mm256_madd_epi16(_mm256_unpackhi_epi16(v, vNext),
+                                          vK[i / 2]));
+        }
+        // the in-lane unpack and pack cancel out, leaving the words in order
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i *>(pDst + b),
+            _mm256_packus_epi32(
+                _mm256_srli_epi32(vSumLo, kGaussRowPassShift),
+                _mm256_srli_epi32(vSumHi, kGaussRowPassShift)));
+    }
+    GaussRowPassScalar<kTaps, kChannels>(pPadded, aKernel, nTaps, nChannels,
+                                         b, nBytes, pDst);
+}
+
+template <int kTaps>
+FILTER_TARGET_AVX2 inline void GaussColumnPassAVX2(
+        const Npp16u *const *aRows, const Npp32u *aKernel, int nTaps,
+        int nBytes, Npp8u *pDst) {
+    nTaps = FixedOr<kTaps>(nTaps);
+    const int nShift = kGaussRowPassBits + kGaussColumnBits;
+    const __m256i vRound = _mm256_set1_epi32(1 << (nShift - 1));
+    int b = 0;
+    if (nTaps == 1) {
+        // a single tap of weight 65536 only drops the row pass scaling
+        const __m256i vRound16 =
+            _mm256_set1_epi16(1 << (kGaussRowPassBits - 1));
+        for (; b + 16 <= nBytes; b += 16) {
+            const __m256i vWords = _mm256_srli_epi16(_mm256_add_epi16(
+                _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i *>(aRows[0] + b)),
+                vRound16), kGaussRowPassBits);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + b),
+                             _mm_packus_epi16(
+                                 _mm256_castsi256_si128(vWords),
+                                 _mm256_extracti128_si256(vWords, 1)));
+        }
+    }
+    __m256i vK[kMaxGaussTaps];
+    for (int j = 0; j < nTaps; ++j) {
+        vK[j] = _mm256_set1_epi16(static_cast<short>(aKernel[j]));
+    }
+    for (; b + 16 <= nBytes; b += 16) {
+        __m256i vSumLo = vRound, vSumHi = vRound;
+        for (int j = 0; j < nTaps; ++j) {
+            const __m256i v = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(aRows[j] + b));
+            const __m256i vProdLo = _mm256_mullo_epi16(v, vK[j]);
+            const __m256i vProdHi = _mm256_mulhi_epu16(v, vK[j]);
+            vSumLo = _mm256_add_epi32(vSumLo,
+                                      _mm256_unpacklo_epi16(vProdLo, vProdHi));
+            vSumHi = _mm256_add_epi32(vSumHi,
+                                      _mm256_unpackhi_epi16(vProdLo, vProdHi));
+        }
+        // the in-lane unpack and pack cancel out, leaving the words in order
+        const __m256i vWords = _mm256_packs_epi32(
+            _mm256_srli_epi32(vSumLo, nShift),
+            _mm256_srli_epi32(vSumHi, nShift));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + b),
+                         _mm_packus_epi16(_mm256_castsi256_si128(vWords),
+                                          _mm256_extracti128_si256(vWords, 1)));
+    }
+    GaussColumnPassScalar<kTaps>(aRows, aKernel, nTaps, b, nBytes, pDst);
+}
+#endif  // FILTER_CPU_X86
+
+template <int kTaps, int kChannels>
+inline void GaussRowPass(const Npp8u *pPadded, const Npp32u *aKernel,
+                         int nTaps, int nChannels, int nBytes, Npp16u *pDst,
+                         enumCpuIsa eIsa) {
+    switch (eIsa) {
+#ifdef FILTER_CPU_X86
+    case CpuIsa_AVX2:
+        GaussRowPassAVX2<kTaps, kChannels>(pPadded, aKernel, nTaps,
+                                           nChannels, nBytes, pDst);
+        break;
+    case CpuIsa_SSE2:
+        GaussRowPassSSE2<kTaps, kChannels>(pPadded, aKernel, nTaps,
+                                           nChannels, nBytes, pDst);
+        break;
+#endif
+    default:
+        GaussRowPassScalar<kTaps, kChannels>(pPadded, aKernel, nTaps,
+                                             nChannels, 0, nBytes, pDst);
+        break;
+    }
+}
+
+template <int kTaps>
+inline void GaussColumnPass(const Npp16u *const *aRows, const Npp32u *aKernel,
+                            int nTaps, int nBytes, Npp8u *pDst,
+                            enumCpuIsa eIsa) {
+    switch (eIsa) {
+#ifdef FILTER_CPU_X86
+    case CpuIsa_AVX2:
+        GaussColumnPassAVX2<kTaps>(aRows, aKernel, nTaps, nBytes, pDst);
+        break;
+    case CpuIsa_SSE2:
+        GaussColumnPassSSE2<kTaps>(aRows, aKernel, nTaps, nBytes, pDst);
+        break;
+#endif
+    default:
+        GaussColumnPassScalar<kTaps>(aRows, aKernel, nTaps, 0, nBytes, pDst);
+        break;
+    }
+}
+
+typedef void (*GaussRowPassFunction)(const Npp8u *pPadded,
+                                     const Npp32u *aKernel, int nTaps,
+                                     int nChannels, int nBytes, Npp16u *pDst,
+                                     enumCpuIsa eIsa);
+typedef void (*GaussColumnPassFunction)(const Npp16u *const *aRows,
+                                        const Npp32u *aKernel, int nTaps,
+                                        int nBytes, Npp8u *pDst,
+                                        enumCpuIsa eIsa);
+
+// GaussRowPass for every tap count of the NPP Gauss masks, 1 to 15; the
+// generic kernel for other channel counts or when bSpecialized is false
+inline GaussRowPassFunction SelectGaussRowPass(int nTaps, int nChannels,
+                                               bool bSpecialized) {
+    static const GaussRowPassFunction aKernels[][3] = {
+        {GaussRowPass<1, 1>, GaussRowPass<1, 3>, GaussRowPass<1, 4>},
+        {GaussRowPass<3, 1>, GaussRowPass<3, 3>, GaussRowPass<3, 4>},
+        {GaussRowPass<5, 1>, GaussRowPass<5, 3>, GaussRowPass<5, 4>},
+        {GaussRowPass<7, 1>, GaussRowPass<7, 3>, GaussRowPass<7, 4>},
+        {GaussRowPass<9, 1>, GaussRowPass<9, 3>, GaussRowPass<9, 4>},
+        {GaussRowPass<11, 1>, GaussRowPass<11, 3>, GaussRowPass<11, 4>},
+        {GaussRowPass<13, 1>, GaussRowPass<13, 3>, GaussRowPass<13, 4>},
+        {GaussRowPass<15, 1>, GaussRowPass<15, 3>, GaussRowPass<15, 4>}};
+    const int nChannelIndex = ChannelIndex(nChannels);
+    if (!bSpecialized || nChannelIndex < 0 || nTaps % 2 == 0 ||
+        nTaps > kMaxGaussTaps) {
+        return GaussRowPass<0, 0>;
+    }
+    return aKernels[nTaps / 2][nChannelIndex];
+}
+
+// GaussColumnPass for every tap count of the NPP Gauss masks, 1 to 15
+inline GaussColumnPassFunction SelectGaussColumnPass(int nTaps,
+                                                     bool bSpecialized) {
+    static const GaussColumnPassFunction aKernels[] = {
+        GaussColumnPass<1>,  GaussColumnPass<3>,  GaussColumnPass<5>,
+        GaussColumnPass<7>,  GaussColumnPass<9>,  GaussColumnPass<11>,
+        GaussColumnPass<13>, GaussColumnPass<15>};
+    if (!bSpecialized || nTaps % 2 == 0 || nTaps > kMaxGaussTaps) {
+        return GaussColumnPass<0>;
+    }
+    return aKernels[nTaps / 2];
+}
+
+// Gauss filter for the destination rows nRowBegin <= y < nRowEnd of the ROI
+inline void FilterGaussBorderRows(const Npp8u *pSrc, Npp32s nSrcStep,
+                                  NppiSize oSrcSize, NppiPoint oSrcOffset,
+                                  Npp8u *pDst, Npp32s nDstStep,
+                                  NppiSize oSizeROI, NppiMaskSize eMaskSize,
+                                  int nChannels, enumCpuIsa eIsa,
+                                  int nRowBegin, int nRowEnd,
+                                  bool bSpecialized = true) {
+    if (nRowBegin >= nRowEnd || oSizeROI.width <= 0) {
+        return;
+    }
+    const NppiSize oMask = GaussMaskDims(eMaskSize);
+    Npp32u aRowKernel[kMaxGaussTaps];
+    Npp32u aColumnKernel[kMaxGaussTaps];
+    GaussKernelFixed(oMask.width, kGaussRowBits, aRowKernel);
+    GaussKernelFixed(oMask.height, kGaussColumnBits, aColumnKernel);
+    const GaussRowPassFunction fRowPass =
+        SelectGaussRowPass(oMask.width, nChannels, bSpecialized);
+    const GaussColumnPassFunction fColumnPass =
+        SelectGaussColumnPass(oMask.height, bSpecialized);
+
+    const int nBytes = oSizeROI.width * nChannels;
+    const int nStartX = oSrcOffset.x - oMask.width / 2;
+    const int nPaddedWidth = oSizeROI.width + oMask.width - 1;
+    Npp8u *aPadded = ScratchBuffer<Npp8u, 0>(nPaddedWidth * nChannels);
+    RowRing<Npp16u> oRowPasses(nBytes, oMask.height);
+    const Npp16u *aRows[kMaxGaussTaps];
+
+    for (int y = nRowBegin; y < nRowEnd; ++y) {
+        const int nTop = y + oSrcOffset.y - oMask.height / 2;
+        for (int j = 0; j < oMask.height; ++j) {
+            bool bCached = false;
+            Npp16u *pRowPass = oRowPasses.Slot(nTop + j, &bCached);
+            if (!bCached) {
+                const int nY = ClampInt(nTop + j, 0, oSrcSize.height - 1);
+                PadRowReplicate(SrcRow(pSrc, nSrcStep, nY), oSrcSize.width,
+                                nChannels, nStartX, nPaddedWidth,
+                                aPadded);
+                fRowPass(aPadded, aRowKernel, oMask.width, nChannels,
+                         nBytes, pRowPass, eIsa);
+            }
+            aRows[j] = pRowPass;
+        }
+        fColumnPass(aRows, aColumnKernel, oMask.height, nBytes,
+                    DstRow(pDst, nDstStep, y), eIsa);
+    }
+}
+
+inline void FilterGaussBorder(const Npp8u *pSrc, Npp32s nSrcStep,
+                              NppiSize oSrcSize, NppiPoint oSrcOffset,
+                              Npp8u *pDst, Npp32s nDstStep,
+                              NppiSize oSizeROI, NppiMaskSize eMaskSize,
+                              int nChannels, enumCpuIsa eIsa,
+                              bool bSpecialized = true) {
+    FilterGaussBorderRows(pSrc, nSrcStep, oSrcSize, oSrcOffset, pDst,
+                          nDstStep, oSizeROI, eMaskSize, nChannels, eIsa, 0,
+                          oSizeROI.height, bSpecialized);
+}
+}  // namespace cpu
+#endif  //  SRC_FILTERKERNELSCPU_H_
@@ -37,8 +37,13 @@
 #include <tuple>
 #include<vector>
 #include<thread>
+#include <algorithm>
+#include <sstream>
 
 #include "processImageNPP.cpp"
+#include "batchPipeline.h"
+#include "jobServer.h"
+#include "dirManifest.h"
 
 
 bool printfNPPinfo(int argc, char *argv[]) {
@@ -61,6 +66,27 @@ bool printfNPPinfo(int argc, char *argv[]) {
   return bVal;
 }
 
+// The backend has to be known before the CUDA device is initialized, so it is
+// parsed separately from the filter arguments
+std::tuple<enumFilterBackend, enumCpuIsa>
+        parseBackendArguments(int argc, char *argv[]) {
+  enumFilterBackend eBackend = FilterBackend_Auto;
+  enumCpuIsa eMaxIsa = CpuIsa_AVX2;
+  char *output;
+
+  if (checkCmdLineFlag(argc, (const char **)argv, "backend")) {
+    getCmdLineArgumentString(argc, (const char **)argv, "backend", &output);
+    eBackend = FilterBackendFromString(output);
+  }
+  // cap the instruction set of the CPU backend (scalar, sse2, avx2)
+  if (checkCmdLineFlag(argc, (const char **)argv, "cpuIsa")) {
+    getCmdLineArgumentString(argc, (const char **)argv, "cpuIsa", &output);
+    eMaxIsa = CpuIsaFromString(output);
+  }
+
+  return {ResolveFilterBackend(eBackend), eMaxIsa};
+}
+
 std::tuple<std::string, std::string, std::string, int, int, int, int>
         parseCommandLineArguments(int argc, char *argv[]) {
   // (Possible) command line arguements
@@ -135,66 +161,315 @@ std::tuple<std::string, std::string, std::string, int, int, int, int>
         nFilterType, nMaskSize, nSrcOffset, nAnchor};
 }
 
-void processImageFile(std::string sFilename,
-    std::string *sResultFilename, int nFilterType,
-    int nMaskSize, int nSrcOffset, int nAnchor ) {
-  // if we specify the filename at the command line, then we only test
-  // sFilename[0].
-  int file_errors = 0;
-  std::ifstream infile(sFilename.data(), std::ifstream::in);
-
-  if (infile.good()) {
-    // std::cout << "filterNPP opened: <" << sFilename.data()
-    //          << "> successfully!" << std::endl;
-    file_errors = 0;
-    infile.close();
-  } else {
-    std::cout << "filterNPP unable to open: <" << sFilename.data() << ">"
-              << std::endl;
-    file_errors++;
-    infile.close();
+// Threads per stage of the directory pipeline: "-threads=N" for all stages
+// or "-threads=decode,filter,encode". By default the filter stage gets a
+// thread per core and decode and encode a quarter of that each, so the
+// stages together run about one thread per core rather than three.
+BatchThreads parseThreadArguments(int argc, char *argv[]) {
+  BatchThreads oThreads;
+  int nCores =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  oThreads.nFilter = nCores;
+  oThreads.nDecode = oThreads.nEncode = std::max(1, nCores / 4);
+  char *output;
+
+  if (checkCmdLineFlag(argc, (const char **)argv, "threads")) {
+    getCmdLineArgumentString(argc, (const char **)argv, "threads", &output);
+    int nCounts[3] = {0, 0, 0};
+    int nParsed = sscanf(output, "%d,%d,%d", &nCounts[0], &nCounts[1],
+                         &nCounts[2]);
+    if (nParsed == 1) {
+      nCounts[1] = nCounts[2] = nCounts[0];
+    }
+    NPP_ASSERT_MSG(nParsed == 1 || nParsed == 3,
+                   "Expected -threads=N or -threads=decode,filter,encode");
+    oThreads.nDecode = std::max(nCounts[0], 1);
+    oThreads.nFilter = std::max(nCounts[1], 1);
+    oThreads.nEncode = std::max(nCounts[2], 1);
   }
+  return oThreads;
+}
 
-  if (file_errors > 0) {
-    exit(EXIT_FAILURE);
+// Threads filtering the row bands of one image with "-bandThreads=N"; the
+// default uses every core and 1 filters each image on a single thread. The
+// filter threads of a batch count against the same N, so bands only spread
+// out to cores the batch leaves idle.
+int parseBandThreads(int argc, char *argv[]) {
+  int nBandThreads =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  char *output;
+
+  if (checkCmdLineFlag(argc, (const char **)argv, "bandThreads")) {
+    getCmdLineArgumentString(argc, (const char **)argv, "bandThreads",
+                             &output);
+    nBandThreads = atoi(output);
+    NPP_ASSERT_MSG(nBandThreads > 0, "Expected -bandThreads=N with N > 0");
   }
+  return nBandThreads;
+}
 
-  npp::NppRetrieveImage nppImage;
-  auto [nBitDepth, sFileExt] = nppImage.ImageSetup(sFilename);
+// "-planar" filters colour images one channel plane at a time, and
+// "-alpha=keep" leaves the alpha channel of RGBA images as it is (which
+// implies planar filtering); "-alpha=filter" is the default
+std::tuple<bool, bool> parseLayout(int argc, char *argv[]) {
+  bool bPlanar = checkCmdLineFlag(argc, (const char **)argv, "planar");
+  bool bKeepAlpha = false;
+  char *output;
 
-  // Do this if the output name was not provided via command line
-  if (sResultFilename->compare("") == 0 || sResultFilename->empty()) {
-    *sResultFilename = sFilename;
+  if (checkCmdLineFlag(argc, (const char **)argv, "alpha")) {
+    getCmdLineArgumentString(argc, (const char **)argv, "alpha", &output);
+    std::string sAlpha = output;
+    NPP_ASSERT_MSG(sAlpha == "keep" || sAlpha == "filter",
+                   "Expected -alpha=keep or -alpha=filter");
+    bKeepAlpha = sAlpha == "keep";
+  }
+  return {bPlanar || bKeepAlpha, bKeepAlpha};
+}
 
-    std::string::size_type dot = sResultFilename->rfind('.');
+// Decode options from the text of "-decode=fast|accurate" and
+// "-decodeScale=1/2|1/4|1/8" (empty for the defaults)
+npp::DecodeOptions makeDecodeOptions(const std::string &sDecode,
+                                     const std::string &sScale) {
+  npp::DecodeOptions oOptions;
+  NPP_ASSERT_MSG(sDecode.empty() || sDecode == "fast" ||
+                     sDecode == "accurate",
+                 "Expected -decode=fast or -decode=accurate");
+  oOptions.bFast = sDecode == "fast";
+  if (!sScale.empty()) {
+    NPP_ASSERT_MSG(sScale == "1" || sScale == "1/1" || sScale == "1/2" ||
+                       sScale == "1/4" || sScale == "1/8",
+                   "Expected -decodeScale=1/2, 1/4 or 1/8");
+    std::string::size_type nSlash = sScale.find('/');
+    oOptions.nScaleDenominator =
+        nSlash == std::string::npos ? 1 : atoi(sScale.c_str() + nSlash + 1);
+  }
+  return oOptions;
+}
 
-    if (dot != std::string::npos) {
-      *sResultFilename = sResultFilename->substr(0, dot);
-    }
+npp::DecodeOptions parseDecodeOptions(int argc, char *argv[]) {
+  std::string sDecode, sScale;
+  char *output;
 
-    // create output directories as needed and populate it with the
-    // processed images
-    namespace fs = std::filesystem;
-    std::string sFilterType = "boxFilter";
-    std::string szResDir = fs::path(*sResultFilename).remove_filename();
-    std::string szResFile = fs::path(*sResultFilename).filename();
+  if (checkCmdLineFlag(argc, (const char **)argv, "decode")) {
+    getCmdLineArgumentString(argc, (const char **)argv, "decode", &output);
+    sDecode = output;
+  }
+  if (checkCmdLineFlag(argc, (const char **)argv, "decodeScale")) {
+    getCmdLineArgumentString(argc, (const char **)argv, "decodeScale",
+                             &output);
+    sScale = output;
+  }
+  return makeDecodeOptions(sDecode, sScale);
+}
 
-    if ((enumImageFilterType)nFilterType == FilterType_FilterBoxBorder) {
-      sFilterType =
-          FilterDescription[static_cast<int>(FilterType_FilterBoxBorder)][0];
-    } else {
-      sFilterType =
-        FilterDescription[static_cast<int>(FilterType_FilterGaussBorder)][0];
-    }
-    szResDir += sFilterType + "/";
-    if (fs::is_directory(szResDir) == false) {
-      fs::create_directory(szResDir);
+// The format and encoder options of the results with "-outFormat=", e.g.
+// "pnm", "png:1" or "jpeg:90:444"; see encodePolicy.h. By default results
+// keep the format of their source.
+npp::EncodePolicy parseEncodePolicy(int argc, char *argv[]) {
+  char *output;
+
+  if (checkCmdLineFlag(argc, (const char **)argv, "outFormat")) {
+    getCmdLineArgumentString(argc, (const char **)argv, "outFormat", &output);
+    return npp::EncodePolicyFromString(output);
+  }
+  return npp::EncodePolicy();
+}
+
+// Rows per strip with "-tileRows=N"; 0 (the default) filters whole images
+int parseTileRows(int argc, char *argv[]) {
+  int nTileRows = 0;
+  char *output;
+
+  if (checkCmdLineFlag(argc, (const char **)argv, "tileRows")) {
+    getCmdLineArgumentString(argc, (const char **)argv, "tileRows", &output);
+    nTileRows = atoi(output);
+    NPP_ASSERT_MSG(nTileRows > 0, "Expected -tileRows=N with N > 0");
+  }
+  return nTileRows;
+}
+
+// Images per filter batch of a directory run with "-batch=N"; images of the
+// same size and channel count among them are filtered in one call. 1 (the
+// default) filters every image on its own.
+int parseBatchSize(int argc, char *argv[]) {
+  int nBatchSize = 1;
+  char *output;
+
+  if (checkCmdLineFlag(argc, (const char **)argv, "batch")) {
+    getCmdLineArgumentString(argc, (const char **)argv, "batch", &output);
+    nBatchSize = atoi(output);
+    NPP_ASSERT_MSG(nBatchSize > 0, "Expected -batch=N with N > 0");
+  }
+  return nBatchSize;
+}
+
+// Filter chain with "-pipeline=box:5,gauss:7,box:3"; empty when not given
+std::string parsePipeline(int argc, char *argv[]) {
+  std::string sPipeline = "";
+  char *output;
+
+  if (checkCmdLineFlag(argc, (const char **)argv, "pipeline")) {
+    getCmdLineArgumentString(argc, (const char **)argv, "pipeline", &output);
+    sPipeline = output;
+  }
+  return sPipeline;
+}
+
+// Fan-out with "-outputs=box:25,gauss:10,box:5": (filter type, mask size)
+// pairs filtered from the same decoded image. The sizes are -maskSize values,
+// so gauss:10 is the 15x15 mask.
+std::vector<std::tuple<int, int>> parseOutputs(int argc, char *argv[]) {
+  std::vector<std::tuple<int, int>> aOutputs;
+  char *output;
+
+  if (checkCmdLineFlag(argc, (const char **)argv, "outputs")) {
+    getCmdLineArgumentString(argc, (const char **)argv, "outputs", &output);
+    std::istringstream oOutputs(output);
+    std::string sOutput;
+    while (std::getline(oOutputs, sOutput, ',')) {
+      char aName[16];
+      int nMaskSize = 0;
+      NPP_ASSERT_MSG(sscanf(sOutput.c_str(), "%15[a-z]:%d", aName,
+                            &nMaskSize) == 2,
+                     "Expected -outputs=filter:maskSize,...");
+      int nFilterType = FilterType_FilterBoxBorder;
+      if (std::string(aName) == "gauss") {
+        nFilterType = FilterType_FilterGaussBorder;
+      } else {
+        NPP_ASSERT_MSG(std::string(aName) == "box",
+                       "Output filters are box or gauss");
+      }
+      std::tuple<int, int> oOutput(nFilterType, nMaskSize);
+      // equal outputs would write the same files
+      NPP_ASSERT_MSG(std::find(aOutputs.begin(), aOutputs.end(), oOutput) ==
+                         aOutputs.end(),
+                     "Duplicate filter in -outputs");
+      aOutputs.push_back(oOutput);
     }
-    *sResultFilename = szResDir + szResFile;
-    *sResultFilename += "_" + sFilterType + sFileExt;
   }
+  return aOutputs;
+}
+
+// Socket path of the job server with "-serve=/path/to.sock"; empty when not
+// given
+std::string parseServe(int argc, char *argv[]) {
+  std::string sSocketPath = "";
+  char *output;
+
+  if (checkCmdLineFlag(argc, (const char **)argv, "serve")) {
+    getCmdLineArgumentString(argc, (const char **)argv, "serve", &output);
+    sSocketPath = output;
+  }
+  return sSocketPath;
+}
+
+// Image archive the results go into with "-outArchive=results.nia", empty
+// when they are written to files
+std::string parseOutputArchive(int argc, char *argv[]) {
+  char *output;
+
+  if (!checkCmdLineFlag(argc, (const char **)argv, "outArchive")) {
+    return "";
+  }
+  getCmdLineArgumentString(argc, (const char **)argv, "outArchive", &output);
+  std::string sArchive = output;
+  NPP_ASSERT_MSG(npp::ImageArchive::IsArchiveFileName(sArchive),
+                 "Expected -outArchive=name.nia");
+  return sArchive;
+}
+
+// Byte count with an optional K, M or G suffix, e.g. "512M"
+size_t parseByteSize(const std::string &rValue) {
+  char *pEnd = NULL;
+  double nValue = strtod(rValue.c_str(), &pEnd);
+  std::string sSuffix(pEnd);
+  size_t nScale = 1;
+  if (sSuffix == "K" || sSuffix == "k") {
+    nScale = size_t(1) << 10;
+  } else if (sSuffix == "M" || sSuffix == "m") {
+    nScale = size_t(1) << 20;
+  } else if (sSuffix == "G" || sSuffix == "g") {
+    nScale = size_t(1) << 30;
+  } else {
+    NPP_ASSERT_MSG(sSuffix.empty(), "Expected a size like 512M or 1G");
+  }
+  NPP_ASSERT_MSG(pEnd != rValue.c_str() && nValue > 0,
+                 "Expected a size like 512M or 1G");
+  return size_t(nValue * nScale);
+}
+
+// Result cache with "-cache=dir" holding at most "-cacheSize=1G" (the
+// default) of results; NULL when not given
+std::unique_ptr<ResultCache> parseCache(int argc, char *argv[]) {
+  char *output;
+
+  if (!checkCmdLineFlag(argc, (const char **)argv, "cache")) {
+    return nullptr;
+  }
+  getCmdLineArgumentString(argc, (const char **)argv, "cache", &output);
+  std::string sDirectory = output;
+  size_t nMaxBytes = size_t(1) << 30;
+  if (checkCmdLineFlag(argc, (const char **)argv, "cacheSize")) {
+    getCmdLineArgumentString(argc, (const char **)argv, "cacheSize", &output);
+    nMaxBytes = parseByteSize(output);
+  }
+  return std::make_unique<ResultCache>(sDirectory, nMaxBytes);
+}
+
+// Bytes the images in flight may hold with "-memBudget=4G"; 0 when not given
+size_t parseMemoryBudget(int argc, char *argv[]) {
+  char *output;
+
+  if (!checkCmdLineFlag(argc, (const char **)argv, "memBudget")) {
+    return 0;
+  }
+  getCmdLineArgumentString(argc, (const char **)argv, "memBudget", &output);
+  return parseByteSize(output);
+}
+
+// Name of the processed image, placed in a subdirectory named after the
+// filter next to the input: dir/name.ext -> dir/boxFilter/name_boxFilter.ext.
+// Results that go into an archive need no directory.
+std::string makeResultFilename(const std::string &sFilename,
+                               const std::string &sFilterType,
+                               const std::string &sFileExt,
+                               bool bCreateDirectory = true) {
+  std::string sResultFilename = sFilename;
+
+  std::string::size_type dot = sResultFilename.rfind('.');
+
+  if (dot != std::string::npos) {
+    sResultFilename = sResultFilename.substr(0, dot);
+  }
+
+  // create output directories as needed and populate it with the
+  // processed images
+  namespace fs = std::filesystem;
+  std::string szResDir = fs::path(sResultFilename).remove_filename();
+  std::string szResFile = fs::path(sResultFilename).filename();
+
+  szResDir += sFilterType + "/";
+  std::error_code oError;
+  // several pipeline threads may get here at the same time
+  if (bCreateDirectory) {
+    fs::create_directories(szResDir, oError);
+  }
+  sResultFilename = szResDir + szResFile;
+  sResultFilename += "_" + sFilterType + sFileExt;
+  return sResultFilename;
+}
 
+NppProcessImage makeImageProcessor(int nFilterType, int nMaskSize,
+                                   int nSrcOffset, int nAnchor, int nTileRows,
+                                   const std::string &sPipeline,
+                                   std::shared_ptr<FilterBackend> pBackend,
+                                   const npp::DecodeOptions &rDecode,
+                                   const npp::EncodePolicy &rEncode) {
   NppProcessImage processImageNPP;
+  processImageNPP.SetBackend(pBackend);
+  processImageNPP.SetDecodeOptions(rDecode);
+  processImageNPP.SetEncodePolicy(rEncode);
+  processImageNPP.SetTileRows(nTileRows);
   processImageNPP.SetSrcOffset(nSrcOffset, nSrcOffset);
 
   if ((enumImageFilterType)nFilterType == FilterType_FilterBoxBorder) {
@@ -207,10 +482,291 @@ void processImageFile(std::string sFilename,
     processImageNPP.SetGaussMaskSize(nMaskSize);
     processImageNPP.SetFilterType(FilterType_FilterGaussBorder);
   }
+  // a chain replaces the single filter
+  if (!sPipeline.empty()) {
+    processImageNPP.SetFilterChain(sPipeline);
+  }
+  return processImageNPP;
+}
+
+// One pipeline output per requested filter; box filters are anchored at the
+// centre of their mask, and each output gets its own directory named after
+// the filter and mask size, e.g. boxFilter25/, created unless the results
+// go into an archive
+std::vector<BatchOutput> makeBatchOutputs(
+    const std::vector<std::tuple<int, int>> &aOutputs, int nSrcOffset,
+    int nTileRows, std::shared_ptr<FilterBackend> pBackend,
+    const npp::DecodeOptions &rDecode, const npp::EncodePolicy &rEncode,
+    bool bCreateDirectories) {
+  std::vector<BatchOutput> aBatchOutputs;
+  for (const std::tuple<int, int> &rOutput : aOutputs) {
+    auto [nFilterType, nMaskSize] = rOutput;
+    BatchOutput oOutput;
+    oOutput.oProcessor =
+        makeImageProcessor(nFilterType, nMaskSize, nSrcOffset, nMaskSize / 2,
+                           nTileRows, "", pBackend, rDecode, rEncode);
+    std::string sFilterName =
+        oOutput.oProcessor.FilterName() + std::to_string(nMaskSize);
+    oOutput.fResultName = [sFilterName, bCreateDirectories](
+                              const std::string &rFile,
+                              const std::string &rExt) {
+      return makeResultFilename(rFile, sFilterName, rExt, bCreateDirectories);
+    };
+    aBatchOutputs.push_back(oOutput);
+  }
+  return aBatchOutputs;
+}
+
+// The settings of a pipeline for its log: those of the filter, or a list
+// with the settings of every output
+std::string makeOutputsSettingsJson(const std::vector<BatchOutput> &aOutputs) {
+  if (aOutputs.size() == 1) {
+    return aOutputs[0].oProcessor.SettingsJson();
+  }
+  std::string sSettings = "\"outputs\":[";
+  for (size_t i = 0; i < aOutputs.size(); ++i) {
+    sSettings += (i > 0 ? ",{" : "{") + aOutputs[i].oProcessor.SettingsJson() +
+                 "}";
+  }
+  return sSettings + "]";
+}
+
+// Take the single result of a record from the cache if it is there;
+// otherwise *pKey is where to store the result once it is written
+bool fetchCachedResult(ResultCache *pCache, const std::string &rSettings,
+                       ImageRecord *pRecord, std::string *pKey) {
+  *pKey = pCache->Key(pRecord->sFilename, rSettings);
+  if (!pCache->Fetch(*pKey, pRecord->aResultFilenames[0])) {
+    pRecord->sCache = "miss";
+    return false;
+  }
+  pRecord->sCache = "hit";
+  pRecord->nBytesWritten =
+      std::filesystem::file_size(pRecord->aResultFilenames[0]);
+  return true;
+}
+
+// A result must not replace its own input
+void checkResultIsNotInput(const std::string &rInput,
+                           const std::string &rResult) {
+  std::error_code oError;
+  NPP_ASSERT_MSG(!std::filesystem::equivalent(rInput, rResult, oError),
+                 "The result file is the input file");
+}
+
+ImageRecord processImageFile(std::string sFilename,
+    std::string *sResultFilename, int nFilterType,
+    int nMaskSize, int nSrcOffset, int nAnchor, int nTileRows,
+    const std::string &sPipeline, std::shared_ptr<FilterBackend> pBackend,
+    const npp::DecodeOptions &rDecode, const npp::EncodePolicy &rEncode,
+    ResultCache *pCache) {
+  ImageRecord oRecord;
+  oRecord.sFilename = sFilename;
+  StageClock oClock;
+
+  // the file is opened only once, by the decoder; its size is enough to
+  // tell that it is there
+  std::error_code oSizeError;
+  oRecord.nBytesRead = std::filesystem::file_size(sFilename, oSizeError);
+  if (oSizeError) {
+    std::cout << "filterNPP unable to open: <" << sFilename.data() << ">"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  NppProcessImage processImageNPP =
+      makeImageProcessor(nFilterType, nMaskSize, nSrcOffset, nAnchor,
+                         nTileRows, sPipeline, pBackend, rDecode, rEncode);
+
+  // Do this if the output name was not provided via command line
+  if (sResultFilename->compare("") == 0 || sResultFilename->empty()) {
+    *sResultFilename = makeResultFilename(
+        sFilename, processImageNPP.FilterName(),
+        rEncode.Extension(npp::NppRetrieveImage::fileExtension(sFilename)));
+  }
+  checkResultIsNotInput(sFilename, *sResultFilename);
+  oRecord.aResultFilenames.push_back(*sResultFilename);
+
+  // an input filtered the same way before is not decoded again
+  std::string sCacheKey;
+  if (pCache != NULL &&
+      fetchCachedResult(pCache, processImageNPP.SettingsJson(), &oRecord,
+                        &sCacheKey)) {
+    oRecord.oTimings.dCheckMs = oClock.Lap();
+    return oRecord;
+  }
+  oRecord.oTimings.dCheckMs = oClock.Lap();
+
+  npp::NppRetrieveImage nppImage;
+  auto [nBitDepth, sFileExt] = nppImage.ImageSetup(sFilename, rDecode);
+  oRecord.oTimings.dDecodeMs = oClock.Lap();
+  oRecord.nBitDepth = nBitDepth;
+  oRecord.nDecodeScale = nppImage.decodeScale();
+  processImageNPP.ScaleDown(oRecord.nDecodeScale);
 
+  if (nBitDepth == 8 || nBitDepth == 24 || nBitDepth == 32) {
+    npp::ImageView oSrc = nppImage.sourceView();
+    oRecord.nWidth = oSrc.nWidth;
+    oRecord.nHeight = oSrc.nHeight;
+  }
+  processImageNPP.SetTimings(&oRecord.oTimings);
   processImageNPP.ProcessImageNPP(&nppImage, *sResultFilename, nBitDepth);
+
+  std::error_code oError;
+  oRecord.nBytesWritten = std::filesystem::file_size(*sResultFilename, oError);
+  if (oError) {
+    oRecord.nBytesWritten = 0;
+  } else if (pCache != NULL) {
+    pCache->Store(sCacheKey, *sResultFilename);
+  }
+  return oRecord;
+}
+
+
+// Run one job of the job server. The fields default to the command line
+// settings, except that box filters are anchored at the centre of the mask
+// unless the job says otherwise. Errors are reported in the record.
+ImageRecord runJob(const JobFields &rJob, int nFilterType, int nMaskSize,
+                   int nSrcOffset, int nTileRows,
+                   std::shared_ptr<FilterBackend> pBackend,
+                   const npp::DecodeOptions &rDecode,
+                   const npp::EncodePolicy &rEncode, JobSlots *pSlots,
+                   ResultCache *pCache, std::string *pSettings) {
+  auto fField = [&rJob](const char *zName, const std::string &sDefault) {
+    JobFields::const_iterator it = rJob.find(zName);
+    return it == rJob.end() ? sDefault : it->second;
+  };
+  ImageRecord oRecord;
+  oRecord.sFilename = fField("input", "");
+  if (rJob.count("id") > 0) {
+    *pSettings = "\"id\":" + JsonString(fField("id", "")) + ",";
+  }
+
+  try {
+    NPP_ASSERT_MSG(!oRecord.sFilename.empty(), "Job without input");
+    std::string sFilter = fField("filter", std::to_string(nFilterType));
+    int nJobFilterType = FilterType_FilterBoxBorder;
+    if (sFilter == "gauss" || sFilter == "2") {
+      nJobFilterType = FilterType_FilterGaussBorder;
+    } else {
+      NPP_ASSERT_MSG(sFilter == "box" || sFilter == "1",
+                     "Job filter must be box or gauss");
+    }
+    int nJobMaskSize = atoi(fField("mask", std::to_string(nMaskSize)).c_str());
+    int nJobOffset = atoi(fField("offset", std::to_string(nSrcOffset)).c_str());
+    int nJobAnchor =
+        atoi(fField("anchor", std::to_string(nJobMaskSize / 2)).c_str());
+    npp::DecodeOptions oDecode = rDecode;
+    if (rJob.count("decode") > 0 || rJob.count("decodeScale") > 0) {
+      oDecode = makeDecodeOptions(
+          fField("decode", rDecode.bFast ? "fast" : "accurate"),
+          fField("decodeScale",
+                 "1/" + std::to_string(rDecode.nScaleDenominator)));
+    }
+    npp::EncodePolicy oEncode =
+        rJob.count("outFormat") > 0
+            ? npp::EncodePolicyFromString(fField("outFormat", ""))
+            : rEncode;
+    NppProcessImage oProcessor =
+        makeImageProcessor(nJobFilterType, nJobMaskSize, nJobOffset,
+                           nJobAnchor, nTileRows, fField("pipeline", ""),
+                           pBackend, oDecode, oEncode);
+    *pSettings += oProcessor.SettingsJson();
+
+    StageClock oClock;
+    oRecord.nBytesRead = std::filesystem::file_size(oRecord.sFilename);
+    std::string sResultFilename = fField("output", "");
+    if (sResultFilename.empty()) {
+      sResultFilename = makeResultFilename(
+          oRecord.sFilename, oProcessor.FilterName(),
+          oEncode.Extension(
+              npp::NppRetrieveImage::fileExtension(oRecord.sFilename)));
+    }
+    checkResultIsNotInput(oRecord.sFilename, sResultFilename);
+    oRecord.aResultFilenames.push_back(sResultFilename);
+    std::string sCacheKey;
+    if (pCache != NULL &&
+        fetchCachedResult(pCache, oProcessor.SettingsJson(), &oRecord,
+                          &sCacheKey)) {
+      oRecord.oTimings.dCheckMs = oClock.Lap();
+      return oRecord;
+    }
+    oRecord.oTimings.dCheckMs = oClock.Lap();
+
+    npp::NppRetrieveImage oImage;
+    auto [nBitDepth, sFileExt] =
+        oImage.ImageSetup(oRecord.sFilename, oDecode);
+    oRecord.oTimings.dDecodeMs = oClock.Lap();
+    oRecord.nBitDepth = nBitDepth;
+    oRecord.nDecodeScale = oImage.decodeScale();
+    NPP_ASSERT_MSG(nBitDepth == 8 || nBitDepth == 24 || nBitDepth == 32,
+                   "Unsupported image bit depth");
+    oProcessor.ScaleDown(oRecord.nDecodeScale);
+
+    npp::ImageView oSrc = oImage.sourceView();
+    oRecord.nWidth = oSrc.nWidth;
+    oRecord.nHeight = oSrc.nHeight;
+    npp::ImageView oDst =
+        oImage.resultView(sResultFilename, oSrc.nWidth, oSrc.nHeight,
+                          oEncode);
+    oProcessor.SetTimings(&oRecord.oTimings);
+    {
+      // decodes and encodes of other jobs go on meanwhile
+      JobSlots::Lease oLease(pSlots);
+      oProcessor.FilterImage(&oImage, oSrc, oDst);
+    }
+
+    oClock.Lap();
+    oImage.saveResult(sResultFilename);
+    oRecord.oTimings.dEncodeMs = oClock.Lap();
+    oRecord.nBytesWritten = std::filesystem::file_size(sResultFilename);
+    if (pCache != NULL) {
+      pCache->Store(sCacheKey, sResultFilename);
+    }
+  } catch (npp::Exception &rException) {
+    std::ostringstream oMessage;
+    oMessage << rException;
+    oRecord.sError = oMessage.str();
+  } catch (std::exception &rException) {
+    oRecord.sError = rException.what();
+  }
+  return oRecord;
 }
 
+// Keep the backend and the buffer pools warm and run the jobs clients send
+// over a Unix domain socket. Every job is answered with its log record,
+// which also goes to the log file; the summary is written on shutdown.
+void serveJobs(const std::string &sSocketPath, const std::string &sLogPath,
+               int nFilterType, int nMaskSize, int nSrcOffset, int nTileRows,
+               int nFilterSlots, std::shared_ptr<FilterBackend> pBackend,
+               const npp::DecodeOptions &rDecode,
+               const npp::EncodePolicy &rEncode, ResultCache *pCache) {
+  std::ofstream logFile(sLogPath, std::ios_base::app);
+  ProcessingLog oLog(logFile, "");
+  JobSlots oSlots(nFilterSlots);
+  JobServer oServer(sSocketPath, [&](const JobFields &rJob) {
+    std::string sSettings;
+    ImageRecord oRecord =
+        runJob(rJob, nFilterType, nMaskSize, nSrcOffset, nTileRows,
+               pBackend, rDecode, rEncode, &oSlots, pCache, &sSettings);
+    return oLog.Write(&oRecord, sSettings);
+  });
+
+  printf("Serving jobs on %s\n", sSocketPath.c_str());
+  fflush(stdout);
+  oServer.Serve();
+
+  std::string sPools = "\"pools\":{" + HostBufferPool().Summary();
+  if (pBackend->Name().compare(0, 3, "npp") == 0) {
+    sPools += "," + DeviceBufferPool().Summary();
+  }
+  if (pCache != NULL) {
+    sPools += "}," + pCache->Summary();
+  } else {
+    sPools += "}";
+  }
+  oLog.WriteSummary(sPools);
+}
 
 int main(int argc, char *argv[]) {
   printf("%s Starting...\n\n", argv[0]);
@@ -222,16 +778,35 @@ int main(int argc, char *argv[]) {
     std::string sResultFilename = "";
     std::string sDirPath = "";
     std::string sLogFileName = "FilterRecord.log";
+    std::string sManifestFileName = "FilterManifest.txt";
     int nFilterType = 1;
     int nMaskSize = 5;
     int nSrcOffset = 0;
     int nAnchor = nMaskSize / 2;
 
-    findCudaDevice(argc, (const char **)argv);
+    auto [eBackend, eMaxIsa] = parseBackendArguments(argc, argv);
 
-    if (printfNPPinfo(argc, argv) == false) {
-      exit(EXIT_SUCCESS);
+    // only touch the CUDA device when the filters run on it
+    if (eBackend == FilterBackend_NPP) {
+      findCudaDevice(argc, (const char **)argv);
+
+      if (printfNPPinfo(argc, argv) == false) {
+        exit(EXIT_SUCCESS);
+      }
+    }
+    std::unique_ptr<WorkStealingPool> pBandPool;
+    int nBandThreads = parseBandThreads(argc, argv);
+    if (eBackend == FilterBackend_CPU && nBandThreads > 1) {
+      pBandPool = std::make_unique<WorkStealingPool>(nBandThreads);
+    }
+    std::shared_ptr<FilterBackend> pBackend =
+        CreateFilterBackend(eBackend, eMaxIsa, pBandPool.get());
+    auto [bPlanar, bKeepAlpha] = parseLayout(argc, argv);
+    if (bPlanar) {
+      pBackend = std::make_shared<PlanarFilterBackend>(pBackend, bKeepAlpha,
+                                                       eMaxIsa);
     }
+    printf("Filter backend: %s\n", pBackend->Name().c_str());
 
     std::ofstream logFile;
     // Parse command line arguments ...
@@ -245,49 +820,186 @@ int main(int argc, char *argv[]) {
     nMaskSize = std::get<4>(cliArgs);
     nSrcOffset = std::get<5>(cliArgs);
     nAnchor = std::get<6>(cliArgs);
+    int nTileRows = parseTileRows(argc, argv);
+    std::string sPipeline = parsePipeline(argc, argv);
+    npp::DecodeOptions oDecode = parseDecodeOptions(argc, argv);
+    npp::EncodePolicy oEncode = parseEncodePolicy(argc, argv);
+    // an image archive is processed like a directory; its results go next
+    // to it or into another archive
+    bool bInputArchive = npp::ImageArchive::IsArchiveFileName(sFilename);
+    bool bDirectory = fs::path(sFilename).filename().compare("*") == 0;
+    std::string sOutputArchive = parseOutputArchive(argc, argv);
+    std::vector<BatchOutput> aOutputs =
+        makeBatchOutputs(parseOutputs(argc, argv), nSrcOffset, nTileRows,
+                         pBackend, oDecode, oEncode, sOutputArchive.empty());
+
+    // decode, filter and encode in a pipeline; the log lists the images
+    // in the order they complete
+    BatchThreads oThreads = parseThreadArguments(argc, argv);
+    if (eBackend == FilterBackend_NPP) {
+      // the device runs one filter at a time anyway
+      oThreads.nFilter = 1;
+    }
+
+    std::unique_ptr<ResultCache> pCache = parseCache(argc, argv);
+    const size_t nMemBudget = parseMemoryBudget(argc, argv);
+    NPP_ASSERT_MSG(nMemBudget == 0 || bDirectory || bInputArchive,
+                   "-memBudget needs -input=dir/* or an image archive");
+    // with "-incremental" only new and changed files of the directory are
+    // processed
+    bool bIncremental = checkCmdLineFlag(argc, (const char **)argv,
+                                         "incremental");
+    NPP_ASSERT_MSG(!bIncremental || bDirectory,
+                   "-incremental needs -input=dir/*");
+    NPP_ASSERT_MSG(sOutputArchive.empty() || bDirectory || bInputArchive,
+                   "-outArchive needs -input=dir/* or an image archive");
+    // archive results are neither files nor kept between runs
+    NPP_ASSERT_MSG((!pCache && !bIncremental) ||
+                       (!bInputArchive && sOutputArchive.empty()),
+                   "-cache and -incremental do not work with image archives");
+
+    std::string sSocketPath = parseServe(argc, argv);
+    if (!sSocketPath.empty()) {
+      serveJobs(sSocketPath, sLogFileName, nFilterType, nMaskSize, nSrcOffset,
+                nTileRows, oThreads.nFilter, pBackend, oDecode, oEncode,
+                pCache.get());
+      exit(EXIT_SUCCESS);
+    }
 
     // if the filename is not * process only the single file;
     // otherwise, process all the files in the current directory
-    if (fs::path(sFilename).filename().compare("*") != 0) {
-      processImageFile(
+    if (!bDirectory && !bInputArchive && !aOutputs.empty()) {
+      // decode once, then filter per output and encode the results
+      // concurrently
+      BatchPipeline oPipeline(aOutputs, oThreads);
+      oPipeline.SetCache(pCache.get());
+      logFile.open(fs::path(sDirPath).parent_path().generic_string() +
+                   sLogFileName, std::ios_base::app);
+      ProcessingLog oLog(logFile, makeOutputsSettingsJson(aOutputs));
+      int nFailed = oPipeline.Run({sFilename}, &oLog);
+      logFile.close();
+      if (nFailed > 0) {
+        std::cerr << "filterNPP unable to process: <" << sFilename << ">"
+                  << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    } else if (!bDirectory && !bInputArchive) {
+      ImageRecord oRecord = processImageFile(
           sFilename, &sResultFilename, nFilterType, nMaskSize,
-          nSrcOffset, nAnchor);
+          nSrcOffset, nAnchor, nTileRows, sPipeline, pBackend, oDecode,
+          oEncode, pCache.get());
 
       // record the event in the log file in append mode
       logFile.open(fs::path(sDirPath).parent_path().generic_string() +
                    sLogFileName, std::ios_base::app);
-      logFile << "The image file, "
-              << fs::path(sFilename).filename().generic_string()
-              << ", was processed into " << sResultFilename
-              << ", Mask (" << nMaskSize << "," << nMaskSize << ")"
-              << ", Offset (" << nSrcOffset << "," << nSrcOffset << ")"
-              << ", Anchor (" << nAnchor << "," << nAnchor << ")"
-              << std::endl;
+      ProcessingLog oLog(logFile,
+                         makeImageProcessor(nFilterType, nMaskSize,
+                                            nSrcOffset, nAnchor, nTileRows,
+                                            sPipeline, pBackend, oDecode,
+                                            oEncode)
+                             .SettingsJson());
+      oLog.Write(&oRecord);
       logFile.close();
     } else {
       logFile.open(sDirPath + sLogFileName);
 
       std::vector<std::string> dirFiles;
-
-      for (fs::directory_entry const &dEntry :
-           fs::directory_iterator(sDirPath)) {
-        if (dEntry.is_regular_file()) {
-          std::string filepath =
-          (sDirPath + dEntry.path().filename().generic_string());
-          dirFiles.push_back(filepath);
+      std::unique_ptr<npp::ImageArchive> pInputArchive;
+      if (bInputArchive) {
+        pInputArchive = std::make_unique<npp::ImageArchive>(sFilename);
+      } else {
+        for (fs::directory_entry const &dEntry :
+             fs::directory_iterator(sDirPath)) {
+          // the log, the manifest and archives, also those being written,
+          // are not images
+          std::string sName = dEntry.path().filename().generic_string();
+          if (dEntry.is_regular_file() && sName != sLogFileName &&
+              sName.rfind(sManifestFileName, 0) != 0 &&
+              !npp::ImageArchive::IsArchiveFileName(sName) &&
+              !npp::ImageArchive::IsArchiveFileName(
+                  fs::path(sName).stem().string())) {
+            std::string filepath =
+            (sDirPath + dEntry.path().filename().generic_string());
+            dirFiles.push_back(filepath);
+          }
         }
       }
 
-      for (auto it = dirFiles.begin(); it != dirFiles.end(); it++) {
-        std::string filepath = *it;
-        processImageFile(
-            filepath, &sResultFilename, nFilterType, nMaskSize,
-            nSrcOffset, nAnchor);
+      std::sort(dirFiles.begin(), dirFiles.end());
 
-        logFile << "The image file, "
-                << fs::path(filepath).filename().generic_string()
-                << ", was processed into " << sResultFilename << std::endl;
+      if (aOutputs.empty()) {
+        BatchOutput oOutput;
+        oOutput.oProcessor =
+            makeImageProcessor(nFilterType, nMaskSize, nSrcOffset, nAnchor,
+                               nTileRows, sPipeline, pBackend, oDecode,
+                               oEncode);
+        std::string sFilterName = oOutput.oProcessor.FilterName();
+        bool bCreateDirectory = sOutputArchive.empty();
+        oOutput.fResultName = [sFilterName, bCreateDirectory](
+                                  const std::string &rFile,
+                                  const std::string &rExt) {
+          return makeResultFilename(rFile, sFilterName, rExt,
+                                    bCreateDirectory);
+        };
+        aOutputs.push_back(oOutput);
+      }
+      BatchPipeline oPipeline(aOutputs, oThreads);
+      oPipeline.SetCache(pCache.get());
+      oPipeline.SetBatchSize(parseBatchSize(argc, argv));
+      std::unique_ptr<npp::ImageArchiveWriter> pOutputArchive;
+      if (!sOutputArchive.empty()) {
+        pOutputArchive =
+            std::make_unique<npp::ImageArchiveWriter>(sOutputArchive);
+        oPipeline.SetOutputArchive(pOutputArchive.get());
+      }
+      std::unique_ptr<MemoryBudget> pBudget;
+      if (nMemBudget > 0) {
+        pBudget = std::make_unique<MemoryBudget>(nMemBudget);
+        oPipeline.SetMemoryBudget(pBudget.get());
+      }
+      std::unique_ptr<DirManifest> pManifest;
+      if (bIncremental) {
+        pManifest = std::make_unique<DirManifest>(
+            sDirPath + sManifestFileName, makeOutputsSettingsJson(aOutputs));
+        dirFiles = pManifest->Changed(dirFiles);
+        oPipeline.SetJobDone([&pManifest](const ImageRecord &rRecord) {
+          pManifest->Record(rRecord);
+        });
+      }
+      // one JSON record per image, closed by a summary of the batch
+      ProcessingLog oLog(logFile, makeOutputsSettingsJson(aOutputs));
+      int nFailed = pInputArchive
+                        ? oPipeline.Run(*pInputArchive, sFilename, &oLog)
+                        : oPipeline.Run(dirFiles, &oLog);
+      if (nFailed > 0) {
+        std::cerr << nFailed << " of "
+                  << (pInputArchive ? pInputArchive->size() : dirFiles.size())
+                  << " images could not be processed" << std::endl;
+      }
+      // the results that were written, even if some images failed
+      if (pOutputArchive) {
+        pOutputArchive->Close();
+      }
+      // after warming up every image should be served from the pools
+      std::string sPools = "\"pools\":{" + HostBufferPool().Summary();
+      if (eBackend == FilterBackend_NPP) {
+        sPools += "," + DeviceBufferPool().Summary();
+      }
+      sPools += "}";
+      if (pBandPool) {
+        sPools += "," + pBandPool->Summary();
+      }
+      if (pCache) {
+        sPools += "," + pCache->Summary();
+      }
+      if (pBudget) {
+        sPools += "," + pBudget->Summary();
+      }
+      if (pManifest) {
+        pManifest->Save();
+        sPools += "," + pManifest->Summary();
       }
+      oLog.WriteSummary(sPools);
       logFile.close();
     }
 
@@ -0,0 +1,198 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+// Packs images into an image archive (see imageArchive.h), unpacks and
+// lists archives:
+//   imageArchive -pack=dir/ -output=images.nia [-raw]
+//   imageArchive -unpack=images.nia -output=dir/
+//   imageArchive -list=images.nia
+// Packing takes every image of the directory that can be decoded and stores
+// the bytes of its file, or with "-raw" its decoded pixels, which filterNPP
+// then filters without decoding. Unpacking writes encoded images back as
+// they were and raw ones as binary netpbm files, or as PNG when they have
+// an alpha channel.
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <helper_string.h>
+
+#include "ImageIOEx.h"
+#include "imageArchive.h"
+
+namespace fs = std::filesystem;
+
+const char *getArgument(int argc, char *argv[], const char *zName) {
+  char *zValue = NULL;
+  if (checkCmdLineFlag(argc, (const char **)argv, zName)) {
+    getCmdLineArgumentString(argc, (const char **)argv, zName, &zValue);
+  }
+  return zValue;
+}
+
+// Add the images of sDirPath to the archive sArchive in name order; files
+// that cannot be decoded are skipped
+void packImages(const std::string &sDirPath, const std::string &sArchive,
+                bool bRaw) {
+  std::vector<fs::path> aFiles;
+  for (const fs::directory_entry &rEntry : fs::directory_iterator(sDirPath)) {
+    if (rEntry.is_regular_file() &&
+        !npp::ImageArchive::IsArchiveFileName(rEntry.path().string())) {
+      aFiles.push_back(rEntry.path());
+    }
+  }
+  std::sort(aFiles.begin(), aFiles.end());
+
+  npp::ImageArchiveWriter oWriter(sArchive);
+  size_t nBytes = 0;
+  for (const fs::path &rFile : aFiles) {
+    const std::string sName = rFile.filename().string();
+    try {
+      // the shape and bit depth for the index, and a check that the
+      // filters can read the image at all
+      npp::NppRetrieveImage oImage;
+      auto [nBitDepth, sExt] = oImage.ImageSetup(rFile.string());
+      NPP_ASSERT_MSG(nBitDepth == 8 || nBitDepth == 24 || nBitDepth == 32,
+                     "Unsupported image bit depth");
+      const npp::ImageView oPixels = oImage.sourceView();
+      if (bRaw) {
+        nBytes += oWriter.AddRaw(sName, oPixels, oImage.sourceIsBgr());
+      } else {
+        MappedFile oInput;
+        oInput.OpenRead(rFile.string());
+        nBytes += oWriter.Add(sName, oInput.data(), oInput.size(),
+                              oPixels.nWidth, oPixels.nHeight, nBitDepth);
+      }
+    } catch (npp::Exception &rException) {
+      std::cerr << "Skipping " << rFile.string() << ": " << rException
+                << std::endl;
+    }
+  }
+  const size_t nImages = oWriter.size();
+  oWriter.Close();
+  printf("Packed %zu images, %zu bytes, into %s\n", nImages, nBytes,
+         sArchive.c_str());
+}
+
+// Write the images of the archive sArchive into sDirPath
+void unpackImages(const std::string &sArchive, const std::string &sDirPath) {
+  npp::ImageArchive oArchive(sArchive);
+  for (const npp::ArchiveEntry &rEntry : oArchive.entries()) {
+    fs::path oPath = fs::path(sDirPath) / rEntry.sName;
+    std::error_code oError;
+    fs::create_directories(oPath.parent_path(), oError);
+    if (!rEntry.bRaw) {
+      std::ofstream oFile(oPath, std::ios_base::binary);
+      oFile.write(reinterpret_cast<const char *>(oArchive.data(rEntry)),
+                  rEntry.nSize);
+      NPP_ASSERT_MSG(oFile.good(), "Cannot write the unpacked image");
+      continue;
+    }
+    // raw pixels are written without loss, in the format a filter result
+    // of them would take; netpbm has no alpha channel
+    npp::NppRetrieveImage oImage;
+    oImage.ImageSetup(oArchive, rEntry);
+    npp::EncodePolicy oPolicy;
+    if (rEntry.nBitDepth == 32) {
+      oPolicy = npp::EncodePolicyFromString("png");
+    } else if (!npp::PnmImage::IsPnmFileName(rEntry.sName)) {
+      oPolicy = npp::EncodePolicyFromString("pnm");
+    }
+    oPath.replace_extension(
+        oPolicy.Extension(oPath.extension().string()));
+    const npp::ImageView oSrc = oImage.sourceView();
+    npp::NppResultImage oResult;
+    npp::ImageView oDst = oImage.resultView(&oResult, oPath.string(),
+                                            oSrc.nWidth, oSrc.nHeight,
+                                            oPolicy);
+    const Npp8u *pSrcRow = oSrc.pData;
+    Npp8u *pDstRow = oDst.pData;
+    for (int y = 0; y < oSrc.nHeight; ++y) {
+      memcpy(pDstRow, pSrcRow,
+             static_cast<size_t>(oSrc.nWidth) * oSrc.nChannels);
+      pSrcRow += oSrc.nPitch;
+      pDstRow += oDst.nPitch;
+    }
+    oResult.save(oPath.string());
+  }
+  printf("Unpacked %zu images into %s\n", oArchive.size(), sDirPath.c_str());
+}
+
+// One line per image: name, shape, bit depth, how it is stored and its size
+void listImages(const std::string &sArchive) {
+  npp::ImageArchive oArchive(sArchive);
+  for (const npp::ArchiveEntry &rEntry : oArchive.entries()) {
+    printf("%s\t%dx%d\t%d\t%s\t%llu\n", rEntry.sName.c_str(), rEntry.nWidth,
+           rEntry.nHeight, rEntry.nBitDepth, rEntry.bRaw ? "raw" : "encoded",
+           static_cast<unsigned long long>(rEntry.nSize));
+  }
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    const char *zPack = getArgument(argc, argv, "pack");
+    const char *zUnpack = getArgument(argc, argv, "unpack");
+    const char *zList = getArgument(argc, argv, "list");
+    const char *zOutput = getArgument(argc, argv, "output");
+
+    if (zPack != NULL) {
+      NPP_ASSERT_MSG(zOutput != NULL &&
+                         npp::ImageArchive::IsArchiveFileName(zOutput),
+                     "Expected -pack=dir/ -output=name.nia");
+      packImages(zPack, zOutput,
+                 checkCmdLineFlag(argc, (const char **)argv, "raw"));
+    } else if (zUnpack != NULL) {
+      NPP_ASSERT_MSG(zOutput != NULL, "Expected -unpack=name.nia -output=dir/");
+      unpackImages(zUnpack, zOutput);
+    } else if (zList != NULL) {
+      listImages(zList);
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " -pack=dir/ -output=name.nia [-raw]"
+                << " | -unpack=name.nia -output=dir/ | -list=name.nia"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  catch (npp::Exception &rException) {
+    std::cerr << "Program error! The following exception occurred: \n";
+    std::cerr << rException << std::endl;
+    std::cerr << "Aborting." << std::endl;
+
+    exit(EXIT_FAILURE);
+  }
+  return 0;
+}
@@ -0,0 +1,375 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_IMAGEARCHIVE_H_
+#define SRC_IMAGEARCHIVE_H_
+
+#include <Exceptions.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "imageView.h"
+#include "mappedFile.h"
+
+namespace npp {
+
+// One image of an archive: either the bytes of its encoded file, decoded
+// like that file, or raw 8-bit interleaved rows, top row first and without
+// padding, which are filtered where they are. Raw colour pixels are RGB or
+// RGBA, as in netpbm files.
+struct ArchiveEntry {
+    std::string sName;
+    uint64_t nOffset = 0;
+    uint64_t nSize = 0;
+    int nWidth = 0;
+    int nHeight = 0;
+    int nBitDepth = 0;
+    bool bRaw = false;
+};
+
+// Many images in a single file, so a set of small images takes one open and
+// one mapping instead of one of each per image. The layout, with integers
+// in the byte order of the machine (little-endian on all supported ones):
+//   header  "NPPIMGAR", version, number of images, offset and size of the
+//           index, 32 bytes in all
+//   images  each starting at a multiple of 64 bytes, so raw rows are as
+//           aligned as those of the image buffers
+//   index   per image its offset, size, width, height, bit depth, whether
+//           it is raw, and its name
+class ImageArchive {
+    MappedFile m_oFile;
+    std::vector<ArchiveEntry> m_aEntries;
+
+ public:
+    static constexpr char kMagic[9] = "NPPIMGAR";
+    // version 1 left the channel order of raw entries undefined
+    static constexpr uint32_t kVersion = 2;
+    static constexpr size_t kHeaderSize = 32;
+    static constexpr size_t kAlignment = 64;
+    // offset, size, width, height, bit depth, raw, unused, name length
+    static constexpr size_t kRecordSize = 8 + 8 + 4 + 4 + 2 + 1 + 1 + 2;
+
+    static bool IsArchiveFileName(const std::string &rFileName) {
+        return rFileName.size() > 4 &&
+               rFileName.compare(rFileName.size() - 4, 4, ".nia") == 0;
+    }
+
+    // Whether rName can name an entry: entries are unpacked and filtered to
+    // files named after them in a directory, so the name must be a relative
+    // path that stays in it, not empty, absolute or with ".." components
+    static bool IsEntryName(const std::string &rName) {
+        if (rName.empty() || rName[0] == '/') {
+            return false;
+        }
+        for (size_t nStart = 0; nStart <= rName.size();) {
+            size_t nEnd = rName.find('/', nStart);
+            if (nEnd == std::string::npos) {
+                nEnd = rName.size();
+            }
+            if (rName.compare(nStart, nEnd - nStart, "..") == 0) {
+                return false;
+            }
+            nStart = nEnd + 1;
+        }
+        return true;
+    }
+
+    // Map rFileName and read its index; the images are not touched until
+    // they are used
+    explicit ImageArchive(const std::string &rFileName) {
+        m_oFile.OpenRead(rFileName);
+        const unsigned char *pData = m_oFile.data();
+        const uint64_t nFileSize = m_oFile.size();
+        const std::string sCorrupt = "Not an image archive or corrupt: ";
+        if (nFileSize < kHeaderSize || memcmp(pData, kMagic, 8) != 0) {
+            throw npp::Exception(sCorrupt + rFileName);
+        }
+        uint32_t nVersion, nEntries;
+        uint64_t nIndexOffset, nIndexSize;
+        memcpy(&nVersion, pData + 8, 4);
+        memcpy(&nEntries, pData + 12, 4);
+        memcpy(&nIndexOffset, pData + 16, 8);
+        memcpy(&nIndexSize, pData + 24, 8);
+        NPP_ASSERT_MSG(nVersion == kVersion,
+                       "Image archive of an unsupported version");
+        if (nIndexOffset < kHeaderSize || nIndexOffset > nFileSize ||
+            nIndexSize > nFileSize - nIndexOffset) {
+            throw npp::Exception(sCorrupt + rFileName);
+        }
+
+        // every entry takes a record of the index, which bounds their count
+        // before anything is allocated for them
+        if (nEntries > nIndexSize / kRecordSize) {
+            throw npp::Exception(sCorrupt + rFileName);
+        }
+
+        const unsigned char *p = pData + nIndexOffset;
+        const unsigned char *pEnd = p + nIndexSize;
+        m_aEntries.resize(nEntries);
+        for (ArchiveEntry &rEntry : m_aEntries) {
+            if (pEnd - p < static_cast<ptrdiff_t>(kRecordSize)) {
+                throw npp::Exception(sCorrupt + rFileName);
+            }
+            uint32_t nWidth, nHeight;
+            uint16_t nBitDepth, nNameLength;
+            memcpy(&rEntry.nOffset, p, 8);
+            memcpy(&rEntry.nSize, p + 8, 8);
+            memcpy(&nWidth, p + 16, 4);
+            memcpy(&nHeight, p + 20, 4);
+            memcpy(&nBitDepth, p + 24, 2);
+            rEntry.bRaw = p[26] != 0;
+            memcpy(&nNameLength, p + 28, 2);
+            p += kRecordSize;
+            if (pEnd - p < nNameLength || rEntry.nOffset > nIndexOffset ||
+                rEntry.nSize > nIndexOffset - rEntry.nOffset) {
+                throw npp::Exception(sCorrupt + rFileName);
+            }
+            rEntry.sName.assign(reinterpret_cast<const char *>(p),
+                                nNameLength);
+            p += nNameLength;
+            if (!IsEntryName(rEntry.sName)) {
+                throw npp::Exception(sCorrupt + rFileName);
+            }
+            rEntry.nWidth = static_cast<int>(nWidth);
+            rEntry.nHeight = static_cast<int>(nHeight);
+            rEntry.nBitDepth = nBitDepth;
+            if (rEntry.bRaw &&
+                ((nBitDepth != 8 && nBitDepth != 24 && nBitDepth != 32) ||
+                 rEntry.nSize != static_cast<uint64_t>(nWidth) * nHeight *
+                                     (nBitDepth / 8))) {
+                throw npp::Exception(sCorrupt + rFileName);
+            }
+        }
+    }
+
+    ImageArchive(const ImageArchive &) = delete;
+    ImageArchive &operator=(const ImageArchive &) = delete;
+
+    size_t size() const { return m_aEntries.size(); }
+    const ArchiveEntry &entry(size_t nIndex) const {
+        return m_aEntries[nIndex];
+    }
+    const std::vector<ArchiveEntry> &entries() const { return m_aEntries; }
+
+    // The stored bytes of rEntry, in the mapping
+    const unsigned char *data(const ArchiveEntry &rEntry) const {
+        return m_oFile.data() + rEntry.nOffset;
+    }
+
+    // The pixels of a raw entry, in the mapping; they are read-only
+    ImageView view(const ArchiveEntry &rEntry) const {
+        NPP_ASSERT_MSG(rEntry.bRaw, "Image archive entry is not raw");
+        ImageView oView;
+        oView.pData = const_cast<Npp8u *>(data(rEntry));
+        oView.nWidth = rEntry.nWidth;
+        oView.nHeight = rEntry.nHeight;
+        oView.nChannels = rEntry.nBitDepth / 8;
+        oView.nPitch = rEntry.nWidth * oView.nChannels;
+        return oView;
+    }
+};
+
+// Writes an archive, one image at a time and from any thread. It is written
+// under a temporary name and only takes its own name once Close() has added
+// the index, so an interrupted run leaves no truncated archive behind.
+class ImageArchiveWriter {
+    std::string m_sPath;
+    std::string m_sTemporary;
+    std::ofstream m_oFile;
+    uint64_t m_nEnd = ImageArchive::kHeaderSize;
+    std::vector<ArchiveEntry> m_aEntries;
+    std::set<std::string> m_aNames;
+    std::mutex m_oMutex;
+
+    // Append the index record of rEntry to *pIndex
+    static void AppendRecord(const ArchiveEntry &rEntry,
+                             std::string *pIndex) {
+        unsigned char aRecord[ImageArchive::kRecordSize] = {};
+        const uint32_t nWidth = rEntry.nWidth;
+        const uint32_t nHeight = rEntry.nHeight;
+        const uint16_t nBitDepth = rEntry.nBitDepth;
+        const uint16_t nNameLength = rEntry.sName.size();
+        memcpy(aRecord, &rEntry.nOffset, 8);
+        memcpy(aRecord + 8, &rEntry.nSize, 8);
+        memcpy(aRecord + 16, &nWidth, 4);
+        memcpy(aRecord + 20, &nHeight, 4);
+        memcpy(aRecord + 24, &nBitDepth, 2);
+        aRecord[26] = rEntry.bRaw ? 1 : 0;
+        memcpy(aRecord + 28, &nNameLength, 2);
+        pIndex->append(reinterpret_cast<const char *>(aRecord),
+                       sizeof(aRecord));
+        pIndex->append(rEntry.sName);
+    }
+
+    // Start rEntry at the next aligned offset; the caller holds the lock
+    void Begin(ArchiveEntry *pEntry) {
+        NPP_ASSERT_MSG(m_oFile.is_open(), "Image archive is closed");
+        NPP_ASSERT_MSG(ImageArchive::IsEntryName(pEntry->sName) &&
+                           pEntry->sName.size() <= 0xFFFF,
+                       "Image archive entry name not a relative path in the "
+                       "archive, or too long");
+        NPP_ASSERT_MSG(m_aNames.insert(pEntry->sName).second,
+                       "Image archive entry name used twice");
+        const uint64_t nPadding =
+            (ImageArchive::kAlignment - m_nEnd % ImageArchive::kAlignment) %
+            ImageArchive::kAlignment;
+        static const char aZeros[ImageArchive::kAlignment] = {};
+        m_oFile.write(aZeros, nPadding);
+        pEntry->nOffset = m_nEnd + nPadding;
+        m_nEnd = pEntry->nOffset + pEntry->nSize;
+    }
+
+    void End(const ArchiveEntry &rEntry) {
+        NPP_ASSERT_MSG(m_oFile.good(), "Cannot write the image archive");
+        m_aEntries.push_back(rEntry);
+    }
+
+ public:
+    explicit ImageArchiveWriter(const std::string &rFileName)
+        : m_sPath(rFileName), m_sTemporary(rFileName + ".tmp") {
+        m_oFile.open(m_sTemporary, std::ios_base::binary |
+                                       std::ios_base::trunc);
+        if (!m_oFile.is_open()) {
+            throw npp::Exception("Cannot create " + m_sTemporary);
+        }
+        // the header is written by Close()
+        static const char aZeros[ImageArchive::kHeaderSize] = {};
+        m_oFile.write(aZeros, sizeof(aZeros));
+    }
+
+    ImageArchiveWriter(const ImageArchiveWriter &) = delete;
+    ImageArchiveWriter &operator=(const ImageArchiveWriter &) = delete;
+
+    // An archive that was not closed is dropped
+    ~ImageArchiveWriter() {
+        if (m_oFile.is_open()) {
+            m_oFile.close();
+            remove(m_sTemporary.c_str());
+        }
+    }
+
+    // Add the nSize bytes of an encoded image file; returns the bytes stored
+    size_t Add(const std::string &rName, const void *pData, size_t nSize,
+               int nWidth, int nHeight, int nBitDepth) {
+        ArchiveEntry oEntry;
+        oEntry.sName = rName;
+        oEntry.nSize = nSize;
+        oEntry.nWidth = nWidth;
+        oEntry.nHeight = nHeight;
+        oEntry.nBitDepth = nBitDepth;
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        Begin(&oEntry);
+        m_oFile.write(static_cast<const char *>(pData), nSize);
+        End(oEntry);
+        return nSize;
+    }
+
+    // Add the pixels of rPixels as a raw image, converted to RGB(A) when
+    // bBgr tells they are BGR(A); returns the bytes stored
+    size_t AddRaw(const std::string &rName, const ImageView &rPixels,
+                  bool bBgr = false) {
+        ArchiveEntry oEntry;
+        oEntry.sName = rName;
+        oEntry.nWidth = rPixels.nWidth;
+        oEntry.nHeight = rPixels.nHeight;
+        oEntry.nBitDepth = 8 * rPixels.nChannels;
+        oEntry.bRaw = true;
+        NPP_ASSERT_MSG(rPixels.nChannels == 1 || rPixels.nChannels == 3 ||
+                           rPixels.nChannels == 4,
+                       "Raw archive entries have 1, 3 or 4 channels");
+        const size_t nRowBytes =
+            static_cast<size_t>(rPixels.nWidth) * rPixels.nChannels;
+        oEntry.nSize = nRowBytes * rPixels.nHeight;
+        const bool bSwap = bBgr && rPixels.nChannels > 1;
+        std::vector<Npp8u> aRow(bSwap ? nRowBytes : 0);
+        ImageView oRow = rPixels;
+        oRow.pData = aRow.data();
+        oRow.nHeight = 1;
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        Begin(&oEntry);
+        const Npp8u *pRow = rPixels.pData;
+        for (int y = 0; y < rPixels.nHeight; ++y, pRow += rPixels.nPitch) {
+            const Npp8u *pOut = pRow;
+            if (bSwap) {
+                memcpy(aRow.data(), pRow, nRowBytes);
+                SwapRedBlue(oRow, 0, 1);
+                pOut = aRow.data();
+            }
+            m_oFile.write(reinterpret_cast<const char *>(pOut), nRowBytes);
+        }
+        End(oEntry);
+        return oEntry.nSize;
+    }
+
+    // Write the index and the header and give the archive its name
+    void Close() {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        NPP_ASSERT_MSG(m_oFile.is_open(), "Image archive is closed");
+        std::string sIndex;
+        for (const ArchiveEntry &rEntry : m_aEntries) {
+            AppendRecord(rEntry, &sIndex);
+        }
+        m_oFile.write(sIndex.data(), sIndex.size());
+
+        unsigned char aHeader[ImageArchive::kHeaderSize] = {};
+        const uint32_t nVersion = ImageArchive::kVersion;
+        const uint32_t nEntries = m_aEntries.size();
+        const uint64_t nIndexSize = sIndex.size();
+        memcpy(aHeader, ImageArchive::kMagic, 8);
+        memcpy(aHeader + 8, &nVersion, 4);
+        memcpy(aHeader + 12, &nEntries, 4);
+        memcpy(aHeader + 16, &m_nEnd, 8);
+        memcpy(aHeader + 24, &nIndexSize, 8);
+        m_oFile.seekp(0);
+        m_oFile.write(reinterpret_cast<const char *>(aHeader),
+                      sizeof(aHeader));
+        m_oFile.close();
+        NPP_ASSERT_MSG(!m_oFile.fail(), "Cannot write the image archive");
+        NPP_ASSERT_MSG(rename(m_sTemporary.c_str(), m_sPath.c_str()) == 0,
+                       "Cannot rename the image archive");
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        return m_aEntries.size();
+    }
+};
+
+}  // namespace npp
+#endif  //  SRC_IMAGEARCHIVE_H_
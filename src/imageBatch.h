@@ -0,0 +1,150 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_IMAGEBATCH_H_
+#define SRC_IMAGEBATCH_H_
+
+#include <Exceptions.h>
+#include <npp.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "imageBufferPool.h"
+#include "imageView.h"
+
+// Images of the same size and channel count stacked into one buffer, so a
+// backend filters all of them in a single call: one upload, one launch and
+// one download for NPP, and bands that span many images for the CPU. Every
+// image gets the halo rows its mask reads above and below it, replicated
+// from its edge rows as NPP_BORDER_REPLICATE would, so the filter never
+// reads a neighbour and each result is the same as filtering the image
+// alone. The results come out stacked the same way; Unstack() copies them
+// to their images.
+class ImageBatch {
+    int m_nImages;
+    int m_nWidth;
+    int m_nHeight;
+    int m_nChannels;
+    int m_nAbove;
+    // rows per image in the stack, halos included
+    int m_nSlotRows;
+    std::unique_ptr<PooledImageBuffer> m_pSrc;
+    std::unique_ptr<PooledImageBuffer> m_pDst;
+
+ public:
+    // Rows of halo above and below the images for a filter whose mask
+    // reaches nMaskAbove rows above and nMaskBelow rows below the row it
+    // filters, read at a vertical source offset of nOffsetY
+    static void Halo(int nMaskAbove, int nMaskBelow, int nOffsetY,
+                     int *pnAbove, int *pnBelow) {
+        *pnAbove = std::max(nMaskAbove - nOffsetY, 0);
+        *pnBelow = std::max(nOffsetY + nMaskBelow, 0);
+    }
+
+    // Stack the images of aSrc with nAbove and nBelow halo rows each
+    ImageBatch(BufferPool *pPool, const std::vector<npp::ImageView> &aSrc,
+               int nAbove, int nBelow)
+        : m_nImages(static_cast<int>(aSrc.size())), m_nAbove(nAbove) {
+        NPP_ASSERT_MSG(!aSrc.empty(), "Empty image batch");
+        m_nWidth = aSrc[0].nWidth;
+        m_nHeight = aSrc[0].nHeight;
+        m_nChannels = aSrc[0].nChannels;
+        m_nSlotRows = nAbove + m_nHeight + nBelow;
+        const int nRowBytes = m_nWidth * m_nChannels;
+        m_pSrc.reset(new PooledImageBuffer(pPool, nRowBytes,
+                                           m_nImages * m_nSlotRows, 64));
+        m_pDst.reset(new PooledImageBuffer(pPool, nRowBytes,
+                                           roiSize().height, 64));
+        for (int i = 0; i < m_nImages; ++i) {
+            const npp::ImageView &rImage = aSrc[i];
+            NPP_ASSERT_MSG(rImage.nWidth == m_nWidth &&
+                               rImage.nHeight == m_nHeight &&
+                               rImage.nChannels == m_nChannels,
+                           "The images of a batch must have the same shape");
+            Npp8u *pSlot = m_pSrc->data() +
+                           static_cast<ptrdiff_t>(i) * m_nSlotRows * pitch();
+            for (int nRow = 0; nRow < m_nSlotRows; ++nRow) {
+                const int nImageRow =
+                    std::min(std::max(nRow - nAbove, 0), m_nHeight - 1);
+                memcpy(pSlot + static_cast<ptrdiff_t>(nRow) * pitch(),
+                       rImage.pData +
+                           static_cast<ptrdiff_t>(nImageRow) * rImage.nPitch,
+                       nRowBytes);
+            }
+        }
+    }
+
+    int images() const { return m_nImages; }
+    int channels() const { return m_nChannels; }
+    // pitch of both stacks
+    Npp32s pitch() const { return m_pSrc->pitch(); }
+
+    const Npp8u *src() const { return m_pSrc->data(); }
+    NppiSize srcSize() const {
+        NppiSize oSize = {m_nWidth, m_nImages * m_nSlotRows};
+        return oSize;
+    }
+    // the source offset of the stack for oOffset of the images
+    NppiPoint srcOffset(NppiPoint oOffset) const {
+        oOffset.y += m_nAbove;
+        return oOffset;
+    }
+
+    // result i starts at row i * m_nSlotRows; the rows in between belong to
+    // no image and are dropped
+    Npp8u *dst() const { return m_pDst->data(); }
+    NppiSize roiSize() const {
+        NppiSize oSize = {m_nWidth, (m_nImages - 1) * m_nSlotRows + m_nHeight};
+        return oSize;
+    }
+
+    void Unstack(const std::vector<npp::ImageView> &aDst) const {
+        NPP_ASSERT(static_cast<int>(aDst.size()) == m_nImages);
+        for (int i = 0; i < m_nImages; ++i) {
+            const npp::ImageView &rImage = aDst[i];
+            NPP_ASSERT(rImage.nWidth == m_nWidth &&
+                       rImage.nHeight == m_nHeight &&
+                       rImage.nChannels == m_nChannels);
+            const Npp8u *pSlot =
+                dst() + static_cast<ptrdiff_t>(i) * m_nSlotRows * pitch();
+            for (int nRow = 0; nRow < m_nHeight; ++nRow) {
+                memcpy(rImage.pData +
+                           static_cast<ptrdiff_t>(nRow) * rImage.nPitch,
+                       pSlot + static_cast<ptrdiff_t>(nRow) * pitch(),
+                       m_nWidth * m_nChannels);
+            }
+        }
+    }
+};
+#endif  //  SRC_IMAGEBATCH_H_
@@ -0,0 +1,259 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_IMAGEBUFFERPOOL_H_
+#define SRC_IMAGEBUFFERPOOL_H_
+
+#include <Exceptions.h>
+#include <ImagesCPU.h>
+
+#include <cuda_runtime.h>
+#include <npp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Cache of image buffers grouped in size classes. Released buffers are kept
+// on a free list of their class and handed out again to the next request of
+// that class, so processing a series of similar images stops allocating once
+// the pool has warmed up. The bookkeeping reuses its containers as well, so a
+// hit performs no heap allocation at all.
+class BufferPool {
+ public:
+    typedef void *(*AllocateFunction)(size_t nBytes);
+    typedef void (*FreeFunction)(void *pBuffer);
+
+    struct Stats {
+        size_t nHits = 0;
+        size_t nMisses = 0;
+        size_t nInUseBytes = 0;
+        size_t nCachedBytes = 0;
+    };
+
+ private:
+    std::string m_sName;
+    AllocateFunction m_fAllocate;
+    FreeFunction m_fFree;
+    size_t m_nMaxCachedBytes;
+    std::mutex m_oMutex;
+    std::unordered_map<size_t, std::vector<void *>> m_aFreeLists;
+    // buffers handed out, with their size class
+    std::vector<std::pair<void *, size_t>> m_aInUse;
+    Stats m_oStats;
+
+ public:
+    BufferPool(const std::string &rName, AllocateFunction fAllocate,
+               FreeFunction fFree, size_t nMaxCachedBytes = size_t(1) << 30)
+        : m_sName(rName), m_fAllocate(fAllocate), m_fFree(fFree),
+          m_nMaxCachedBytes(nMaxCachedBytes) {}
+
+    ~BufferPool() {
+        for (auto &rFreeList : m_aFreeLists) {
+            for (void *pBuffer : rFreeList.second) {
+                m_fFree(pBuffer);
+            }
+        }
+    }
+
+    // Requests are rounded up to 2^k or 3 * 2^(k-1) bytes, at least 4 KiB, so
+    // a buffer wastes at most a third of its size
+    static size_t SizeClass(size_t nBytes) {
+        size_t nClass = 4096;
+        while (nClass < nBytes) {
+            if (nClass + nClass / 2 >= nBytes) {
+                return nClass + nClass / 2;
+            }
+            nClass *= 2;
+        }
+        return nClass;
+    }
+
+    void *Acquire(size_t nBytes) {
+        const size_t nClass = SizeClass(nBytes);
+        void *pBuffer = NULL;
+        {
+            std::lock_guard<std::mutex> oLock(m_oMutex);
+            std::vector<void *> &rFreeList = m_aFreeLists[nClass];
+            if (!rFreeList.empty()) {
+                pBuffer = rFreeList.back();
+                rFreeList.pop_back();
+                m_oStats.nHits++;
+                m_oStats.nCachedBytes -= nClass;
+            } else {
+                m_oStats.nMisses++;
+            }
+        }
+        if (pBuffer == NULL) {
+            pBuffer = m_fAllocate(nClass);
+            NPP_ASSERT_MSG(pBuffer != NULL, "Image buffer allocation failed");
+        }
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        m_aInUse.emplace_back(pBuffer, nClass);
+        m_oStats.nInUseBytes += nClass;
+        return pBuffer;
+    }
+
+    void Release(void *pBuffer) {
+        if (pBuffer == NULL) {
+            return;
+        }
+        std::unique_lock<std::mutex> oLock(m_oMutex);
+        auto it = std::find_if(m_aInUse.begin(), m_aInUse.end(),
+                               [pBuffer](const std::pair<void *, size_t> &r) {
+                                   return r.first == pBuffer;
+                               });
+        NPP_ASSERT_MSG(it != m_aInUse.end(), "Buffer not owned by the pool");
+        const size_t nClass = it->second;
+        *it = m_aInUse.back();
+        m_aInUse.pop_back();
+        m_oStats.nInUseBytes -= nClass;
+
+        if (m_oStats.nCachedBytes + nClass <= m_nMaxCachedBytes) {
+            m_aFreeLists[nClass].push_back(pBuffer);
+            m_oStats.nCachedBytes += nClass;
+        } else {
+            oLock.unlock();
+            m_fFree(pBuffer);
+        }
+    }
+
+    Stats GetStats() {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        return m_oStats;
+    }
+
+    // Counters as a JSON member for the summary of the processing log
+    std::string Summary() {
+        Stats oStats = GetStats();
+        std::ostringstream oJson;
+        oJson << "\"" << m_sName << "\":{\"hits\":" << oStats.nHits
+              << ",\"misses\":" << oStats.nMisses
+              << ",\"cached_bytes\":" << oStats.nCachedBytes << "}";
+        return oJson.str();
+    }
+
+    static void *AllocateHost(size_t nBytes) {
+        // size classes are multiples of 4 KiB, as aligned_alloc requires
+        return aligned_alloc(64, nBytes);
+    }
+
+    static void FreeHost(void *pBuffer) { free(pBuffer); }
+
+    static void *AllocateDevice(size_t nBytes) {
+        void *pBuffer = NULL;
+        return cudaMalloc(&pBuffer, nBytes) == cudaSuccess ? pBuffer : NULL;
+    }
+
+    static void FreeDevice(void *pBuffer) { cudaFree(pBuffer); }
+};
+
+inline BufferPool &HostBufferPool() {
+    static BufferPool oPool("host", BufferPool::AllocateHost,
+                            BufferPool::FreeHost);
+    return oPool;
+}
+
+inline BufferPool &DeviceBufferPool() {
+    static BufferPool oPool("device", BufferPool::AllocateDevice,
+                            BufferPool::FreeDevice);
+    return oPool;
+}
+
+// Pitched 2D image buffer borrowed from a pool for the lifetime of the object
+class PooledImageBuffer {
+    BufferPool *m_pPool = NULL;
+    Npp8u *m_pData = NULL;
+    int m_nPitch = 0;
+
+ public:
+    PooledImageBuffer(BufferPool *pPool, int nRowBytes, int nHeight,
+                      int nPitchAlignment = 1)
+        : m_pPool(pPool) {
+        m_nPitch = (nRowBytes + nPitchAlignment - 1) / nPitchAlignment *
+                   nPitchAlignment;
+        m_pData = static_cast<Npp8u *>(
+            pPool->Acquire(static_cast<size_t>(m_nPitch) * nHeight));
+    }
+
+    PooledImageBuffer(const PooledImageBuffer &) = delete;
+    PooledImageBuffer &operator=(const PooledImageBuffer &) = delete;
+
+    ~PooledImageBuffer() { m_pPool->Release(m_pData); }
+
+    Npp8u *data() const { return m_pData; }
+    int pitch() const { return m_nPitch; }
+};
+
+namespace npp {
+// Allocator for the ImageCPU template that draws the pixels from the host
+// buffer pool
+template <typename D, size_t N>
+class ImageAllocatorPooledCPU {
+ public:
+    static D *Malloc2D(unsigned int nWidth, unsigned int nHeight,
+                       unsigned int *pPitch) {
+        NPP_ASSERT(nWidth * nHeight > 0);
+        *pPitch = nWidth * sizeof(D) * N;
+        return static_cast<D *>(HostBufferPool().Acquire(
+            static_cast<size_t>(*pPitch) * nHeight));
+    }
+
+    static void Free2D(D *pPixels) { HostBufferPool().Release(pPixels); }
+
+    static void Copy2D(D *pDst, size_t nDstPitch, const D *pSrc,
+                       size_t nSrcPitch, size_t nWidth, size_t nHeight) {
+        const Npp8u *pSrcLine = reinterpret_cast<const Npp8u *>(pSrc);
+        Npp8u *pDstLine = reinterpret_cast<Npp8u *>(pDst);
+        for (size_t iLine = 0; iLine < nHeight; ++iLine) {
+            memcpy(pDstLine, pSrcLine, nWidth * N * sizeof(D));
+            pDstLine += nDstPitch;
+            pSrcLine += nSrcPitch;
+        }
+    }
+};
+
+typedef ImageCPU<Npp8u, 1, ImageAllocatorPooledCPU<Npp8u, 1> >
+    ImagePooledCPU_8u_C1;
+typedef ImageCPU<Npp8u, 2, ImageAllocatorPooledCPU<Npp8u, 2> >
+    ImagePooledCPU_8u_C2;
+typedef ImageCPU<Npp8u, 3, ImageAllocatorPooledCPU<Npp8u, 3> >
+    ImagePooledCPU_8u_C3;
+typedef ImageCPU<Npp8u, 4, ImageAllocatorPooledCPU<Npp8u, 4> >
+    ImagePooledCPU_8u_C4;
+}  // namespace npp
+#endif  //  SRC_IMAGEBUFFERPOOL_H_
@@ -0,0 +1,69 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_IMAGEVIEW_H_
+#define SRC_IMAGEVIEW_H_
+
+#include <npp.h>
+#include <stddef.h>
+
+namespace npp {
+
+// Window onto 8-bit interleaved pixels without owning them. pData points at
+// the top row and nPitch is the signed distance to the next row, so the
+// bottom-up bitmaps of FreeImage are described by a negative pitch.
+struct ImageView {
+    Npp8u *pData = NULL;
+    Npp32s nPitch = 0;
+    int nWidth = 0;
+    int nHeight = 0;
+    int nChannels = 0;
+};
+
+// Swap the first and third sample of every pixel in the rows [nBegin, nEnd)
+// of a colour view, converting between RGB(A) and BGR(A)
+inline void SwapRedBlue(const ImageView &rView, int nBegin, int nEnd) {
+    if (rView.nChannels < 3) {
+        return;
+    }
+    for (int y = nBegin; y < nEnd; ++y) {
+        Npp8u *pPixel = rView.pData + rView.nPitch * static_cast<ptrdiff_t>(y);
+        Npp8u *pEnd = pPixel + rView.nWidth * rView.nChannels;
+        for (; pPixel < pEnd; pPixel += rView.nChannels) {
+            const Npp8u nRed = pPixel[0];
+            pPixel[0] = pPixel[2];
+            pPixel[2] = nRed;
+        }
+    }
+}
+
+}  // namespace npp
+#endif  //  SRC_IMAGEVIEW_H_
@@ -0,0 +1,371 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_JOBSERVER_H_
+#define SRC_JOBSERVER_H_
+
+#include <Exceptions.h>
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "processingLog.h"
+
+// Fields of a job, sent as one flat JSON object per line such as
+// {"input":"data/Lena.pgm","filter":"gauss","mask":6}. Numbers, true, false
+// and null are kept as their text.
+typedef std::map<std::string, std::string> JobFields;
+
+// Parse a job line; throws for anything but a flat JSON object
+inline JobFields ParseJobLine(const std::string &rLine) {
+    size_t i = 0;
+    auto fSkipSpace = [&] {
+        while (i < rLine.size() &&
+               isspace(static_cast<unsigned char>(rLine[i]))) {
+            ++i;
+        }
+    };
+    auto fExpect = [&](char c) {
+        fSkipSpace();
+        if (i >= rLine.size() || rLine[i] != c) {
+            throw npp::Exception(std::string("Malformed job, expected '") + c +
+                                 "'");
+        }
+        ++i;
+    };
+    auto fString = [&] {
+        fExpect('"');
+        std::string sValue;
+        while (i < rLine.size() && rLine[i] != '"') {
+            char c = rLine[i++];
+            if (c == '\\' && i < rLine.size()) {
+                c = rLine[i++];
+                switch (c) {
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case 'u': {
+                    // code points of the basic plane, as UTF-8
+                    NPP_ASSERT_MSG(i + 4 <= rLine.size(),
+                                   "Malformed job, short \\u escape");
+                    unsigned nCode = static_cast<unsigned>(
+                        strtoul(rLine.substr(i, 4).c_str(), NULL, 16));
+                    i += 4;
+                    if (nCode < 0x80) {
+                        sValue += static_cast<char>(nCode);
+                    } else if (nCode < 0x800) {
+                        sValue += static_cast<char>(0xC0 | (nCode >> 6));
+                        sValue += static_cast<char>(0x80 | (nCode & 0x3F));
+                    } else {
+                        sValue += static_cast<char>(0xE0 | (nCode >> 12));
+                        sValue += static_cast<char>(0x80 |
+                                                    ((nCode >> 6) & 0x3F));
+                        sValue += static_cast<char>(0x80 | (nCode & 0x3F));
+                    }
+                    continue;
+                }
+                default: break;  // '"', '\\' and '/' stand for themselves
+                }
+            }
+            sValue += c;
+        }
+        fExpect('"');
+        return sValue;
+    };
+
+    JobFields aFields;
+    fExpect('{');
+    fSkipSpace();
+    if (i < rLine.size() && rLine[i] == '}') {
+        ++i;
+    } else {
+        for (;;) {
+            std::string sKey = fString();
+            fExpect(':');
+            fSkipSpace();
+            if (i < rLine.size() && rLine[i] == '"') {
+                aFields[sKey] = fString();
+            } else {
+                const size_t nBegin = i;
+                while (i < rLine.size() && rLine[i] != ',' &&
+                       rLine[i] != '}' &&
+                       !isspace(static_cast<unsigned char>(rLine[i]))) {
+                    ++i;
+                }
+                const std::string sValue = rLine.substr(nBegin, i - nBegin);
+                NPP_ASSERT_MSG(!sValue.empty() && sValue[0] != '{' &&
+                                   sValue[0] != '[',
+                               "Malformed job, values must be strings or "
+                               "numbers");
+                aFields[sKey] = sValue;
+            }
+            fSkipSpace();
+            if (i < rLine.size() && rLine[i] == ',') {
+                ++i;
+                continue;
+            }
+            fExpect('}');
+            break;
+        }
+    }
+    fSkipSpace();
+    NPP_ASSERT_MSG(i == rLine.size(), "Malformed job, text after the object");
+    return aFields;
+}
+
+// Runs a job and returns its reply, a JSON object without the newline
+typedef std::function<std::string(const JobFields &)> JobHandler;
+
+// Serves jobs on a Unix domain socket. Every client gets its own thread that
+// reads newline-delimited JSON jobs and answers each with one JSON line, in
+// order. Clients run concurrently; the handler limits what has to be
+// serialized. {"command":"shutdown"} stops the server once the jobs in
+// progress are answered.
+class JobServer {
+    // longest job line accepted, so a client cannot grow a buffer unbounded
+    static const size_t kMaxLineBytes = 1 << 20;
+
+    std::string m_sSocketPath;
+    JobHandler m_fHandler;
+    int m_nListenSocket = -1;
+    std::atomic<bool> m_bStopping{false};
+    std::mutex m_oMutex;
+    std::vector<int> m_aClientSockets;
+    // client threads are detached, so a long-running server does not keep
+    // one per connection it ever served; Serve() waits for this to drop to 0
+    int m_nClients = 0;
+    std::condition_variable m_oClientsDone;
+
+    static bool SendAll(int nSocket, const std::string &rData) {
+        size_t nSent = 0;
+        while (nSent < rData.size()) {
+            ssize_t nBytes = send(nSocket, rData.data() + nSent,
+                                  rData.size() - nSent, MSG_NOSIGNAL);
+            if (nBytes <= 0) {
+                return false;
+            }
+            nSent += static_cast<size_t>(nBytes);
+        }
+        return true;
+    }
+
+    static std::string ErrorReply(const std::string &rError) {
+        return "{\"status\":\"error\",\"error\":" + JsonString(rError) + "}";
+    }
+
+    std::string Reply(const std::string &rLine) {
+        JobFields aJob;
+        try {
+            aJob = ParseJobLine(rLine);
+        } catch (npp::Exception &rException) {
+            std::ostringstream oMessage;
+            oMessage << rException;
+            return ErrorReply(oMessage.str());
+        }
+        if (aJob.count("command") > 0) {
+            if (aJob["command"] == "shutdown") {
+                Stop();
+                return "{\"status\":\"ok\",\"command\":\"shutdown\"}";
+            }
+            return ErrorReply("Unknown command: " + aJob["command"]);
+        }
+        try {
+            return m_fHandler(aJob);
+        } catch (npp::Exception &rException) {
+            std::ostringstream oMessage;
+            oMessage << rException;
+            return ErrorReply(oMessage.str());
+        } catch (std::exception &rException) {
+            return ErrorReply(rException.what());
+        }
+    }
+
+    void ServeClient(int nSocket) {
+        std::string sPending;
+        char aBuffer[65536];
+        bool bOpen = true;
+        while (bOpen) {
+            ssize_t nBytes = recv(nSocket, aBuffer, sizeof(aBuffer), 0);
+            if (nBytes <= 0) {
+                break;
+            }
+            sPending.append(aBuffer, static_cast<size_t>(nBytes));
+            size_t nLineEnd;
+            while (bOpen && (nLineEnd = sPending.find('\n')) !=
+                                std::string::npos) {
+                std::string sLine = sPending.substr(0, nLineEnd);
+                sPending.erase(0, nLineEnd + 1);
+                if (sLine.find_first_not_of(" \t\r") == std::string::npos) {
+                    continue;
+                }
+                bOpen = SendAll(nSocket, Reply(sLine) + "\n");
+            }
+            if (sPending.size() > kMaxLineBytes) {
+                SendAll(nSocket, ErrorReply("Job line too long") + "\n");
+                break;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> oLock(m_oMutex);
+            m_aClientSockets.erase(std::find(m_aClientSockets.begin(),
+                                             m_aClientSockets.end(),
+                                             nSocket));
+        }
+        close(nSocket);
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        m_nClients--;
+        m_oClientsDone.notify_all();
+    }
+
+ public:
+    JobServer(const std::string &rSocketPath, JobHandler fHandler)
+        : m_sSocketPath(rSocketPath), m_fHandler(fHandler) {}
+
+    JobServer(const JobServer &) = delete;
+    JobServer &operator=(const JobServer &) = delete;
+
+    // Accept clients until Stop(); returns when all of them are done
+    void Serve() {
+        sockaddr_un oAddress = {};
+        oAddress.sun_family = AF_UNIX;
+        NPP_ASSERT_MSG(m_sSocketPath.size() < sizeof(oAddress.sun_path),
+                       "Socket path too long");
+        strncpy(oAddress.sun_path, m_sSocketPath.c_str(),
+                sizeof(oAddress.sun_path) - 1);
+
+        m_nListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+        NPP_ASSERT_MSG(m_nListenSocket >= 0, "Cannot create socket");
+        // a socket file left behind by an earlier server is replaced, any
+        // other file at the path is left alone
+        struct stat oStat;
+        if (lstat(m_sSocketPath.c_str(), &oStat) == 0) {
+            if (!S_ISSOCK(oStat.st_mode)) {
+                close(m_nListenSocket);
+                throw npp::Exception("Not a socket, not replacing " +
+                                     m_sSocketPath);
+            }
+            unlink(m_sSocketPath.c_str());
+        }
+        if (bind(m_nListenSocket, reinterpret_cast<sockaddr *>(&oAddress),
+                 sizeof(oAddress)) != 0 ||
+            listen(m_nListenSocket, SOMAXCONN) != 0) {
+            close(m_nListenSocket);
+            throw npp::Exception("Cannot listen on " + m_sSocketPath);
+        }
+
+        while (!m_bStopping) {
+            int nSocket = accept(m_nListenSocket, NULL, NULL);
+            if (nSocket < 0) {
+                if (m_bStopping || errno != EINTR) {
+                    break;
+                }
+                continue;
+            }
+            std::lock_guard<std::mutex> oLock(m_oMutex);
+            if (m_bStopping) {
+                close(nSocket);
+                break;
+            }
+            m_aClientSockets.push_back(nSocket);
+            m_nClients++;
+            std::thread([this, nSocket] { ServeClient(nSocket); }).detach();
+        }
+        {
+            std::unique_lock<std::mutex> oLock(m_oMutex);
+            m_oClientsDone.wait(oLock, [this] { return m_nClients == 0; });
+        }
+        close(m_nListenSocket);
+        unlink(m_sSocketPath.c_str());
+    }
+
+    // Stop accepting clients and jobs; jobs being run are still answered
+    void Stop() {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        m_bStopping = true;
+        shutdown(m_nListenSocket, SHUT_RDWR);
+        for (int nSocket : m_aClientSockets) {
+            shutdown(nSocket, SHUT_RD);
+        }
+    }
+};
+
+// Counting semaphore that bounds how many jobs filter at the same time
+class JobSlots {
+    std::mutex m_oMutex;
+    std::condition_variable m_oFree;
+    int m_nFree;
+
+ public:
+    explicit JobSlots(int nSlots) : m_nFree(std::max(nSlots, 1)) {}
+
+    void Acquire() {
+        std::unique_lock<std::mutex> oLock(m_oMutex);
+        m_oFree.wait(oLock, [this] { return m_nFree > 0; });
+        m_nFree--;
+    }
+
+    void Release() {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        m_nFree++;
+        m_oFree.notify_one();
+    }
+
+    // Holds a slot for the lifetime of the object
+    class Lease {
+        JobSlots *m_pSlots;
+
+     public:
+        explicit Lease(JobSlots *pSlots) : m_pSlots(pSlots) {
+            m_pSlots->Acquire();
+        }
+        ~Lease() { m_pSlots->Release(); }
+    };
+};
+#endif  //  SRC_JOBSERVER_H_
@@ -0,0 +1,193 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_MAPPEDFILE_H_
+#define SRC_MAPPEDFILE_H_
+
+#include <Exceptions.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+// A file mapped into memory, either read-only or created with a fixed size
+// for writing. The mapping is released when the object goes away.
+class MappedFile {
+    int m_nFile = -1;
+    void *m_pData = NULL;
+    size_t m_nSize = 0;
+    size_t m_nReleased = 0;
+    // a created file is written under m_sTemporaryName until Commit()
+    // renames it to m_sFileName
+    std::string m_sFileName;
+    std::string m_sTemporaryName;
+
+    static void Fail(const std::string &rWhat, const std::string &rFileName) {
+        throw npp::Exception(rWhat + " " + rFileName + ": " + strerror(errno));
+    }
+
+    void Map(int nProtection, const std::string &rFileName) {
+        if (m_nSize == 0) {
+            return;
+        }
+        m_pData = mmap(NULL, m_nSize, nProtection, MAP_SHARED, m_nFile, 0);
+        if (m_pData == MAP_FAILED) {
+            m_pData = NULL;
+            Fail("Cannot map", rFileName);
+        }
+    }
+
+ public:
+    MappedFile() {}
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // hand a mapping on, e.g. from the file type check to the decoder
+    MappedFile(MappedFile &&rOther) { *this = std::move(rOther); }
+    MappedFile &operator=(MappedFile &&rOther) {
+        if (this != &rOther) {
+            Close();
+            std::swap(m_nFile, rOther.m_nFile);
+            std::swap(m_pData, rOther.m_pData);
+            std::swap(m_nSize, rOther.m_nSize);
+            std::swap(m_nReleased, rOther.m_nReleased);
+            std::swap(m_sFileName, rOther.m_sFileName);
+            std::swap(m_sTemporaryName, rOther.m_sTemporaryName);
+        }
+        return *this;
+    }
+
+    ~MappedFile() { Close(); }
+
+    // Map an existing file for reading
+    void OpenRead(const std::string &rFileName) {
+        Close();
+        m_nFile = open(rFileName.c_str(), O_RDONLY);
+        if (m_nFile < 0) {
+            Fail("Cannot open", rFileName);
+        }
+        struct stat oStat;
+        if (fstat(m_nFile, &oStat) != 0) {
+            Fail("Cannot stat", rFileName);
+        }
+        m_nSize = oStat.st_size;
+        Map(PROT_READ, rFileName);
+        if (m_pData != NULL) {
+            // images are read front to back
+            madvise(m_pData, m_nSize, MADV_SEQUENTIAL);
+        }
+    }
+
+    // Create a file of nSize bytes and map it for writing. It is written
+    // next to rFileName under a temporary name until Commit(), so a file
+    // being replaced, which may be the input still mapped for reading,
+    // stays intact, and a failed write leaves nothing behind.
+    void Create(const std::string &rFileName, size_t nSize) {
+        Close();
+        std::string sTemporary = rFileName + ".XXXXXX";
+        m_nFile = mkstemp(&sTemporary[0]);
+        if (m_nFile < 0) {
+            Fail("Cannot create", rFileName);
+        }
+        m_sFileName = rFileName;
+        m_sTemporaryName = sTemporary;
+        if (fchmod(m_nFile, 0644) != 0 || ftruncate(m_nFile, nSize) != 0) {
+            Fail("Cannot resize", rFileName);
+        }
+        m_nSize = nSize;
+        Map(PROT_READ | PROT_WRITE, rFileName);
+    }
+
+    // Drop the pages before byte nEnd from memory once they are no longer
+    // needed. They are backed by the file, so reading them again or writing
+    // back what was stored in them still works.
+    void Release(size_t nEnd) {
+        const size_t nPage = sysconf(_SC_PAGESIZE);
+        nEnd = std::min(nEnd, m_nSize) / nPage * nPage;
+        if (m_pData != NULL && nEnd > m_nReleased) {
+            madvise(static_cast<char *>(m_pData) + m_nReleased,
+                    nEnd - m_nReleased, MADV_DONTNEED);
+            m_nReleased = nEnd;
+        }
+    }
+
+    // Close a created file and give it its name, replacing any file there
+    void Commit() {
+        const std::string sTemporary = m_sTemporaryName;
+        const std::string sFileName = m_sFileName;
+        m_sTemporaryName.clear();
+        Close();
+        if (!sTemporary.empty() &&
+            rename(sTemporary.c_str(), sFileName.c_str()) != 0) {
+            const int nError = errno;
+            unlink(sTemporary.c_str());
+            errno = nError;
+            Fail("Cannot replace", sFileName);
+        }
+    }
+
+    // Unmap and close the file; a created file that was not committed is
+    // discarded
+    void Close() {
+        if (m_pData != NULL) {
+            munmap(m_pData, m_nSize);
+            m_pData = NULL;
+        }
+        if (m_nFile >= 0) {
+            close(m_nFile);
+            m_nFile = -1;
+        }
+        if (!m_sTemporaryName.empty()) {
+            unlink(m_sTemporaryName.c_str());
+            m_sTemporaryName.clear();
+        }
+        m_sFileName.clear();
+        m_nSize = 0;
+        m_nReleased = 0;
+    }
+
+    bool isOpen() const { return m_nFile >= 0; }
+    size_t size() const { return m_nSize; }
+    unsigned char *data() { return static_cast<unsigned char *>(m_pData); }
+    const unsigned char *data() const {
+        return static_cast<const unsigned char *>(m_pData);
+    }
+};
+#endif  //  SRC_MAPPEDFILE_H_
@@ -0,0 +1,140 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_MEMORYBUDGET_H_
+#define SRC_MEMORYBUDGET_H_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+// Bounds the memory held by the images in flight: decoded images, the
+// working buffers of the filters and results waiting to be encoded. Before
+// an image is decoded its whole footprint, estimated from its header, is
+// reserved, waiting until the budget has room for it; the parts are given
+// back as they are freed. An image larger than the budget is let through
+// when nothing else is held, so it is processed alone instead of waiting
+// forever. Usage only exceeds the budget by such an image, or when a header
+// did not give the size: those images are charged once decoded, at most one
+// per decode thread.
+class MemoryBudget {
+    typedef std::chrono::steady_clock Clock;
+
+    size_t m_nMaxBytes;
+    std::mutex m_oMutex;
+    std::condition_variable m_oRoom;
+    size_t m_nHeldBytes = 0;
+    size_t m_nPeakBytes = 0;
+    // held bytes integrated over time, for the average
+    double m_dByteSeconds = 0.0;
+    Clock::time_point m_oStart;
+    Clock::time_point m_oLastChange;
+    size_t m_nWaits = 0;
+    double m_dWaitMs = 0.0;
+
+    // account for the time the held bytes stayed as they were; the caller
+    // holds the lock
+    void Advance(Clock::time_point oNow) {
+        m_dByteSeconds += static_cast<double>(m_nHeldBytes) *
+            std::chrono::duration<double>(oNow - m_oLastChange).count();
+        m_oLastChange = oNow;
+    }
+
+ public:
+    explicit MemoryBudget(size_t nMaxBytes)
+        : m_nMaxBytes(nMaxBytes), m_oStart(Clock::now()),
+          m_oLastChange(m_oStart) {}
+
+    MemoryBudget(const MemoryBudget &) = delete;
+    MemoryBudget &operator=(const MemoryBudget &) = delete;
+
+    // Wait until the budget has room for nBytes more, or nothing is held,
+    // and charge them
+    void Reserve(size_t nBytes) {
+        std::unique_lock<std::mutex> oLock(m_oMutex);
+        auto fRoom = [this, nBytes] {
+            return m_nHeldBytes == 0 ||
+                   (m_nHeldBytes <= m_nMaxBytes &&
+                    nBytes <= m_nMaxBytes - m_nHeldBytes);
+        };
+        if (!fRoom()) {
+            Clock::time_point oStart = Clock::now();
+            m_oRoom.wait(oLock, fRoom);
+            m_nWaits++;
+            m_dWaitMs += std::chrono::duration<double, std::milli>(
+                Clock::now() - oStart).count();
+        }
+        Advance(Clock::now());
+        m_nHeldBytes += nBytes;
+        m_nPeakBytes = std::max(m_nPeakBytes, m_nHeldBytes);
+    }
+
+    void Charge(size_t nBytes) {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        Advance(Clock::now());
+        m_nHeldBytes += nBytes;
+        m_nPeakBytes = std::max(m_nPeakBytes, m_nHeldBytes);
+    }
+
+    void Release(size_t nBytes) {
+        {
+            std::lock_guard<std::mutex> oLock(m_oMutex);
+            Advance(Clock::now());
+            m_nHeldBytes -= std::min(nBytes, m_nHeldBytes);
+        }
+        m_oRoom.notify_all();
+    }
+
+    // Usage since the budget was set up, as a JSON member for the summary
+    // of the processing log
+    std::string Summary() {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        Clock::time_point oNow = Clock::now();
+        Advance(oNow);
+        const double dSeconds =
+            std::chrono::duration<double>(oNow - m_oStart).count();
+        std::ostringstream oJson;
+        oJson << "\"memory\":{\"budget_bytes\":" << m_nMaxBytes
+              << ",\"peak_bytes\":" << m_nPeakBytes << ",\"average_bytes\":"
+              << static_cast<size_t>(dSeconds > 0.0
+                                         ? m_dByteSeconds / dSeconds
+                                         : 0.0)
+              << ",\"waits\":" << m_nWaits << ",\"wait_ms\":";
+        oJson.setf(std::ios::fixed);
+        oJson.precision(3);
+        oJson << m_dWaitMs << "}";
+        return oJson.str();
+    }
+};
+#endif  //  SRC_MEMORYBUDGET_H_
@@ -0,0 +1,509 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+// End-to-end benchmark of filterNPP: decode, filter, encode and log of whole
+// files, as run.sh runs it, where filterBench only times the filters. It
+// writes a synthetic corpus and times the filterNPP binary on it:
+//   single     one process per image ("-input=file"), like run.sh
+//   directory  one process for the corpus ("-input=dir/*")
+//   batch      the same with "-batch=N"
+// The corpus is the same for the same settings on every machine: each image
+// is a gradient with noise from its own std::mt19937 seed, whose sequence
+// the standard fixes, in every format ("-formats=pnm,png,jpeg,tiff,bmp", pnm
+// being PGM for grey and PPM for colour images), bit depth
+// ("-depths=8,24,32", where the format supports it), size ("-sizes=N,WxH")
+// and "-count=N" images of each. It is kept in "-corpus=dir" and rewritten
+// only when the settings change.
+// Every mode is run "-warmup" times untimed and "-reps" times timed, and the
+// fastest run counts. One JSON object per line is written, a line describing
+// the corpus, then per mode images, MB and Mpixel per second. Given the
+// output of an earlier run as "-baseline=file", each mode is compared to the
+// same mode on the same corpus and filterNPP arguments, and the benchmark
+// fails when images per second dropped by more than "-threshold=P" percent
+// (default 10), or when the baseline has no such mode to compare with.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <helper_string.h>
+
+#include "Exceptions.h"
+#include "FreeImage.h"
+#include "jobServer.h"
+
+namespace fs = std::filesystem;
+
+struct BenchSize {
+  int nWidth;
+  int nHeight;
+};
+
+// What the corpus is made of; equal settings give the same files
+struct CorpusSpec {
+  std::vector<std::string> aFormats = {"pnm", "png", "jpeg", "tiff", "bmp"};
+  std::vector<int> aDepths = {8, 24, 32};
+  std::vector<BenchSize> aSizes = {{256, 256}, {512, 512}, {1024, 768}};
+  int nCount = 4;
+  unsigned nSeed = 1;
+
+  // e.g. "pnm,png/8,24/256x256,1024x768/4/1"
+  std::string Text() const {
+    std::ostringstream oText;
+    for (size_t i = 0; i < aFormats.size(); ++i) {
+      oText << (i > 0 ? "," : "") << aFormats[i];
+    }
+    oText << "/";
+    for (size_t i = 0; i < aDepths.size(); ++i) {
+      oText << (i > 0 ? "," : "") << aDepths[i];
+    }
+    oText << "/";
+    for (size_t i = 0; i < aSizes.size(); ++i) {
+      oText << (i > 0 ? "," : "") << aSizes[i].nWidth << "x"
+            << aSizes[i].nHeight;
+    }
+    oText << "/" << nCount << "/" << nSeed;
+    return oText.str();
+  }
+};
+
+struct CorpusImage {
+  std::string sPath;
+  size_t nBytes = 0;
+  double dPixels = 0.0;
+};
+
+struct ModeResult {
+  double dSeconds = 0.0;
+  double dImagesPerS = 0.0;
+  double dMbPerS = 0.0;
+  double dMpixelPerS = 0.0;
+};
+
+const char *getArgument(int argc, char *argv[], const char *zName) {
+  char *zValue = NULL;
+  if (checkCmdLineFlag(argc, (const char **)argv, zName)) {
+    getCmdLineArgumentString(argc, (const char **)argv, zName, &zValue);
+  }
+  return zValue;
+}
+
+// Comma separated list, e.g. "-formats=png,jpeg"
+std::vector<std::string> parseList(const char *zList) {
+  std::vector<std::string> aValues;
+  std::string sList(zList);
+  size_t nStart = 0;
+  while (nStart <= sList.size()) {
+    size_t nEnd = sList.find(',', nStart);
+    if (nEnd == std::string::npos) {
+      nEnd = sList.size();
+    }
+    if (nEnd > nStart) {
+      aValues.push_back(sList.substr(nStart, nEnd - nStart));
+    }
+    nStart = nEnd + 1;
+  }
+  return aValues;
+}
+
+// "-sizes=256,1024x768": N is a square image, WxH a rectangle
+std::vector<BenchSize> parseSizeList(const char *zList) {
+  std::vector<BenchSize> aSizes;
+  for (const std::string &rSize : parseList(zList)) {
+    BenchSize oSize = {0, 0};
+    int nParsed = sscanf(rSize.c_str(), "%dx%d", &oSize.nWidth,
+                         &oSize.nHeight);
+    if (nParsed == 1) {
+      oSize.nHeight = oSize.nWidth;
+    }
+    NPP_ASSERT_MSG(nParsed >= 1 && oSize.nWidth > 0 && oSize.nHeight > 0,
+                   "Expected -sizes=N,WxH,...");
+    aSizes.push_back(oSize);
+  }
+  return aSizes;
+}
+
+// FreeImage format and file extension of a corpus format at nBitDepth;
+// FIF_UNKNOWN when the format cannot hold that depth
+std::tuple<FREE_IMAGE_FORMAT, std::string> corpusFormat(
+    const std::string &rFormat, int nBitDepth) {
+  FREE_IMAGE_FORMAT eFormat = FIF_UNKNOWN;
+  std::string sExt;
+  if (rFormat == "pnm") {
+    eFormat = nBitDepth == 8 ? FIF_PGMRAW : FIF_PPMRAW;
+    sExt = nBitDepth == 8 ? ".pgm" : ".ppm";
+  } else if (rFormat == "png") {
+    eFormat = FIF_PNG;
+    sExt = ".png";
+  } else if (rFormat == "jpeg") {
+    eFormat = FIF_JPEG;
+    sExt = ".jpg";
+  } else if (rFormat == "tiff") {
+    eFormat = FIF_TIFF;
+    sExt = ".tif";
+  } else if (rFormat == "bmp") {
+    eFormat = FIF_BMP;
+    sExt = ".bmp";
+  } else {
+    throw npp::Exception("Unknown corpus format " + rFormat);
+  }
+  if (!FreeImage_FIFSupportsExportBPP(eFormat, nBitDepth)) {
+    eFormat = FIF_UNKNOWN;
+  }
+  return {eFormat, sExt};
+}
+
+// Write one synthetic image: a diagonal gradient per channel with noise,
+// so the encoders see structure as well as detail
+void writeImage(const std::string &rPath, FREE_IMAGE_FORMAT eFormat,
+                int nBitDepth, const BenchSize &rSize, unsigned nSeed) {
+  std::mt19937 oRandom(nSeed);
+  FIBITMAP *pBitmap =
+      FreeImage_Allocate(rSize.nWidth, rSize.nHeight, nBitDepth);
+  NPP_ASSERT_NOT_NULL(pBitmap);
+  const int nChannels = nBitDepth / 8;
+  for (int y = 0; y < rSize.nHeight; ++y) {
+    BYTE *pRow = FreeImage_GetScanLine(pBitmap, y);
+    for (int x = 0; x < rSize.nWidth; ++x) {
+      for (int c = 0; c < nChannels; ++c) {
+        const unsigned nGradient =
+            (x * (c + 1) * 255 / rSize.nWidth + y * 255 / rSize.nHeight) / 2;
+        // the low bits of the generator, not a distribution, whose
+        // results differ between standard libraries
+        const unsigned nNoise = static_cast<unsigned>(oRandom() & 31);
+        pRow[x * nChannels + c] =
+            static_cast<BYTE>(std::min(nGradient + nNoise, 255u));
+      }
+    }
+  }
+  const bool bSuccess =
+      FreeImage_Save(eFormat, pBitmap, rPath.c_str(), 0) == TRUE;
+  FreeImage_Unload(pBitmap);
+  NPP_ASSERT_MSG(bSuccess, "Failed to write a corpus image");
+}
+
+// The images of the corpus in sDir/images/, written unless sDir holds the
+// corpus of the same settings already
+std::vector<CorpusImage> makeCorpus(const std::string &sDir,
+                                    const CorpusSpec &rSpec) {
+  const fs::path oSpecFile = fs::path(sDir) / "corpus.txt";
+  const fs::path oImageDir = fs::path(sDir) / "images";
+  std::string sExisting;
+  {
+    std::ifstream oFile(oSpecFile);
+    std::getline(oFile, sExisting);
+  }
+  const bool bWrite = sExisting != rSpec.Text();
+  if (bWrite) {
+    // only a directory the benchmark made is cleared
+    NPP_ASSERT_MSG(!fs::exists(sDir) || fs::is_empty(sDir) ||
+                       fs::exists(oSpecFile),
+                   "-corpus must be a new directory or an earlier corpus");
+    fs::remove_all(oImageDir);
+    fs::remove(oSpecFile);
+    fs::create_directories(oImageDir);
+  }
+
+  std::vector<CorpusImage> aImages;
+  unsigned nImage = 0;
+  for (const std::string &rFormat : rSpec.aFormats) {
+    for (int nBitDepth : rSpec.aDepths) {
+      auto [eFormat, sExt] = corpusFormat(rFormat, nBitDepth);
+      if (eFormat == FIF_UNKNOWN) {
+        continue;
+      }
+      for (const BenchSize &rSize : rSpec.aSizes) {
+        for (int i = 0; i < rSpec.nCount; ++i, ++nImage) {
+          char aName[64];
+          snprintf(aName, sizeof(aName), "img%05u_%dx%d_%d", nImage,
+                   rSize.nWidth, rSize.nHeight, nBitDepth);
+          CorpusImage oImage;
+          oImage.sPath = (oImageDir / (aName + sExt)).string();
+          if (bWrite) {
+            writeImage(oImage.sPath, eFormat, nBitDepth, rSize,
+                       rSpec.nSeed * 1000003u + nImage);
+          }
+          oImage.nBytes = fs::file_size(oImage.sPath);
+          oImage.dPixels = static_cast<double>(rSize.nWidth) * rSize.nHeight;
+          aImages.push_back(oImage);
+        }
+      }
+    }
+  }
+  if (bWrite) {
+    std::ofstream oFile(oSpecFile);
+    oFile << rSpec.Text() << "\n";
+  }
+  return aImages;
+}
+
+std::string shellQuote(const std::string &rText) {
+  std::string sQuoted = "'";
+  for (char c : rText) {
+    sQuoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+  }
+  return sQuoted + "'";
+}
+
+// Seconds taken by the commands, run one after the other; throws when one
+// of them fails
+double runCommands(const std::vector<std::string> &rCommands) {
+  auto tStart = std::chrono::steady_clock::now();
+  for (const std::string &rCommand : rCommands) {
+    if (std::system(rCommand.c_str()) != 0) {
+      throw npp::Exception("Benchmark command failed: " + rCommand);
+    }
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       tStart)
+      .count();
+}
+
+// The filterNPP command lines of a mode
+std::vector<std::string> modeCommands(const std::string &rMode,
+                                      const std::string &rFilterNPP,
+                                      const std::string &rArgs,
+                                      const std::string &rImageDir,
+                                      const std::vector<CorpusImage> &aImages,
+                                      int nBatch) {
+  const std::string sPrefix = shellQuote(rFilterNPP) + " " + rArgs + " ";
+  const std::string sQuiet = " > /dev/null";
+  std::vector<std::string> aCommands;
+  if (rMode == "single") {
+    for (const CorpusImage &rImage : aImages) {
+      aCommands.push_back(sPrefix + shellQuote("-input=" + rImage.sPath) +
+                          sQuiet);
+    }
+  } else if (rMode == "directory" || rMode == "batch") {
+    std::string sCommand = sPrefix + shellQuote("-input=" + rImageDir + "/*");
+    if (rMode == "batch") {
+      sCommand += " -batch=" + std::to_string(nBatch);
+    }
+    aCommands.push_back(sCommand + sQuiet);
+  } else {
+    throw npp::Exception("Unknown benchmark mode " + rMode);
+  }
+  return aCommands;
+}
+
+// The records of an earlier run, by mode, corpus and arguments
+std::map<std::string, JobFields> readBaseline(const std::string &rPath) {
+  std::ifstream oFile(rPath);
+  NPP_ASSERT_MSG(oFile.is_open(), "Cannot open the baseline");
+  std::map<std::string, JobFields> aBaseline;
+  std::string sLine;
+  while (std::getline(oFile, sLine)) {
+    if (sLine.empty()) {
+      continue;
+    }
+    JobFields aFields = ParseJobLine(sLine);
+    if (aFields.count("mode") > 0) {
+      aBaseline[aFields["mode"] + "|" + aFields["corpus"] + "|" +
+                aFields["args"]] = aFields;
+    }
+  }
+  return aBaseline;
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    CorpusSpec oSpec;
+    std::string sCorpus = "pipelineBenchCorpus";
+    std::vector<std::string> aModes = {"single", "directory", "batch"};
+    std::string sFilterNPP =
+        (fs::path(argv[0]).parent_path() / "filterNPP").string();
+    std::string sArgs;
+    int nBatch = 16;
+    int nWarmup = 1;
+    int nReps = 3;
+    double dThreshold = 10.0;
+
+    const char *zValue;
+    if ((zValue = getArgument(argc, argv, "formats")) != NULL) {
+      oSpec.aFormats = parseList(zValue);
+    }
+    if ((zValue = getArgument(argc, argv, "depths")) != NULL) {
+      oSpec.aDepths.clear();
+      for (const std::string &rDepth : parseList(zValue)) {
+        oSpec.aDepths.push_back(atoi(rDepth.c_str()));
+      }
+    }
+    if ((zValue = getArgument(argc, argv, "sizes")) != NULL) {
+      oSpec.aSizes = parseSizeList(zValue);
+    }
+    if ((zValue = getArgument(argc, argv, "count")) != NULL) {
+      oSpec.nCount = std::max(atoi(zValue), 1);
+    }
+    if ((zValue = getArgument(argc, argv, "seed")) != NULL) {
+      oSpec.nSeed = static_cast<unsigned>(strtoul(zValue, NULL, 10));
+    }
+    if ((zValue = getArgument(argc, argv, "corpus")) != NULL) {
+      sCorpus = zValue;
+    }
+    if ((zValue = getArgument(argc, argv, "modes")) != NULL) {
+      aModes = parseList(zValue);
+    }
+    if ((zValue = getArgument(argc, argv, "filterNPP")) != NULL) {
+      sFilterNPP = zValue;
+    }
+    // passed on to filterNPP, e.g. -args="-backend=cpu -filter=2"
+    if ((zValue = getArgument(argc, argv, "args")) != NULL) {
+      sArgs = zValue;
+    }
+    if ((zValue = getArgument(argc, argv, "batch")) != NULL) {
+      nBatch = std::max(atoi(zValue), 1);
+    }
+    if ((zValue = getArgument(argc, argv, "warmup")) != NULL) {
+      nWarmup = std::max(atoi(zValue), 0);
+    }
+    if ((zValue = getArgument(argc, argv, "reps")) != NULL) {
+      nReps = std::max(atoi(zValue), 1);
+    }
+    if ((zValue = getArgument(argc, argv, "threshold")) != NULL) {
+      dThreshold = atof(zValue);
+    }
+    std::map<std::string, JobFields> aBaseline;
+    const bool bBaseline =
+        (zValue = getArgument(argc, argv, "baseline")) != NULL;
+    if (bBaseline) {
+      aBaseline = readBaseline(zValue);
+    }
+    FILE *pOutput = stdout;
+    if ((zValue = getArgument(argc, argv, "output")) != NULL) {
+      pOutput = fopen(zValue, "w");
+      NPP_ASSERT_MSG(pOutput != NULL, "Cannot open the benchmark output");
+    }
+
+    std::vector<CorpusImage> aImages = makeCorpus(sCorpus, oSpec);
+    NPP_ASSERT_MSG(!aImages.empty(), "The corpus has no images");
+    const std::string sImageDir = (fs::path(sCorpus) / "images").string();
+    size_t nBytes = 0;
+    double dPixels = 0.0;
+    for (const CorpusImage &rImage : aImages) {
+      nBytes += rImage.nBytes;
+      dPixels += rImage.dPixels;
+    }
+    const std::string sCorpusText = oSpec.Text();
+    fprintf(pOutput,
+            "{\"benchmark\":\"pipelineBench\",\"corpus\":%s,\"images\":%zu,"
+            "\"bytes\":%zu,\"args\":%s,\"batch\":%d,\"warmup\":%d,"
+            "\"reps\":%d}\n",
+            JsonString(sCorpusText).c_str(), aImages.size(), nBytes,
+            JsonString(sArgs).c_str(), nBatch, nWarmup, nReps);
+    fflush(pOutput);
+
+    int nRegressed = 0;
+    int nUnmatched = 0;
+    for (const std::string &rMode : aModes) {
+      std::vector<std::string> aCommands = modeCommands(
+          rMode, sFilterNPP, sArgs, sImageDir, aImages, nBatch);
+      for (int i = 0; i < nWarmup; ++i) {
+        runCommands(aCommands);
+      }
+      double dBest = 0.0;
+      for (int i = 0; i < nReps; ++i) {
+        const double dSeconds = runCommands(aCommands);
+        dBest = i == 0 ? dSeconds : std::min(dBest, dSeconds);
+      }
+      ModeResult oResult;
+      oResult.dSeconds = dBest;
+      oResult.dImagesPerS = aImages.size() / dBest;
+      oResult.dMbPerS = nBytes / dBest / (1 << 20);
+      oResult.dMpixelPerS = dPixels / dBest / 1e6;
+
+      fprintf(pOutput,
+              "{\"mode\":\"%s\",\"corpus\":%s,\"args\":%s,\"seconds\":%.4f,"
+              "\"images_per_s\":%.3f,\"mb_per_s\":%.3f,"
+              "\"mpixel_per_s\":%.3f",
+              rMode.c_str(), JsonString(sCorpusText).c_str(),
+              JsonString(sArgs).c_str(), oResult.dSeconds,
+              oResult.dImagesPerS, oResult.dMbPerS, oResult.dMpixelPerS);
+      auto itBaseline =
+          aBaseline.find(rMode + "|" + sCorpusText + "|" + sArgs);
+      if (itBaseline != aBaseline.end()) {
+        const double dBaseline =
+            atof(itBaseline->second["images_per_s"].c_str());
+        const double dChange =
+            dBaseline > 0.0
+                ? 100.0 * (oResult.dImagesPerS - dBaseline) / dBaseline
+                : 0.0;
+        const bool bRegressed = dChange < -dThreshold;
+        nRegressed += bRegressed ? 1 : 0;
+        fprintf(pOutput,
+                ",\"baseline_images_per_s\":%.3f,\"change_pct\":%.1f,"
+                "\"regressed\":%s",
+                dBaseline, dChange, bRegressed ? "true" : "false");
+      } else if (bBaseline) {
+        // a changed corpus or -args must not turn the comparison off
+        std::cerr << "The baseline has no " << rMode << " run with the corpus "
+                  << sCorpusText << " and the arguments \"" << sArgs << "\""
+                  << std::endl;
+        nUnmatched++;
+      }
+      fprintf(pOutput, "}\n");
+      fflush(pOutput);
+    }
+    if (pOutput != stdout) {
+      fclose(pOutput);
+    }
+    if (nRegressed > 0) {
+      std::cerr << nRegressed << " of " << aModes.size()
+                << " modes lost more than " << dThreshold
+                << "% of their throughput" << std::endl;
+    }
+    if (nUnmatched > 0) {
+      std::cerr << nUnmatched << " of " << aModes.size()
+                << " modes could not be compared with the baseline"
+                << std::endl;
+    }
+    if (nRegressed > 0 || nUnmatched > 0) {
+      exit(EXIT_FAILURE);
+    }
+  }
+  catch (npp::Exception &rException) {
+    std::cerr << "Program error! The following exception occurred: \n";
+    std::cerr << rException << std::endl;
+    std::cerr << "Aborting." << std::endl;
+
+    exit(EXIT_FAILURE);
+  }
+  return 0;
+}
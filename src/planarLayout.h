@@ -0,0 +1,298 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_PLANARLAYOUT_H_
+#define SRC_PLANARLAYOUT_H_
+
+#include <npp.h>
+
+#include <cstddef>
+
+#include "cpuFeatures.h"
+
+// Conversion of interleaved C3 and C4 rows to one plane per channel and back,
+// so colour images can be filtered as separate C1 images. apPlanes[c] points
+// at the top row of the plane of channel c; all planes share one step.
+namespace cpu {
+
+template <int kChannels>
+inline void DeinterleaveRowScalar(const Npp8u *pSrc, int nBegin, int nEnd,
+                                  Npp8u *const *apPlanes, ptrdiff_t nOffset) {
+    for (int x = nBegin; x < nEnd; ++x) {
+        for (int c = 0; c < kChannels; ++c) {
+            apPlanes[c][nOffset + x] = pSrc[x * kChannels + c];
+        }
+    }
+}
+
+template <int kChannels>
+inline void InterleaveRowScalar(const Npp8u *const *apPlanes,
+                                ptrdiff_t nOffset, int nBegin, int nEnd,
+                                Npp8u *pDst) {
+    for (int x = nBegin; x < nEnd; ++x) {
+        for (int c = 0; c < kChannels; ++c) {
+            pDst[x * kChannels + c] = apPlanes[c][nOffset + x];
+        }
+    }
+}
+
+#ifdef FILTER_CPU_X86
+// Byte shuffles moving 16 C3 pixels between three interleaved vectors and the
+// three planes: aSplit[v][c] gathers the bytes of channel c found in vector v,
+// aMerge[v][c] places the bytes of plane c that belong in vector v. Unused
+// positions hold 0x80, which pshufb turns into 0.
+struct C3Shuffles {
+    alignas(16) Npp8u aSplit[3][3][16];
+    alignas(16) Npp8u aMerge[3][3][16];
+
+    C3Shuffles() {
+        for (int v = 0; v < 3; ++v) {
+            for (int c = 0; c < 3; ++c) {
+                for (int i = 0; i < 16; ++i) {
+                    const int nSrc = 3 * i + c;
+                    aSplit[v][c][i] = nSrc / 16 == v ? nSrc % 16 : 0x80;
+                    const int nDst = 16 * v + i;
+                    aMerge[v][c][i] = nDst % 3 == c ? nDst / 3 : 0x80;
+                }
+            }
+        }
+    }
+};
+
+inline const C3Shuffles &C3ShuffleTable() {
+    static const C3Shuffles oTable;
+    return oTable;
+}
+
+// pshufb is SSSE3, which every AVX2 processor has
+FILTER_TARGET_AVX2 inline void DeinterleaveRowC3AVX2(const Npp8u *pSrc,
+                                                     int nWidth,
+                                                     Npp8u *const *apPlanes,
+                                                     ptrdiff_t nOffset) {
+    const C3Shuffles &rTable = C3ShuffleTable();
+    __m128i vSplit[3][3];
+    for (int v = 0; v < 3; ++v) {
+        for (int c = 0; c < 3; ++c) {
+            vSplit[v][c] = _mm_load_si128(
+                reinterpret_cast<const __m128i *>(rTable.aSplit[v][c]));
+        }
+    }
+    int x = 0;
+    for (; x + 16 <= nWidth; x += 16) {
+        const __m128i *pIn = reinterpret_cast<const __m128i *>(pSrc + 3 * x);
+        const __m128i vIn[3] = {_mm_loadu_si128(pIn), _mm_loadu_si128(pIn + 1),
+                                _mm_loadu_si128(pIn + 2)};
+        for (int c = 0; c < 3; ++c) {
+            const __m128i vPlane = _mm_or_si128(
+                _mm_or_si128(_mm_shuffle_epi8(vIn[0], vSplit[0][c]),
+                             _mm_shuffle_epi8(vIn[1], vSplit[1][c])),
+                _mm_shuffle_epi8(vIn[2], vSplit[2][c]));
+            _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(apPlanes[c] + nOffset + x),
+                vPlane);
+        }
+    }
+    DeinterleaveRowScalar<3>(pSrc, x, nWidth, apPlanes, nOffset);
+}
+
+FILTER_TARGET_AVX2 inline void InterleaveRowC3AVX2(
+        const Npp8u *const *apPlanes, ptrdiff_t nOffset, int nWidth,
+        Npp8u *pDst) {
+    const C3Shuffles &rTable = C3ShuffleTable();
+    __m128i vMerge[3][3];
+    for (int v = 0; v < 3; ++v) {
+        for (int c = 0; c < 3; ++c) {
+            vMerge[v][c] = _mm_load_si128(
+                reinterpret_cast<const __m128i *>(rTable.aMerge[v][c]));
+        }
+    }
+    int x = 0;
+    for (; x + 16 <= nWidth; x += 16) {
+        __m128i vPlane[3];
+        for (int c = 0; c < 3; ++c) {
+            vPlane[c] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(
+                apPlanes[c] + nOffset + x));
+        }
+        __m128i *pOut = reinterpret_cast<__m128i *>(pDst + 3 * x);
+        for (int v = 0; v < 3; ++v) {
+            _mm_storeu_si128(
+                pOut + v,
+                _mm_or_si128(
+                    _mm_or_si128(_mm_shuffle_epi8(vPlane[0], vMerge[v][0]),
+                                 _mm_shuffle_epi8(vPlane[1], vMerge[v][1])),
+                    _mm_shuffle_epi8(vPlane[2], vMerge[v][2])));
+        }
+    }
+    InterleaveRowScalar<3>(apPlanes, nOffset, x, nWidth, pDst);
+}
+
+// C4 needs no byte shuffle: the channels of a pixel are the bytes of a 32-bit
+// lane, taken apart with shifts and packs and put together with unpacks
+FILTER_TARGET_SSE2 inline void DeinterleaveRowC4SSE2(const Npp8u *pSrc,
+                                                     int nWidth,
+                                                     Npp8u *const *apPlanes,
+                                                     ptrdiff_t nOffset) {
+    const __m128i vLow = _mm_set1_epi32(0xFF);
+    int x = 0;
+    for (; x + 16 <= nWidth; x += 16) {
+        const __m128i *pIn = reinterpret_cast<const __m128i *>(pSrc + 4 * x);
+        __m128i vIn[4];
+        for (int v = 0; v < 4; ++v) {
+            vIn[v] = _mm_loadu_si128(pIn + v);
+        }
+        for (int c = 0; c < 4; ++c) {
+            __m128i vLanes[4];
+            for (int v = 0; v < 4; ++v) {
+                vLanes[v] = _mm_and_si128(_mm_srli_epi32(vIn[v], 8 * c), vLow);
+            }
+            const __m128i vPlane = _mm_packus_epi16(
+                _mm_packs_epi32(vLanes[0], vLanes[1]),
+                _mm_packs_epi32(vLanes[2], vLanes[3]));
+            _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(apPlanes[c] + nOffset + x),
+                vPlane);
+        }
+    }
+    DeinterleaveRowScalar<4>(pSrc, x, nWidth, apPlanes, nOffset);
+}
+
+// The same with a byte shuffle grouping the channels of four pixels into
+// 32-bit lanes, followed by a 4x4 transpose of those lanes
+FILTER_TARGET_AVX2 inline void DeinterleaveRowC4AVX2(const Npp8u *pSrc,
+                                                     int nWidth,
+                                                     Npp8u *const *apPlanes,
+                                                     ptrdiff_t nOffset) {
+    const __m128i vGroup = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10,
+                                         14, 3, 7, 11, 15);
+    int x = 0;
+    for (; x + 16 <= nWidth; x += 16) {
+        const __m128i *pIn = reinterpret_cast<const __m128i *>(pSrc + 4 * x);
+        __m128i vIn[4];
+        for (int v = 0; v < 4; ++v) {
+            vIn[v] = _mm_shuffle_epi8(_mm_loadu_si128(pIn + v), vGroup);
+        }
+        const __m128i vLow01 = _mm_unpacklo_epi32(vIn[0], vIn[1]);
+        const __m128i vHigh01 = _mm_unpackhi_epi32(vIn[0], vIn[1]);
+        const __m128i vLow23 = _mm_unpacklo_epi32(vIn[2], vIn[3]);
+        const __m128i vHigh23 = _mm_unpackhi_epi32(vIn[2], vIn[3]);
+        const __m128i vPlane[4] = {_mm_unpacklo_epi64(vLow01, vLow23),
+                                   _mm_unpackhi_epi64(vLow01, vLow23),
+                                   _mm_unpacklo_epi64(vHigh01, vHigh23),
+                                   _mm_unpackhi_epi64(vHigh01, vHigh23)};
+        for (int c = 0; c < 4; ++c) {
+            _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(apPlanes[c] + nOffset + x),
+                vPlane[c]);
+        }
+    }
+    DeinterleaveRowScalar<4>(pSrc, x, nWidth, apPlanes, nOffset);
+}
+
+FILTER_TARGET_SSE2 inline void InterleaveRowC4SSE2(
+        const Npp8u *const *apPlanes, ptrdiff_t nOffset, int nWidth,
+        Npp8u *pDst) {
+    int x = 0;
+    for (; x + 16 <= nWidth; x += 16) {
+        __m128i vPlane[4];
+        for (int c = 0; c < 4; ++c) {
+            vPlane[c] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(
+                apPlanes[c] + nOffset + x));
+        }
+        const __m128i vLow01 = _mm_unpacklo_epi8(vPlane[0], vPlane[1]);
+        const __m128i vHigh01 = _mm_unpackhi_epi8(vPlane[0], vPlane[1]);
+        const __m128i vLow23 = _mm_unpacklo_epi8(vPlane[2], vPlane[3]);
+        const __m128i vHigh23 = _mm_unpackhi_epi8(vPlane[2], vPlane[3]);
+        __m128i *pOut = reinterpret_cast<__m128i *>(pDst + 4 * x);
+        _mm_storeu_si128(pOut, _mm_unpacklo_epi16(vLow01, vLow23));
+        _mm_storeu_si128(pOut + 1, _mm_unpackhi_epi16(vLow01, vLow23));
+        _mm_storeu_si128(pOut + 2, _mm_unpacklo_epi16(vHigh01, vHigh23));
+        _mm_storeu_si128(pOut + 3, _mm_unpackhi_epi16(vHigh01, vHigh23));
+    }
+    InterleaveRowScalar<4>(apPlanes, nOffset, x, nWidth, pDst);
+}
+#endif  // FILTER_CPU_X86
+
+// Split nHeight rows of nWidth interleaved pixels into nChannels planes
+inline void DeinterleaveRows(const Npp8u *pSrc, Npp32s nSrcStep, int nWidth,
+                             int nHeight, int nChannels,
+                             Npp8u *const *apPlanes, Npp32s nPlaneStep,
+                             enumCpuIsa eIsa) {
+    for (int y = 0; y < nHeight; ++y) {
+        const Npp8u *pRow = pSrc + static_cast<ptrdiff_t>(y) * nSrcStep;
+        const ptrdiff_t nOffset = static_cast<ptrdiff_t>(y) * nPlaneStep;
+#ifdef FILTER_CPU_X86
+        if (nChannels == 3 && eIsa >= CpuIsa_AVX2) {
+            DeinterleaveRowC3AVX2(pRow, nWidth, apPlanes, nOffset);
+            continue;
+        }
+        if (nChannels == 4 && eIsa >= CpuIsa_AVX2) {
+            DeinterleaveRowC4AVX2(pRow, nWidth, apPlanes, nOffset);
+            continue;
+        }
+        if (nChannels == 4 && eIsa >= CpuIsa_SSE2) {
+            DeinterleaveRowC4SSE2(pRow, nWidth, apPlanes, nOffset);
+            continue;
+        }
+#endif
+        if (nChannels == 3) {
+            DeinterleaveRowScalar<3>(pRow, 0, nWidth, apPlanes, nOffset);
+        } else {
+            DeinterleaveRowScalar<4>(pRow, 0, nWidth, apPlanes, nOffset);
+        }
+    }
+}
+
+// Merge nChannels planes into nHeight rows of nWidth interleaved pixels
+inline void InterleaveRows(const Npp8u *const *apPlanes, Npp32s nPlaneStep,
+                           int nWidth, int nHeight, int nChannels,
+                           Npp8u *pDst, Npp32s nDstStep, enumCpuIsa eIsa) {
+    for (int y = 0; y < nHeight; ++y) {
+        Npp8u *pRow = pDst + static_cast<ptrdiff_t>(y) * nDstStep;
+        const ptrdiff_t nOffset = static_cast<ptrdiff_t>(y) * nPlaneStep;
+#ifdef FILTER_CPU_X86
+        if (nChannels == 3 && eIsa >= CpuIsa_AVX2) {
+            InterleaveRowC3AVX2(apPlanes, nOffset, nWidth, pRow);
+            continue;
+        }
+        if (nChannels == 4 && eIsa >= CpuIsa_SSE2) {
+            InterleaveRowC4SSE2(apPlanes, nOffset, nWidth, pRow);
+            continue;
+        }
+#endif
+        if (nChannels == 3) {
+            InterleaveRowScalar<3>(apPlanes, nOffset, 0, nWidth, pRow);
+        } else {
+            InterleaveRowScalar<4>(apPlanes, nOffset, 0, nWidth, pRow);
+        }
+    }
+}
+}  // namespace cpu
+#endif  //  SRC_PLANARLAYOUT_H_
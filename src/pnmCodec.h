@@ -0,0 +1,189 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_PNMCODEC_H_
+#define SRC_PNMCODEC_H_
+
+#include <Exceptions.h>
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "imageView.h"
+#include "mappedFile.h"
+
+namespace npp {
+
+// Binary netpbm images with 8-bit samples, P5 (gray) and P6 (RGB), read and
+// written through memory-mapped files. Their payload already is a top-down
+// interleaved image, so there is nothing to decode.
+class PnmImage {
+    MappedFile m_oFile;
+    ImageView m_oView;
+
+    // Parse the unsigned decimal at *pnPos, skipping white space and
+    // comments in front of it
+    static bool ReadHeaderNumber(const unsigned char *pData, size_t nSize,
+                                 size_t *pnPos, int *pnValue) {
+        size_t nPos = *pnPos;
+        while (nPos < nSize && (isspace(pData[nPos]) || pData[nPos] == '#')) {
+            if (pData[nPos] == '#') {
+                while (nPos < nSize && pData[nPos] != '\n') {
+                    ++nPos;
+                }
+            } else {
+                ++nPos;
+            }
+        }
+        if (nPos == nSize || !isdigit(pData[nPos])) {
+            return false;
+        }
+        long nValue = 0;
+        while (nPos < nSize && isdigit(pData[nPos]) && nValue <= 0xFFFFFF) {
+            nValue = nValue * 10 + (pData[nPos++] - '0');
+        }
+        *pnPos = nPos;
+        *pnValue = static_cast<int>(nValue);
+        return nValue <= 0xFFFFFF;
+    }
+
+ public:
+    // True for the file names the native codec is tried on
+    static bool IsPnmFileName(const std::string &rFileName) {
+        std::string::size_type nDot = rFileName.find_last_of('.');
+        if (nDot == std::string::npos) {
+            return false;
+        }
+        std::string sExt = rFileName.substr(nDot + 1);
+        std::transform(sExt.begin(), sExt.end(), sExt.begin(), ::tolower);
+        return sExt == "pgm" || sExt == "ppm" || sExt == "pnm";
+    }
+
+    // Read the header of a P5 or P6 image with a maximum value of 255 from
+    // the nSize bytes at pData; *pnPos receives the offset of the samples.
+    // Returns false for anything else, e.g. ASCII or 16-bit netpbm files.
+    static bool ReadHeader(const unsigned char *pData, size_t nSize,
+                           int *pnWidth, int *pnHeight, int *pnChannels,
+                           size_t *pnPos) {
+        if (nSize < 2 || pData[0] != 'P' ||
+            (pData[1] != '5' && pData[1] != '6')) {
+            return false;
+        }
+        int nMaxValue = 0;
+        size_t nPos = 2;
+        if (!ReadHeaderNumber(pData, nSize, &nPos, pnWidth) ||
+            !ReadHeaderNumber(pData, nSize, &nPos, pnHeight) ||
+            !ReadHeaderNumber(pData, nSize, &nPos, &nMaxValue) ||
+            nMaxValue != 255 || *pnWidth == 0 || *pnHeight == 0 ||
+            nPos == nSize || !isspace(pData[nPos])) {
+            return false;
+        }
+        // a single white space character separates the header from the
+        // samples
+        *pnPos = nPos + 1;
+        *pnChannels = pData[1] == '5' ? 1 : 3;
+        return true;
+    }
+
+    // Check that the mapped file rFileName holds an image ReadHeader()
+    // accepts and take the mapping over. Returns false for anything else,
+    // which stays mapped in *pFile for FreeImage.
+    bool Open(MappedFile *pFile, const std::string &rFileName) {
+        Close();
+        const unsigned char *pData = pFile->data();
+        const size_t nSize = pFile->size();
+        int nWidth = 0, nHeight = 0, nChannels = 0;
+        size_t nPos = 0;
+        if (!ReadHeader(pData, nSize, &nWidth, &nHeight, &nChannels, &nPos)) {
+            return false;
+        }
+        const size_t nPitch = static_cast<size_t>(nWidth) * nChannels;
+        if (nSize - nPos < nPitch * nHeight) {
+            throw npp::Exception("Truncated netpbm image " + rFileName);
+        }
+        m_oFile = std::move(*pFile);
+        // the mapping is read-only; the view is only handed out as a source
+        m_oView.pData = const_cast<Npp8u *>(pData + nPos);
+        m_oView.nPitch = static_cast<Npp32s>(nPitch);
+        m_oView.nWidth = nWidth;
+        m_oView.nHeight = nHeight;
+        m_oView.nChannels = nChannels;
+        return true;
+    }
+
+    // Create rFileName at its final size and map it, so the filters write
+    // the samples straight into the file; Commit() puts it in place
+    void Create(const std::string &rFileName, int nWidth, int nHeight,
+                int nChannels) {
+        NPP_ASSERT_MSG(nChannels == 1 || nChannels == 3,
+                       "netpbm images have 1 or 3 channels");
+        Close();
+        const std::string sHeader = std::string(nChannels == 1 ? "P5" : "P6")
+                                    + "\n" + std::to_string(nWidth) + " " +
+                                    std::to_string(nHeight) + "\n255\n";
+        const size_t nPitch = static_cast<size_t>(nWidth) * nChannels;
+        m_oFile.Create(rFileName, sHeader.size() + nPitch * nHeight);
+        memcpy(m_oFile.data(), sHeader.data(), sHeader.size());
+        m_oView.pData = m_oFile.data() + sHeader.size();
+        m_oView.nPitch = static_cast<Npp32s>(nPitch);
+        m_oView.nWidth = nWidth;
+        m_oView.nHeight = nHeight;
+        m_oView.nChannels = nChannels;
+    }
+
+    // Strip processing is done with the rows above nRow
+    void ReleaseRows(int nRow) {
+        if (isOpen()) {
+            m_oFile.Release(m_oView.pData - m_oFile.data() +
+                            static_cast<size_t>(nRow) * m_oView.nPitch);
+        }
+    }
+
+    // Finish a created image, replacing any file of its name
+    void Commit() {
+        m_oView = ImageView();
+        m_oFile.Commit();
+    }
+
+    void Close() {
+        m_oFile.Close();
+        m_oView = ImageView();
+    }
+
+    bool isOpen() const { return m_oView.pData != NULL; }
+    const ImageView &view() const { return m_oView; }
+};
+
+}  // namespace npp
+#endif  //  SRC_PNMCODEC_H_
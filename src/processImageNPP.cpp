@@ -29,142 +29,314 @@
  */
 
 #include "processImageNPP.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
 #include <string>
+#include <type_traits>
 
 
-void NppProcessImage::ProcessC1Image(npp::NppRetrieveImage *pImageSetter,
-                             std::string sResultFilename, int nBitDepth) {
-    npp::ImageCPU_8u_C1 oHostSrc;
-    // load gray-scale image from disk
-    pImageSetter->loadImage(&oHostSrc, nBitDepth);
-    npp::ImageNPP_8u_C1 oDeviceSrc(oHostSrc);
-    NppiSize oSrcSize = {static_cast<int>(oDeviceSrc.width()),
-                        static_cast<int>(oDeviceSrc.height())};
-    // create struct with ROI size
-    NppiSize oSizeROI = {static_cast<int>(oDeviceSrc.width()),
-                        static_cast<int>(oDeviceSrc.height())};
+void NppProcessImage::RunFilter(const Npp8u *pSrc, Npp32s nSrcStep,
+                                NppiSize oSrcSize, Npp8u *pDst,
+                                Npp32s nDstStep, NppiSize oSizeROI,
+                                int nChannels) {
+    RunFilterAt(pSrc, nSrcStep, oSrcSize, oSrcOffset, pDst, nDstStep,
+                oSizeROI, nChannels);
+}
 
-    // allocate device image of appropriately reduced size
-    npp::ImageNPP_8u_C1 oDeviceDst(oSizeROI.width, oSizeROI.height);
-    if (nFilterType == FilterType_FilterBoxBorder) {
-        // run box filter
-        NPP_CHECK_NPP(nppiFilterBoxBorder_8u_C1R(
-            oDeviceSrc.data(), oDeviceSrc.pitch(), oSrcSize, oSrcOffset,
-            oDeviceDst.data(), oDeviceDst.pitch(), oSizeROI, oMaskSize, oAnchor,
-            NPP_BORDER_REPLICATE));
-    } else if (nFilterType == FilterType_FilterGaussBorder) {
-        Npp32s nSrcStep = oDeviceSrc.pitch();
-        Npp32s nDstStep = oDeviceDst.pitch();
+FilterStep NppProcessImage::CurrentStep() const {
+    FilterStep oStep = {nFilterType, oMaskSize, oAnchor, oGaussMaskSize};
+    return oStep;
+}
+
+void NppProcessImage::RunFilterAt(const Npp8u *pSrc, Npp32s nSrcStep,
+                                  NppiSize oSrcSize, NppiPoint oOffset,
+                                  Npp8u *pDst, Npp32s nDstStep,
+                                  NppiSize oSizeROI, int nChannels) {
+    RunStepAt(CurrentStep(), pSrc, nSrcStep, oSrcSize, oOffset, pDst,
+              nDstStep, oSizeROI, nChannels);
+}
 
+void NppProcessImage::RunStepAt(const FilterStep &rStep, const Npp8u *pSrc,
+                                Npp32s nSrcStep, NppiSize oSrcSize,
+                                NppiPoint oOffset, Npp8u *pDst,
+                                Npp32s nDstStep, NppiSize oSizeROI,
+                                int nChannels) {
+    if (!pBackend) {
+        pBackend = std::make_shared<NppFilterBackend>();
+    }
+    if (rStep.nFilterType == FilterType_FilterBoxBorder) {
+        // run box filter
+        pBackend->FilterBoxBorder(pSrc, nSrcStep, oSrcSize, oOffset,
+                                  pDst, nDstStep, oSizeROI, rStep.oMaskSize,
+                                  rStep.oAnchor, nChannels, pTimings);
+    } else if (rStep.nFilterType == FilterType_FilterGaussBorder) {
         // run gauss border filter
-        NPP_CHECK_NPP(nppiFilterGaussBorder_8u_C1R(
-            oDeviceSrc.data(), nSrcStep, oSrcSize, oSrcOffset,
-            oDeviceDst.data(), nDstStep, oSizeROI, oGaussMaskSize,
-            NPP_BORDER_REPLICATE));
+        pBackend->FilterGaussBorder(pSrc, nSrcStep, oSrcSize, oOffset,
+                                    pDst, nDstStep, oSizeROI,
+                                    rStep.oGaussMaskSize, nChannels,
+                                    pTimings);
     }
+}
 
-    // declare a host image for the result
-    npp::ImageCPU_8u_C1 oHostDst(oDeviceDst.size());
-    // and copy the device result data into it
-    oDeviceDst.copyTo(oHostDst.data(), oHostDst.pitch());
-    // save host image to result file
-    pImageSetter->saveImage(sResultFilename, oHostDst.data(),
-                    oHostDst.pitch(), oHostDst.height(), oHostDst.width());
-    // std::cout << "Saved image: " << sResultFilename << std::endl;
+// Rows of the mask above and below the row being filtered
+void NppProcessImage::StepHalo(const FilterStep &rStep, int *pnAbove,
+                               int *pnBelow) {
+    *pnAbove = rStep.oAnchor.y;
+    *pnBelow = rStep.oMaskSize.height - 1 - rStep.oAnchor.y;
+    if (rStep.nFilterType == FilterType_FilterGaussBorder) {
+        *pnAbove = *pnBelow =
+            cpu::GaussMaskDims(rStep.oGaussMaskSize).height / 2;
+    }
+}
 
-    cudaDeviceSynchronize();
+// Source rows [*pnBegin, *pnEnd) read by the result rows [nRowBegin, nRowEnd)
+// of a filter with the given vertical offset, clamped to the image. Rows
+// outside the image are replicated from its edge rows, which the clamped
+// range keeps.
+void NppProcessImage::StepRows(const FilterStep &rStep, int nRowBegin,
+                               int nRowEnd, int nOffsetY, int nHeight,
+                               int *pnBegin, int *pnEnd) {
+    int nAbove = 0, nBelow = 0;
+    StepHalo(rStep, &nAbove, &nBelow);
+    const int nBegin = nRowBegin + nOffsetY - nAbove;
+    const int nEnd = nRowEnd + nOffsetY + nBelow;
+    *pnBegin = std::min(std::max(nBegin, 0), nHeight - 1);
+    *pnEnd = std::max(std::min(nEnd, nHeight), *pnBegin + 1);
+}
 
-    nppiFree(oDeviceSrc.data());
-    nppiFree(oDeviceDst.data());
+void NppProcessImage::SourceRows(int nRowBegin, int nRowEnd, int nHeight,
+                                 int *pnBegin, int *pnEnd) const {
+    StepRows(CurrentStep(), nRowBegin, nRowEnd, oSrcOffset.y, nHeight,
+             pnBegin, pnEnd);
 }
 
-void NppProcessImage::ProcessC2Image(npp::NppRetrieveImage *pImageSetter,
-                             std::string sResultFilename, int nBitDepth) {
-    // Not implemented
+void NppProcessImage::FilterImage(npp::NppRetrieveImage *pImageSetter,
+                                  const npp::ImageView &rSrc,
+                                  const npp::ImageView &rDst) {
+    if (!aChain.empty()) {
+        FilterChain(pImageSetter, rSrc, rDst);
+        return;
+    }
+    if (nTileRows <= 0 || nTileRows >= rDst.nHeight) {
+        NppiSize oSrcSize = {rSrc.nWidth, rSrc.nHeight};
+        NppiSize oSizeROI = {rDst.nWidth, rDst.nHeight};
+        RunFilter(rSrc.pData, rSrc.nPitch, oSrcSize, rDst.pData, rDst.nPitch,
+                  oSizeROI, rSrc.nChannels);
+        return;
+    }
+
+    // Every strip is filtered from its own source rows plus the halo of the
+    // mask, as if they were the whole image shifted by the strip position.
+    // Borders are only replicated where the strip reaches the image edge,
+    // so the result is the same as filtering the image in one piece.
+    for (int nRow = 0; nRow < rDst.nHeight; nRow += nTileRows) {
+        const int nRowEnd = std::min(nRow + nTileRows, rDst.nHeight);
+        int nSrcBegin = 0, nSrcEnd = 0;
+        SourceRows(nRow, nRowEnd, rSrc.nHeight, &nSrcBegin, &nSrcEnd);
+
+        NppiSize oStripSrcSize = {rSrc.nWidth, nSrcEnd - nSrcBegin};
+        NppiPoint oStripOffset = {oSrcOffset.x,
+                                  oSrcOffset.y + nRow - nSrcBegin};
+        NppiSize oStripROI = {rDst.nWidth, nRowEnd - nRow};
+        RunFilterAt(rSrc.pData + static_cast<ptrdiff_t>(nSrcBegin) *
+                                     rSrc.nPitch,
+                    rSrc.nPitch, oStripSrcSize, oStripOffset,
+                    rDst.pData + static_cast<ptrdiff_t>(nRow) * rDst.nPitch,
+                    rDst.nPitch, oStripROI, rSrc.nChannels);
+
+        // the rows above the halo of the next strip are not read again
+        int nNextSrcBegin = nSrcBegin;
+        if (nRowEnd < rDst.nHeight) {
+            SourceRows(nRowEnd, rDst.nHeight, rSrc.nHeight, &nNextSrcBegin,
+                       &nSrcEnd);
+        }
+        if (pImageSetter != NULL) {
+            pImageSetter->releaseRows(nNextSrcBegin, nRowEnd);
+        }
+    }
 }
 
-void NppProcessImage::ProcessC3Image(npp::NppRetrieveImage *pImageSetter,
-                              std::string sResultFilename, int nBitDepth) {
-    npp::ImageCPU_8u_C3 oHostSrc;
-    // load color image from disk
-    pImageSetter->loadImage(&oHostSrc, nBitDepth);
-    npp::ImageNPP_8u_C3 oDeviceSrc(oHostSrc);
-    NppiSize oSrcSize = {static_cast<int>(oDeviceSrc.width()),
-                        static_cast<int>(oDeviceSrc.height())};
-    // create struct with ROI size
-    NppiSize oSizeROI = {static_cast<int>(oDeviceSrc.width()),
-                        static_cast<int>(oDeviceSrc.height())};
-    // allocate device image of appropriately reduced size
-    npp::ImageNPP_8u_C3 oDeviceDst(oSizeROI.width, oSizeROI.height);
-    if (nFilterType == FilterType_FilterBoxBorder) {
-        // run box filter
-        NPP_CHECK_NPP(nppiFilterBoxBorder_8u_C3R(
-            oDeviceSrc.data(), oDeviceSrc.pitch(), oSrcSize, oSrcOffset,
-            oDeviceDst.data(), oDeviceDst.pitch(), oSizeROI, oMaskSize, oAnchor,
-            NPP_BORDER_REPLICATE));
-    } else if (nFilterType == FilterType_FilterGaussBorder) {
-        Npp32s nSrcStep = oDeviceSrc.pitch();
-        Npp32s nDstStep = oDeviceDst.pitch();
+// A stacked batch is filtered whole: its images are small, so strips would
+// only add calls. Stacking and unstacking count as filter time.
+void NppProcessImage::FilterBatch(const std::vector<npp::ImageView> &aSrc,
+                                  const std::vector<npp::ImageView> &aDst) {
+    NPP_ASSERT(aSrc.size() == aDst.size());
+    if (!pBackend) {
+        pBackend = std::make_shared<NppFilterBackend>();
+    }
+    if (pBackend->StacksBatches() && aChain.empty()) {
+        int nMaskAbove = 0, nMaskBelow = 0;
+        StepHalo(CurrentStep(), &nMaskAbove, &nMaskBelow);
+        int nAbove = 0, nBelow = 0;
+        ImageBatch::Halo(nMaskAbove, nMaskBelow, oSrcOffset.y, &nAbove,
+                         &nBelow);
 
-        // run gauss border filter
-        NPP_CHECK_NPP(nppiFilterGaussBorder_8u_C3R(
-            oDeviceSrc.data(), nSrcStep, oSrcSize, oSrcOffset,
-            oDeviceDst.data(), nDstStep, oSizeROI, oGaussMaskSize,
-            NPP_BORDER_REPLICATE));
-    }
-    // declare a host image for the result
-    npp::ImageCPU_8u_C3 oHostDst(oDeviceDst.size());
-    // and copy the device result data into it
-    oDeviceDst.copyTo(oHostDst.data(), oHostDst.pitch());
-    // save host image to result file
-    pImageSetter->saveImage(sResultFilename, oHostDst.data(),
-                    oHostDst.pitch(), oHostDst.height(), oHostDst.width());
-    // std::cout << "Saved image: " << sResultFilename << std::endl;
-
-    nppiFree(oDeviceSrc.data());
-    nppiFree(oDeviceDst.data());
-}
-
-void NppProcessImage::ProcessC4Image(npp::NppRetrieveImage *pImageSetter,
-                              std::string sResultFilename, int nBitDepth) {
-    npp::ImageCPU_8u_C4 oHostSrc;
-    // load gray-scale image from disk
-    pImageSetter->loadImage(&oHostSrc, nBitDepth);
-    npp::ImageNPP_8u_C4 oDeviceSrc(oHostSrc);
-    NppiSize oSrcSize = {static_cast<int>(oDeviceSrc.width()),
-                        static_cast<int>(oDeviceSrc.height())};
+        StageClock oClock;
+        ImageBatch oBatch(&HostBufferPool(), aSrc, nAbove, nBelow);
+        double dCopyMs = oClock.Lap();
+        RunFilterAt(oBatch.src(), oBatch.pitch(), oBatch.srcSize(),
+                    oBatch.srcOffset(oSrcOffset), oBatch.dst(),
+                    oBatch.pitch(), oBatch.roiSize(), oBatch.channels());
+        oClock.Lap();
+        oBatch.Unstack(aDst);
+        dCopyMs += oClock.Lap();
+        if (pTimings != NULL) {
+            pTimings->dFilterMs += dCopyMs;
+        }
+        return;
+    }
+    if (pBackend->StacksBatches()) {
+        // the steps of a chain run on blocks of one image at a time
+        for (size_t i = 0; i < aSrc.size(); ++i) {
+            FilterImage(NULL, aSrc[i], aDst[i]);
+        }
+        return;
+    }
+    // the images may be filtered concurrently, so the batch is timed as a
+    // whole instead of every call adding to the timings
+    StageTimings *pBatchTimings = pTimings;
+    pTimings = NULL;
+    StageClock oClock;
+    pBackend->ForEachImage(static_cast<int>(aSrc.size()), [&](int i) {
+        FilterImage(NULL, aSrc[i], aDst[i]);
+    });
+    pTimings = pBatchTimings;
+    if (pTimings != NULL) {
+        pTimings->dFilterMs += oClock.Lap();
+    }
+}
+
+// The filters of a chain run block by block: each step filters the rows of a
+// block the next step needs, halo included, into one of two small buffers
+// that take turns as source and result, and the last step writes into the
+// result. The intermediate images therefore never exist in full; a block is
+// sized to stay in cache. Halo rows are filtered again by the next block,
+// which keeps every block independent and the result the same as running
+// the filters on whole images one after the other.
+void NppProcessImage::FilterChain(npp::NppRetrieveImage *pImageSetter,
+                                  const npp::ImageView &rSrc,
+                                  const npp::ImageView &rDst) {
+    if (!pBackend) {
+        pBackend = std::make_shared<NppFilterBackend>();
+    }
+    const int nSteps = static_cast<int>(aChain.size());
+    const int nChannels = rSrc.nChannels;
+    const int nRowBytes = rDst.nWidth * nChannels;
+
+    int nBlockRows = nTileRows;
+    if (nBlockRows <= 0) {
+        const size_t nBlockBytes = pBackend->ChainBlockBytes();
+        nBlockRows = nBlockBytes == 0
+                         ? rDst.nHeight
+                         : std::max(kMinChainBlockRows,
+                                    static_cast<int>(nBlockBytes / nRowBytes));
+    }
+    nBlockRows = std::min(nBlockRows, rDst.nHeight);
+
+    // an intermediate block holds at most the halos of the steps after it
+    int nHaloRows = 0;
+    for (int iStep = 1; iStep < nSteps; ++iStep) {
+        int nAbove = 0, nBelow = 0;
+        StepHalo(aChain[iStep], &nAbove, &nBelow);
+        nHaloRows += std::max(nAbove, 0) + std::max(nBelow, 0);
+    }
+    const int nBufferRows = std::min(nBlockRows + nHaloRows, rDst.nHeight);
+    PooledImageBuffer oPing(&HostBufferPool(), nRowBytes, nBufferRows, 64);
+    PooledImageBuffer oPong(&HostBufferPool(), nRowBytes, nBufferRows, 64);
+
+    // rows [aBegin[i], aEnd[i]) of the image produced by step i
+    std::vector<int> aBegin(nSteps), aEnd(nSteps);
+    for (int nRow = 0; nRow < rDst.nHeight; nRow += nBlockRows) {
+        const int nRowEnd = std::min(nRow + nBlockRows, rDst.nHeight);
+        aBegin[nSteps - 1] = nRow;
+        aEnd[nSteps - 1] = nRowEnd;
+        for (int iStep = nSteps - 1; iStep > 0; --iStep) {
+            StepRows(aChain[iStep], aBegin[iStep], aEnd[iStep], 0,
+                     rDst.nHeight, &aBegin[iStep - 1], &aEnd[iStep - 1]);
+        }
+        int nSrcBegin = 0, nSrcEnd = 0;
+        StepRows(aChain[0], aBegin[0], aEnd[0], oSrcOffset.y, rSrc.nHeight,
+                 &nSrcBegin, &nSrcEnd);
+
+        const Npp8u *pIn = rSrc.pData +
+                           static_cast<ptrdiff_t>(nSrcBegin) * rSrc.nPitch;
+        Npp32s nInStep = rSrc.nPitch;
+        NppiSize oInSize = {rSrc.nWidth, nSrcEnd - nSrcBegin};
+        NppiPoint oOffset = {oSrcOffset.x,
+                             oSrcOffset.y + aBegin[0] - nSrcBegin};
+        for (int iStep = 0; iStep < nSteps; ++iStep) {
+            Npp8u *pOut = rDst.pData +
+                          static_cast<ptrdiff_t>(nRow) * rDst.nPitch;
+            Npp32s nOutStep = rDst.nPitch;
+            if (iStep < nSteps - 1) {
+                const PooledImageBuffer &rBuffer =
+                    iStep % 2 == 0 ? oPing : oPong;
+                pOut = rBuffer.data();
+                nOutStep = rBuffer.pitch();
+            }
+            NppiSize oSizeROI = {rDst.nWidth, aEnd[iStep] - aBegin[iStep]};
+            RunStepAt(aChain[iStep], pIn, nInStep, oInSize, oOffset, pOut,
+                      nOutStep, oSizeROI, nChannels);
+
+            // the next step reads the rows just written
+            if (iStep < nSteps - 1) {
+                pIn = pOut;
+                nInStep = nOutStep;
+                oInSize = oSizeROI;
+                oOffset.x = 0;
+                oOffset.y = aBegin[iStep + 1] - aBegin[iStep];
+            }
+        }
+
+        // the rows above the halo of the next block are not read again
+        int nNextSrcBegin = nSrcBegin;
+        if (nRowEnd < rDst.nHeight) {
+            int nNextBegin = nRowEnd, nNextEnd = rDst.nHeight;
+            for (int iStep = nSteps - 1; iStep > 0; --iStep) {
+                StepRows(aChain[iStep], nNextBegin, nNextEnd, 0,
+                         rDst.nHeight, &nNextBegin, &nNextEnd);
+            }
+            StepRows(aChain[0], nNextBegin, nNextEnd, oSrcOffset.y,
+                     rSrc.nHeight, &nNextSrcBegin, &nSrcEnd);
+        }
+        if (pImageSetter != NULL) {
+            pImageSetter->releaseRows(nNextSrcBegin, nRowEnd);
+        }
+    }
+}
+
+void NppProcessImage::FilterAndSave(npp::NppRetrieveImage *pImageSetter,
+                                    const std::string &rResultFilename,
+                                    int nChannels) {
+    // filter straight from the decoded bitmap into the result bitmap
+    npp::ImageView oSrc = pImageSetter->sourceView();
+    NPP_ASSERT(oSrc.nChannels == nChannels);
     // create struct with ROI size
-    NppiSize oSizeROI = {static_cast<int>(oDeviceSrc.width()),
-                        static_cast<int>(oDeviceSrc.height())};
-    // allocate device image of appropriately reduced size
-    npp::ImageNPP_8u_C4 oDeviceDst(oSizeROI.width, oSizeROI.height);
-    if (nFilterType == FilterType_FilterBoxBorder) {
-        // run box filter
-        NPP_CHECK_NPP(nppiFilterBoxBorder_8u_C4R(
-            oDeviceSrc.data(), oDeviceSrc.pitch(), oSrcSize, oSrcOffset,
-            oDeviceDst.data(), oDeviceDst.pitch(), oSizeROI, oMaskSize, oAnchor,
-            NPP_BORDER_REPLICATE));
-    } else if (nFilterType == FilterType_FilterGaussBorder) {
-        Npp32s nSrcStep = oDeviceSrc.pitch();
-        Npp32s nDstStep = oDeviceDst.pitch();
+    NppiSize oSizeROI = {oSrc.nWidth, oSrc.nHeight};
 
-        // run gauss border filter
-        NPP_CHECK_NPP(nppiFilterGaussBorder_8u_C4R(
-            oDeviceSrc.data(), nSrcStep, oSrcSize, oSrcOffset,
-            oDeviceDst.data(), nDstStep, oSizeROI, oGaussMaskSize,
-            NPP_BORDER_REPLICATE));
+    npp::ImageView oDst = pImageSetter->resultView(
+        rResultFilename, oSizeROI.width, oSizeROI.height, oEncodePolicy);
+    FilterImage(pImageSetter, oSrc, oDst);
+
+    // save the result bitmap to file
+    StageClock oClock;
+    pImageSetter->saveResult(rResultFilename);
+    if (pTimings != NULL) {
+        pTimings->dEncodeMs += oClock.Lap();
     }
-    // declare a host image for the result
-    npp::ImageCPU_8u_C4 oHostDst(oDeviceDst.size());
-    // and copy the device result data into it
-    oDeviceDst.copyTo(oHostDst.data(), oHostDst.pitch());
-    // save host image to result file
-    pImageSetter->saveImage(sResultFilename, oHostDst.data(),
-                    oHostDst.pitch(), oHostDst.height(), oHostDst.width());
-    // std::cout << "Saved image: " << sResultFilename << std::endl;
+}
 
-    nppiFree(oDeviceSrc.data());
-    nppiFree(oDeviceDst.data());
+template <int nChannels, typename Pixel>
+void NppProcessImage::ProcessImage(npp::NppRetrieveImage *pImageSetter,
+                                   const std::string &rResultFilename) {
+    // both backends implement the 8u variants of the NPP filters only
+    static_assert(std::is_same<Pixel, Npp8u>::value,
+                  "Only 8-bit channels can be filtered");
+    static_assert(nChannels == 1 || nChannels == 3 || nChannels == 4,
+                  "The filters take C1, C3 or C4 images");
+    FilterAndSave(pImageSetter, rResultFilename, nChannels);
 }
 
 void NppProcessImage::SetMaskSize(int width, int height) {
@@ -225,15 +397,206 @@ void NppProcessImage::SetFilterType(enumImageFilterType nType) {
     nFilterType = nType;
 }
 
+void NppProcessImage::SetBackend(
+        std::shared_ptr<FilterBackend> pFilterBackend) {
+    pBackend = pFilterBackend;
+}
+
+void NppProcessImage::SetTileRows(int nRows) {
+    nTileRows = nRows;
+}
+
+void NppProcessImage::SetTimings(StageTimings *pStageTimings) {
+    pTimings = pStageTimings;
+}
+
+void NppProcessImage::SetDecodeOptions(const npp::DecodeOptions &rOptions) {
+    oDecodeOptions = rOptions;
+}
+
+const npp::DecodeOptions &NppProcessImage::GetDecodeOptions() const {
+    return oDecodeOptions;
+}
+
+void NppProcessImage::SetEncodePolicy(const npp::EncodePolicy &rPolicy) {
+    oEncodePolicy = rPolicy;
+}
+
+const npp::EncodePolicy &NppProcessImage::GetEncodePolicy() const {
+    return oEncodePolicy;
+}
+
+FilterStep NppProcessImage::ScaledStep(const FilterStep &rStep,
+                                       int nDenominator) {
+    auto fScale = [nDenominator](int nValue) {
+        return static_cast<int>(
+            std::lround(static_cast<double>(nValue) / nDenominator));
+    };
+    FilterStep oStep = rStep;
+    oStep.oMaskSize.width = std::max(fScale(rStep.oMaskSize.width), 1);
+    oStep.oMaskSize.height = std::max(fScale(rStep.oMaskSize.height), 1);
+    oStep.oAnchor.x = std::min(fScale(rStep.oAnchor.x),
+                               oStep.oMaskSize.width - 1);
+    oStep.oAnchor.y = std::min(fScale(rStep.oAnchor.y),
+                               oStep.oMaskSize.height - 1);
+
+    // the Gauss mask whose size is closest to the scaled one among those of
+    // the same shape, so that a square mask stays square and a 1xN or Nx1
+    // mask keeps its direction
+    static const NppiMaskSize aGaussMasks[] = {
+        NPP_MASK_SIZE_1_X_3,   NPP_MASK_SIZE_1_X_5,   NPP_MASK_SIZE_3_X_1,
+        NPP_MASK_SIZE_5_X_1,   NPP_MASK_SIZE_3_X_3,   NPP_MASK_SIZE_5_X_5,
+        NPP_MASK_SIZE_7_X_7,   NPP_MASK_SIZE_9_X_9,   NPP_MASK_SIZE_11_X_11,
+        NPP_MASK_SIZE_13_X_13, NPP_MASK_SIZE_15_X_15};
+    const NppiSize oGauss = cpu::GaussMaskDims(rStep.oGaussMaskSize);
+    const double dWidth = static_cast<double>(oGauss.width) / nDenominator;
+    const double dHeight = static_cast<double>(oGauss.height) / nDenominator;
+    auto fShape = [](const NppiSize &rDims) {
+        return (rDims.width > rDims.height) - (rDims.width < rDims.height);
+    };
+    double dBest = -1.0;
+    for (NppiMaskSize eMask : aGaussMasks) {
+        const NppiSize oDims = cpu::GaussMaskDims(eMask);
+        if (fShape(oDims) != fShape(oGauss)) {
+            continue;
+        }
+        const double dDistance = std::fabs(oDims.width - dWidth) +
+                                 std::fabs(oDims.height - dHeight);
+        if (dBest < 0.0 || dDistance < dBest) {
+            dBest = dDistance;
+            oStep.oGaussMaskSize = eMask;
+        }
+    }
+    return oStep;
+}
+
+void NppProcessImage::ScaleDown(int nDenominator) {
+    if (nDenominator <= 1) {
+        return;
+    }
+    const FilterStep oStep = ScaledStep(CurrentStep(), nDenominator);
+    oMaskSize = oStep.oMaskSize;
+    oAnchor = oStep.oAnchor;
+    oGaussMaskSize = oStep.oGaussMaskSize;
+    oSrcOffset.x = static_cast<int>(
+        std::lround(static_cast<double>(oSrcOffset.x) / nDenominator));
+    oSrcOffset.y = static_cast<int>(
+        std::lround(static_cast<double>(oSrcOffset.y) / nDenominator));
+    for (FilterStep &rStep : aChain) {
+        rStep = ScaledStep(rStep, nDenominator);
+    }
+}
+
+void NppProcessImage::SetFilterChain(const std::string &rChain) {
+    static const NppiMaskSize aSquareGaussMasks[] = {
+        NPP_MASK_SIZE_3_X_3,   NPP_MASK_SIZE_5_X_5,   NPP_MASK_SIZE_7_X_7,
+        NPP_MASK_SIZE_9_X_9,   NPP_MASK_SIZE_11_X_11, NPP_MASK_SIZE_13_X_13,
+        NPP_MASK_SIZE_15_X_15};
+    std::vector<FilterStep> aSteps;
+    std::istringstream oChain(rChain);
+    std::string sStep;
+    while (std::getline(oChain, sStep, ',')) {
+        // "name:size" with an odd size, e.g. box:5 or gauss:7
+        const std::string::size_type nColon = sStep.find(':');
+        NPP_ASSERT_MSG(nColon != std::string::npos,
+                       "Expected filter chain steps as name:size");
+        const std::string sName = sStep.substr(0, nColon);
+        const int nSize = atoi(sStep.c_str() + nColon + 1);
+
+        FilterStep oStep = CurrentStep();
+        if (sName == "box") {
+            NPP_ASSERT_MSG(nSize > 0, "Box mask size must be positive");
+            oStep.nFilterType = FilterType_FilterBoxBorder;
+            oStep.oMaskSize.width = oStep.oMaskSize.height = nSize;
+            oStep.oAnchor.x = oStep.oAnchor.y = nSize / 2;
+        } else if (sName == "gauss") {
+            NPP_ASSERT_MSG(nSize >= 3 && nSize <= 15 && nSize % 2 == 1,
+                           "Gauss mask size must be 3, 5, ... or 15");
+            oStep.nFilterType = FilterType_FilterGaussBorder;
+            oStep.oGaussMaskSize = aSquareGaussMasks[(nSize - 3) / 2];
+        } else {
+            throw npp::Exception("Unknown filter in chain: " + sName);
+        }
+        aSteps.push_back(oStep);
+    }
+    NPP_ASSERT_MSG(!aSteps.empty(), "Empty filter chain");
+    aChain = aSteps;
+    sChain = rChain;
+}
+
+std::string NppProcessImage::FilterName() const {
+    if (!aChain.empty()) {
+        return "pipelineFilter";
+    }
+    if (nFilterType == FilterType_FilterBoxBorder) {
+        return FilterDescription[FilterType_FilterBoxBorder][0];
+    }
+    return FilterDescription[FilterType_FilterGaussBorder][0];
+}
+
+// The decode options as a JSON member, or nothing for the defaults
+static std::string DecodeJson(const npp::DecodeOptions &rOptions) {
+    if (!rOptions.bFast && rOptions.nScaleDenominator <= 1) {
+        return "";
+    }
+    std::ostringstream oJson;
+    oJson << ",\"decode\":{\"idct\":\""
+          << (rOptions.bFast ? "fast" : "accurate") << "\",\"scale\":\"1/"
+          << std::max(rOptions.nScaleDenominator, 1) << "\"}";
+    return oJson.str();
+}
+
+// The output format as a JSON member, or nothing when it is kept
+static std::string EncodeJson(const npp::EncodePolicy &rPolicy) {
+    if (rPolicy.KeepsFormat()) {
+        return "";
+    }
+    return ",\"encode\":\"" + rPolicy.sText + "\"";
+}
+
+std::string NppProcessImage::SettingsJson() const {
+    if (!aChain.empty()) {
+        std::ostringstream oJson;
+        oJson << "\"filter\":\"" << FilterName() << "\""
+              << ",\"pipeline\":\"" << sChain << "\""
+              << ",\"offset\":[" << oSrcOffset.x << "," << oSrcOffset.y
+              << "]"
+              << ",\"backend\":\"" << (pBackend ? pBackend->Name() : "npp")
+              << "\"" << DecodeJson(oDecodeOptions)
+              << EncodeJson(oEncodePolicy);
+        return oJson.str();
+    }
+    NppiSize oMask = oMaskSize;
+    NppiPoint oCenter = oAnchor;
+    if (nFilterType == FilterType_FilterGaussBorder) {
+        oMask = cpu::GaussMaskDims(oGaussMaskSize);
+        oCenter.x = oMask.width / 2;
+        oCenter.y = oMask.height / 2;
+    }
+    std::ostringstream oJson;
+    oJson << "\"filter\":\"" << FilterDescription[nFilterType][0] << "\""
+          << ",\"mask\":[" << oMask.width << "," << oMask.height << "]"
+          << ",\"offset\":[" << oSrcOffset.x << "," << oSrcOffset.y << "]"
+          << ",\"anchor\":[" << oCenter.x << "," << oCenter.y << "]"
+          << ",\"backend\":\"" << (pBackend ? pBackend->Name() : "npp")
+          << "\"" << DecodeJson(oDecodeOptions)
+          << EncodeJson(oEncodePolicy);
+    return oJson.str();
+}
+
 void NppProcessImage::ProcessImageNPP(npp::NppRetrieveImage *pImageSetter,
                             std::string szResultFileName, int nBitDepth) {
-    if (nBitDepth == 8) {
-        ProcessC1Image(pImageSetter, szResultFileName, nBitDepth);
-    } else if (nBitDepth == 16) {
-        ProcessC2Image(pImageSetter, szResultFileName, nBitDepth);
-    } else if (nBitDepth == 24) {
-        ProcessC3Image(pImageSetter, szResultFileName, nBitDepth);
-    } else if (nBitDepth == 32) {
-        ProcessC4Image(pImageSetter, szResultFileName, nBitDepth);
+    switch (nBitDepth) {
+    case 8:
+        ProcessImage<1, Npp8u>(pImageSetter, szResultFileName);
+        break;
+    case 24:
+        ProcessImage<3, Npp8u>(pImageSetter, szResultFileName);
+        break;
+    case 32:
+        ProcessImage<4, Npp8u>(pImageSetter, szResultFileName);
+        break;
+    default:
+        NPP_ASSERT_MSG(false, "Unsupported image bit depth");
     }
 }
@@ -41,6 +41,8 @@
 
 #include <Exceptions.h>
 #include "ImageIOEx.h"
+#include "filterBackend.h"
+#include "imageBatch.h"
 #include <ImagesCPU.h>
 
 #include <ImagesNPP.h>
@@ -55,6 +57,7 @@
 #include <string>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <vector>
 
     enum enumImageFilterType {
@@ -70,6 +73,15 @@ const std::vector<std::vector<std::string>> FilterDescription = {
     {static_cast<int>(FilterType_FilterGaussBorder), "gaussFilter"},
     {static_cast<int>(FilterType_Unsupported), "unsupported"}};
 
+// One filter of a chain such as "box:5,gauss:7,box:3". Box filters of a
+// chain are anchored at the centre of their mask.
+struct FilterStep {
+    enumImageFilterType nFilterType;
+    NppiSize oMaskSize;
+    NppiPoint oAnchor;
+    NppiMaskSize oGaussMaskSize;
+};
+
 class NppProcessImage {
     enumImageFilterType nFilterType = FilterType_FilterBoxBorder;
 
@@ -95,19 +107,54 @@ class NppProcessImage {
         NPP_MASK_SIZE_15_X_15 	
     */
 
-    void ProcessC1Image(
-        npp::NppRetrieveImage *pImageSetter,
-        std::string sResultFilename,
-        int nBitDepth);
-    void ProcessC2Image(npp::NppRetrieveImage *pImageSetter,
-                    std::string sResultFilename,
-                    int nBitDepth);
-    void ProcessC3Image(npp::NppRetrieveImage *pImageSetter,
-                    std::string sResultFilename,
-                    int nBitDepth);
-    void ProcessC4Image(npp::NppRetrieveImage *pImageSetter,
-                    std::string sResultFilename,
-                    int nBitDepth);
+    // NPP on the GPU or the native host implementation
+    std::shared_ptr<FilterBackend> pBackend;
+
+    // rows per strip; 0 filters the whole image in one call
+    int nTileRows = 0;
+
+    // stage times of the current image are added here when set
+    StageTimings *pTimings = NULL;
+
+    // filters applied one after the other instead of the single filter
+    // above, with the text they were parsed from
+    std::vector<FilterStep> aChain;
+    std::string sChain;
+
+    // smallest row block of a chain, which bounds the share of halo rows
+    // that are filtered twice
+    static const int kMinChainBlockRows = 32;
+
+    // how the images to filter are decoded
+    npp::DecodeOptions oDecodeOptions;
+    // how the results are encoded
+    npp::EncodePolicy oEncodePolicy;
+
+    FilterStep CurrentStep() const;
+    static FilterStep ScaledStep(const FilterStep &rStep, int nDenominator);
+    void RunFilterAt(const Npp8u *pSrc, Npp32s nSrcStep, NppiSize oSrcSize,
+                     NppiPoint oOffset, Npp8u *pDst, Npp32s nDstStep,
+                     NppiSize oSizeROI, int nChannels);
+    void RunStepAt(const FilterStep &rStep, const Npp8u *pSrc,
+                   Npp32s nSrcStep, NppiSize oSrcSize, NppiPoint oOffset,
+                   Npp8u *pDst, Npp32s nDstStep, NppiSize oSizeROI,
+                   int nChannels);
+    static void StepHalo(const FilterStep &rStep, int *pnAbove,
+                         int *pnBelow);
+    static void StepRows(const FilterStep &rStep, int nRowBegin, int nRowEnd,
+                         int nOffsetY, int nHeight, int *pnBegin,
+                         int *pnEnd);
+    void SourceRows(int nRowBegin, int nRowEnd, int nHeight, int *pnBegin,
+                    int *pnEnd) const;
+    void FilterChain(npp::NppRetrieveImage *pImageSetter,
+                     const npp::ImageView &rSrc, const npp::ImageView &rDst);
+    void FilterAndSave(npp::NppRetrieveImage *pImageSetter,
+                       const std::string &rResultFilename, int nChannels);
+
+    // filter an image of nChannels interleaved channels of type Pixel
+    template <int nChannels, typename Pixel>
+    void ProcessImage(npp::NppRetrieveImage *pImageSetter,
+                      const std::string &rResultFilename);
 
  public:
     void SetMaskSize(int width, int height);
@@ -115,6 +162,37 @@ class NppProcessImage {
     void SetAnchor(int x, int y);
     void SetGaussMaskSize(int nMaskSize);
     void SetFilterType(enumImageFilterType nType);
+    void SetBackend(std::shared_ptr<FilterBackend> pFilterBackend);
+    void SetTileRows(int nRows);
+    void SetTimings(StageTimings *pStageTimings);
+    void SetDecodeOptions(const npp::DecodeOptions &rOptions);
+    const npp::DecodeOptions &GetDecodeOptions() const;
+    void SetEncodePolicy(const npp::EncodePolicy &rPolicy);
+    const npp::EncodePolicy &GetEncodePolicy() const;
+    // Shrink the masks, anchors and source offset for an image decoded at
+    // 1/nDenominator of its size, so the filter covers the same part of the
+    // picture; masks keep at least one pixel
+    void ScaleDown(int nDenominator);
+    // parse a chain such as "box:5,gauss:7,box:3"; the source offset applies
+    // to its first filter. Throws for malformed chains
+    void SetFilterChain(const std::string &rChain);
+    // name of the filter, or of the chain, for the result files
+    std::string FilterName() const;
+    // the filter settings as JSON members for the processing log
+    std::string SettingsJson() const;
+    // apply the selected filter with the current settings to a host image
+    void RunFilter(const Npp8u *pSrc, Npp32s nSrcStep, NppiSize oSrcSize,
+                   Npp8u *pDst, Npp32s nDstStep, NppiSize oSizeROI,
+                   int nChannels);
+    // filter a whole image, strip by strip when a tile height is set; rows
+    // already filtered are released through pImageSetter unless it is NULL
+    void FilterImage(npp::NppRetrieveImage *pImageSetter,
+                     const npp::ImageView &rSrc, const npp::ImageView &rDst);
+    // filter images of the same size and channel count as a batch: stacked
+    // into a single backend call (see ImageBatch) or image by image through
+    // the backend's ForEachImage(), as the backend prefers
+    void FilterBatch(const std::vector<npp::ImageView> &aSrc,
+                     const std::vector<npp::ImageView> &aDst);
     void ProcessImageNPP(npp::NppRetrieveImage *pImageSetter,
                      std::string szResultFileName,
                      int nBitDepth);
@@ -0,0 +1,289 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_PROCESSINGLOG_H_
+#define SRC_PROCESSINGLOG_H_
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Wall-clock milliseconds spent in each stage of processing one image.
+// Upload and download stay 0 when the filter runs on the host.
+struct StageTimings {
+    double dCheckMs = 0.0;
+    double dDecodeMs = 0.0;
+    double dUploadMs = 0.0;
+    double dFilterMs = 0.0;
+    double dDownloadMs = 0.0;
+    double dEncodeMs = 0.0;
+    double dLogMs = 0.0;
+
+    void Add(const StageTimings &rOther) {
+        dCheckMs += rOther.dCheckMs;
+        dDecodeMs += rOther.dDecodeMs;
+        dUploadMs += rOther.dUploadMs;
+        dFilterMs += rOther.dFilterMs;
+        dDownloadMs += rOther.dDownloadMs;
+        dEncodeMs += rOther.dEncodeMs;
+        dLogMs += rOther.dLogMs;
+    }
+
+    // e.g. to share the times of a batch out between its images
+    void Scale(double dFactor) {
+        dCheckMs *= dFactor;
+        dDecodeMs *= dFactor;
+        dUploadMs *= dFactor;
+        dFilterMs *= dFactor;
+        dDownloadMs *= dFactor;
+        dEncodeMs *= dFactor;
+        dLogMs *= dFactor;
+    }
+};
+
+// Stopwatch; Lap() returns the milliseconds since the previous lap
+class StageClock {
+    std::chrono::steady_clock::time_point m_oLast;
+
+ public:
+    StageClock() : m_oLast(std::chrono::steady_clock::now()) {}
+
+    double Lap() {
+        std::chrono::steady_clock::time_point oNow =
+            std::chrono::steady_clock::now();
+        double dMs =
+            std::chrono::duration<double, std::milli>(oNow - m_oLast).count();
+        m_oLast = oNow;
+        return dMs;
+    }
+};
+
+// What is logged about one image
+struct ImageRecord {
+    std::string sFilename;
+    // one name per result; a fan-out writes several results per image
+    std::vector<std::string> aResultFilenames;
+    std::string sError;
+    int nWidth = 0;
+    int nHeight = 0;
+    int nBitDepth = 0;
+    // the image was decoded at 1/nDecodeScale of its size
+    int nDecodeScale = 1;
+    // the image was filtered in a batch of this many images; its filter
+    // times are its share of the batch
+    int nBatchImages = 1;
+    size_t nBytesRead = 0;
+    size_t nBytesWritten = 0;
+    StageTimings oTimings;
+    // "hit", "miss" or "partial" when a result cache is used
+    std::string sCache;
+    // when work on the image started, for its end-to-end latency
+    std::chrono::steady_clock::time_point oStart =
+        std::chrono::steady_clock::now();
+};
+
+inline std::string JsonString(const std::string &rValue) {
+    std::string sQuoted = "\"";
+    for (char c : rValue) {
+        if (c == '"' || c == '\\') {
+            sQuoted += '\\';
+            sQuoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char aEscape[8];
+            snprintf(aEscape, sizeof(aEscape), "\\u%04x", c);
+            sQuoted += aEscape;
+        } else {
+            sQuoted += c;
+        }
+    }
+    return sQuoted + "\"";
+}
+
+// Writes one JSON object per line: a record per image and, for a batch, a
+// closing summary with latency percentiles and throughput. Records may be
+// written from several threads.
+class ProcessingLog {
+    std::ostream &m_rLog;
+    // filter settings shared by all records, as JSON members
+    std::string m_sSettings;
+    std::mutex m_oMutex;
+    std::chrono::steady_clock::time_point m_oStart;
+    std::vector<double> m_aLatencies;
+    StageTimings m_oTotals;
+    size_t m_nBytesRead = 0;
+    size_t m_nBytesWritten = 0;
+    int m_nFailed = 0;
+
+    static std::string Number(double dValue) {
+        char aNumber[32];
+        snprintf(aNumber, sizeof(aNumber), "%.3f", dValue);
+        return aNumber;
+    }
+
+    // nearest-rank percentile of sorted values
+    static double Percentile(const std::vector<double> &rSorted,
+                             double dPercent) {
+        if (rSorted.empty()) {
+            return 0.0;
+        }
+        size_t nRank = static_cast<size_t>(
+            std::ceil(dPercent / 100.0 * rSorted.size()));
+        return rSorted[std::max<size_t>(nRank, 1) - 1];
+    }
+
+    static std::string StagesJson(const StageTimings &rTimings) {
+        return "{\"check\":" + Number(rTimings.dCheckMs) +
+               ",\"decode\":" + Number(rTimings.dDecodeMs) +
+               ",\"upload\":" + Number(rTimings.dUploadMs) +
+               ",\"filter\":" + Number(rTimings.dFilterMs) +
+               ",\"download\":" + Number(rTimings.dDownloadMs) +
+               ",\"encode\":" + Number(rTimings.dEncodeMs) +
+               ",\"log\":" + Number(rTimings.dLogMs) + "}";
+    }
+
+ public:
+    ProcessingLog(std::ostream &rLog, const std::string &rSettings)
+        : m_rLog(rLog), m_sSettings(rSettings),
+          m_oStart(std::chrono::steady_clock::now()) {}
+
+    // Write the record of a finished image. The time the write itself takes
+    // is measured up to the last member, log_ms, and stored in the record.
+    void Write(ImageRecord *pRecord) { Write(pRecord, m_sSettings); }
+
+    // The same with the settings of this record, for logs whose images are
+    // filtered with different settings. Returns the line, without newline.
+    std::string Write(ImageRecord *pRecord, const std::string &rSettings) {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        StageClock oClock;
+        const double dLatencyMs =
+            std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - pRecord->oStart).count();
+        std::ostringstream oLine;
+        oLine << "{\"file\":" << JsonString(pRecord->sFilename);
+        if (pRecord->aResultFilenames.size() > 1) {
+            oLine << ",\"results\":[";
+            for (size_t i = 0; i < pRecord->aResultFilenames.size(); ++i) {
+                oLine << (i > 0 ? "," : "")
+                      << JsonString(pRecord->aResultFilenames[i]);
+            }
+            oLine << "]";
+        } else {
+            oLine << ",\"result\":"
+                  << JsonString(pRecord->aResultFilenames.empty()
+                                    ? "" : pRecord->aResultFilenames[0]);
+        }
+        oLine << ",\"status\":\"" << (pRecord->sError.empty() ? "ok" : "error")
+              << "\"";
+        if (!pRecord->sError.empty()) {
+            oLine << ",\"error\":" << JsonString(pRecord->sError);
+        }
+        if (!pRecord->sCache.empty()) {
+            oLine << ",\"cache\":\"" << pRecord->sCache << "\"";
+        }
+        if (!rSettings.empty()) {
+            oLine << "," << rSettings;
+        }
+        oLine << ",\"width\":" << pRecord->nWidth
+              << ",\"height\":" << pRecord->nHeight
+              << ",\"bit_depth\":" << pRecord->nBitDepth;
+        if (pRecord->nDecodeScale > 1) {
+            oLine << ",\"decode_scale\":\"1/" << pRecord->nDecodeScale
+                  << "\"";
+        }
+        if (pRecord->nBatchImages > 1) {
+            oLine << ",\"batch\":" << pRecord->nBatchImages;
+        }
+        oLine << ",\"bytes_read\":" << pRecord->nBytesRead
+              << ",\"bytes_written\":" << pRecord->nBytesWritten
+              << ",\"latency_ms\":" << Number(dLatencyMs)
+              << ",\"stage_ms\":" << StagesJson(pRecord->oTimings);
+        m_rLog << oLine.str();
+        pRecord->oTimings.dLogMs = oClock.Lap();
+        const std::string sLogMs =
+            ",\"log_ms\":" + Number(pRecord->oTimings.dLogMs) + "}";
+        m_rLog << sLogMs << std::endl;
+
+        m_aLatencies.push_back(dLatencyMs);
+        m_oTotals.Add(pRecord->oTimings);
+        m_nBytesRead += pRecord->nBytesRead;
+        m_nBytesWritten += pRecord->nBytesWritten;
+        if (!pRecord->sError.empty()) {
+            m_nFailed++;
+        }
+        return oLine.str() + sLogMs;
+    }
+
+    // Close a batch with its totals; rExtra holds further JSON members
+    void WriteSummary(const std::string &rExtra = "") {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        const double dWallSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                          m_oStart).count();
+        std::vector<double> aSorted = m_aLatencies;
+        std::sort(aSorted.begin(), aSorted.end());
+        m_rLog << "{\"summary\":{\"images\":" << m_aLatencies.size()
+               << ",\"failed\":" << m_nFailed
+               << ",\"wall_s\":" << Number(dWallSeconds)
+               << ",\"images_per_s\":"
+               << Number(dWallSeconds > 0.0
+                             ? m_aLatencies.size() / dWallSeconds : 0.0)
+               << ",\"latency_ms\":{\"p50\":"
+               << Number(Percentile(aSorted, 50.0))
+               << ",\"p95\":" << Number(Percentile(aSorted, 95.0))
+               << ",\"p99\":" << Number(Percentile(aSorted, 99.0)) << "}"
+               << ",\"stage_ms\":" << StagesJson(m_oTotals)
+               << ",\"bytes_read\":" << m_nBytesRead
+               << ",\"bytes_written\":" << m_nBytesWritten
+               // how fast the output format encodes, to weigh against
+               // bytes_written when choosing one
+               << ",\"encode_mb_per_s\":"
+               << Number(m_oTotals.dEncodeMs > 0.0
+                             ? m_nBytesWritten / 1e3 / m_oTotals.dEncodeMs
+                             : 0.0);
+        if (!rExtra.empty()) {
+            m_rLog << "," << rExtra;
+        }
+        m_rLog << "}}" << std::endl;
+    }
+
+    int Failed() {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        return m_nFailed;
+    }
+};
+#endif  //  SRC_PROCESSINGLOG_H_
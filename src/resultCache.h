@@ -0,0 +1,339 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_RESULTCACHE_H_
+#define SRC_RESULTCACHE_H_
+
+#include <Exceptions.h>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "mappedFile.h"
+
+// 64-bit XXH64 hash of a byte range; fast enough to hash every input
+// before deciding whether it needs to be decoded at all
+inline uint64_t HashBytes64(const unsigned char *pData, size_t nSize,
+                            uint64_t nSeed = 0) {
+    const uint64_t kPrime1 = 11400714785074694791ULL;
+    const uint64_t kPrime2 = 14029467366897019727ULL;
+    const uint64_t kPrime3 = 1609587929392839161ULL;
+    const uint64_t kPrime4 = 9650029242287828579ULL;
+    const uint64_t kPrime5 = 2870177450012600261ULL;
+    auto fRotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    auto fRead64 = [](const unsigned char *p) {
+        uint64_t x;
+        memcpy(&x, p, sizeof(x));
+        return x;
+    };
+    auto fRead32 = [](const unsigned char *p) {
+        uint32_t x;
+        memcpy(&x, p, sizeof(x));
+        return static_cast<uint64_t>(x);
+    };
+    auto fRound = [&](uint64_t nAcc, uint64_t nInput) {
+        nAcc += nInput * kPrime2;
+        return fRotl(nAcc, 31) * kPrime1;
+    };
+    auto fMerge = [&](uint64_t nAcc, uint64_t nLane) {
+        nAcc ^= fRound(0, nLane);
+        return nAcc * kPrime1 + kPrime4;
+    };
+
+    const unsigned char *p = pData;
+    const unsigned char *pEnd = pData + nSize;
+    uint64_t nHash;
+    if (nSize >= 32) {
+        uint64_t v1 = nSeed + kPrime1 + kPrime2;
+        uint64_t v2 = nSeed + kPrime2;
+        uint64_t v3 = nSeed;
+        uint64_t v4 = nSeed - kPrime1;
+        for (; p + 32 <= pEnd; p += 32) {
+            v1 = fRound(v1, fRead64(p));
+            v2 = fRound(v2, fRead64(p + 8));
+            v3 = fRound(v3, fRead64(p + 16));
+            v4 = fRound(v4, fRead64(p + 24));
+        }
+        nHash = fRotl(v1, 1) + fRotl(v2, 7) + fRotl(v3, 12) + fRotl(v4, 18);
+        nHash = fMerge(nHash, v1);
+        nHash = fMerge(nHash, v2);
+        nHash = fMerge(nHash, v3);
+        nHash = fMerge(nHash, v4);
+    } else {
+        nHash = nSeed + kPrime5;
+    }
+    nHash += static_cast<uint64_t>(nSize);
+    for (; p + 8 <= pEnd; p += 8) {
+        nHash ^= fRound(0, fRead64(p));
+        nHash = fRotl(nHash, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= pEnd) {
+        nHash ^= fRead32(p) * kPrime1;
+        nHash = fRotl(nHash, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < pEnd; ++p) {
+        nHash ^= (*p) * kPrime5;
+        nHash = fRotl(nHash, 11) * kPrime1;
+    }
+    nHash ^= nHash >> 33;
+    nHash *= kPrime2;
+    nHash ^= nHash >> 29;
+    nHash *= kPrime3;
+    nHash ^= nHash >> 32;
+    return nHash;
+}
+
+// On-disk cache of filtered images, keyed by the hash of the input bytes and
+// the settings that produced the result. A hit is materialized as a hard link
+// to the cached file, or a copy where links are not possible, so the input
+// is neither decoded nor filtered again. The cache is bounded in size and
+// evicts the least recently used entries; the modification time of an entry
+// records its last use, so the order survives between runs.
+class ResultCache {
+    struct Entry {
+        size_t nBytes = 0;
+        // larger is more recent
+        uint64_t nLastUse = 0;
+    };
+
+    std::string m_sDirectory;
+    size_t m_nMaxBytes;
+    std::mutex m_oMutex;
+    std::map<std::string, Entry> m_aEntries;
+    size_t m_nBytes = 0;
+    uint64_t m_nClock = 0;
+    size_t m_nHits = 0;
+    size_t m_nMisses = 0;
+    size_t m_nStores = 0;
+    size_t m_nEvictions = 0;
+
+    std::string EntryPath(const std::string &rKey) const {
+        return m_sDirectory + "/" + rKey;
+    }
+
+    static bool IsKey(const std::string &rName) {
+        return rName.size() == 32 &&
+               rName.find_first_not_of("0123456789abcdef") ==
+                   std::string::npos;
+    }
+
+    // Drop the least recently used entries until the cache fits, sparing
+    // rKeep unless it is too large by itself. Called with the mutex held.
+    void Evict(const std::string &rKeep) {
+        while (m_nBytes > m_nMaxBytes && !m_aEntries.empty()) {
+            std::map<std::string, Entry>::iterator itOldest =
+                m_aEntries.end();
+            for (auto it = m_aEntries.begin(); it != m_aEntries.end(); ++it) {
+                if (it->first != rKeep &&
+                    (itOldest == m_aEntries.end() ||
+                     it->second.nLastUse < itOldest->second.nLastUse)) {
+                    itOldest = it;
+                }
+            }
+            if (itOldest == m_aEntries.end()) {
+                itOldest = m_aEntries.find(rKeep);
+            }
+            std::error_code oError;
+            std::filesystem::remove(EntryPath(itOldest->first), oError);
+            m_nBytes -= itOldest->second.nBytes;
+            m_aEntries.erase(itOldest);
+            m_nEvictions++;
+        }
+    }
+
+    // Link rFrom to rTo, or copy it when they are on different file systems
+    static bool LinkOrCopy(const std::string &rFrom, const std::string &rTo) {
+        if (link(rFrom.c_str(), rTo.c_str()) == 0) {
+            return true;
+        }
+        std::error_code oError;
+        return std::filesystem::copy_file(
+            rFrom, rTo, std::filesystem::copy_options::overwrite_existing,
+            oError);
+    }
+
+ public:
+    ResultCache(const std::string &rDirectory, size_t nMaxBytes)
+        : m_sDirectory(rDirectory), m_nMaxBytes(nMaxBytes) {
+        namespace fs = std::filesystem;
+        std::error_code oError;
+        fs::create_directories(m_sDirectory, oError);
+        NPP_ASSERT_MSG(fs::is_directory(m_sDirectory),
+                       "Cannot create the cache directory");
+
+        // entries of earlier runs, oldest use first
+        std::vector<std::pair<fs::file_time_type, std::string>> aFound;
+        for (const fs::directory_entry &rEntry :
+             fs::directory_iterator(m_sDirectory)) {
+            const std::string sName = rEntry.path().filename().string();
+            if (rEntry.is_regular_file() && IsKey(sName)) {
+                aFound.emplace_back(rEntry.last_write_time(), sName);
+            } else if (rEntry.is_regular_file() &&
+                       sName.find(".tmp") != std::string::npos) {
+                // left behind by an interrupted store
+                fs::remove(rEntry.path(), oError);
+            }
+        }
+        std::sort(aFound.begin(), aFound.end());
+        for (const auto &rFound : aFound) {
+            Entry oEntry;
+            oEntry.nBytes = fs::file_size(EntryPath(rFound.second), oError);
+            oEntry.nLastUse = ++m_nClock;
+            m_aEntries[rFound.second] = oEntry;
+            m_nBytes += oEntry.nBytes;
+        }
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        Evict("");
+    }
+
+    ResultCache(const ResultCache &) = delete;
+    ResultCache &operator=(const ResultCache &) = delete;
+
+    // Hash of the bytes of rInputFile, the part of the keys of its results
+    // that is the same for every output
+    static uint64_t ContentHash(const std::string &rInputFile) {
+        MappedFile oInput;
+        oInput.OpenRead(rInputFile);
+        return HashBytes64(oInput.data(), oInput.size());
+    }
+
+    // Key of the result of the input with content hash nContent filtered
+    // with rSettings, which has to name everything the result depends on:
+    // filter, mask, offset, anchor, backend and output format
+    static std::string Key(uint64_t nContent, const std::string &rSettings) {
+        const unsigned char *pSettings =
+            reinterpret_cast<const unsigned char *>(rSettings.data());
+        char aKey[40];
+        snprintf(aKey, sizeof(aKey), "%016llx%016llx",
+                 static_cast<unsigned long long>(nContent),
+                 static_cast<unsigned long long>(
+                     HashBytes64(pSettings, rSettings.size(), nContent)));
+        return aKey;
+    }
+
+    // The same for rInputFile, hashed on the way
+    static std::string Key(const std::string &rInputFile,
+                           const std::string &rSettings) {
+        return Key(ContentHash(rInputFile), rSettings);
+    }
+
+    // Materialize a cached result at rResultFile; false on a miss
+    bool Fetch(const std::string &rKey, const std::string &rResultFile) {
+        {
+            std::lock_guard<std::mutex> oLock(m_oMutex);
+            std::map<std::string, Entry>::iterator it = m_aEntries.find(rKey);
+            if (it == m_aEntries.end()) {
+                m_nMisses++;
+                return false;
+            }
+            it->second.nLastUse = ++m_nClock;
+        }
+        // replace the result rather than writing into a file that may be
+        // linked to another cache entry
+        std::error_code oError;
+        std::filesystem::remove(rResultFile, oError);
+        const std::string sEntry = EntryPath(rKey);
+        bool bFetched = LinkOrCopy(sEntry, rResultFile);
+        if (bFetched) {
+            // remember the use for the next run
+            utimensat(AT_FDCWD, sEntry.c_str(), NULL, 0);
+        }
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        if (bFetched) {
+            m_nHits++;
+        } else {
+            // evicted meanwhile, or removed behind our back
+            m_nMisses++;
+        }
+        return bFetched;
+    }
+
+    // Add a result that was just written to rResultFile
+    void Store(const std::string &rKey, const std::string &rResultFile) {
+        std::ostringstream oTemporary;
+        oTemporary << EntryPath(rKey) << "." << std::this_thread::get_id()
+                   << ".tmp";
+        std::error_code oError;
+        std::filesystem::remove(oTemporary.str(), oError);
+        if (!LinkOrCopy(rResultFile, oTemporary.str())) {
+            return;
+        }
+        const size_t nBytes = std::filesystem::file_size(oTemporary.str(),
+                                                         oError);
+        // the entry appears complete or not at all
+        if (oError ||
+            rename(oTemporary.str().c_str(), EntryPath(rKey).c_str()) != 0) {
+            std::filesystem::remove(oTemporary.str(), oError);
+            return;
+        }
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        Entry &rEntry = m_aEntries[rKey];
+        m_nBytes = m_nBytes - rEntry.nBytes + nBytes;
+        rEntry.nBytes = nBytes;
+        rEntry.nLastUse = ++m_nClock;
+        m_nStores++;
+        Evict(rKey);
+    }
+
+    // Counters as a JSON member for the summary of the processing log
+    std::string Summary() {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        const size_t nLookups = m_nHits + m_nMisses;
+        char aHitRate[32];
+        snprintf(aHitRate, sizeof(aHitRate), "%.3f",
+                 nLookups > 0 ? static_cast<double>(m_nHits) / nLookups : 0.0);
+        std::ostringstream oJson;
+        oJson << "\"cache\":{\"hits\":" << m_nHits
+              << ",\"misses\":" << m_nMisses << ",\"hit_rate\":" << aHitRate
+              << ",\"stores\":" << m_nStores
+              << ",\"evictions\":" << m_nEvictions
+              << ",\"entries\":" << m_aEntries.size()
+              << ",\"bytes\":" << m_nBytes << "}";
+        return oJson.str();
+    }
+};
+#endif  //  SRC_RESULTCACHE_H_
@@ -0,0 +1,293 @@
+
+/* Note some parts contains code was adpated from Nvidia's CUDA sample projects.
+ * These parts are subject to the Nvidia and other third party license and 
+ * copyright information contained in those files. Otherwise all other parts of
+ * this project follow the  MIT License:
+ *
+ *    Copyright(c) 2023 John Sogade
+ *
+ *    Permission is hereby granted,
+ *    free of charge, to any person obtaining a copy of this software and
+ *    associated documentation files(the "Software"), to deal in the Software
+ *    without restriction, including without limitation the rights to use, 
+ *    copy, modify, merge, publish, distribute, sublicense, and / or sell 
+ *    copies of the Software, and to permit persons to whom the Software is
+ *    furnished to do so, subject to the following conditions :
+ *
+ *    The above copyright notice and this permission notice shall be included
+ *    in all copies or substantial portions of the Software.
+ *
+ *   THE SOFTWARE IS PROVIDED "AS IS",
+ *   WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+ *   TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *   DAMAGES OR OTHER
+ *   LIABILITY,
+ *   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ *   THE SOFTWARE.
+ */
+
+#ifndef SRC_WORKSTEALINGPOOL_H_
+#define SRC_WORKSTEALINGPOOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs the tasks of ParallelFor on a fixed set of worker threads. Every worker
+// has its own deque of tasks: it takes the newest task of its own deque and,
+// once that is empty, steals the oldest task of another. The thread calling
+// ParallelFor works on its own tasks too until all of them are done. At most
+// nCores tasks run at once, callers included, so filters started from several
+// threads share the cores instead of each bringing a full set of threads;
+// when every core already has a caller the tasks simply run on the callers.
+// A task that calls ParallelFor itself keeps the one slot it runs in.
+class WorkStealingPool {
+    // the tasks of one ParallelFor call
+    struct Group {
+        const std::function<void(int)> *pTask = NULL;
+        int nPending = 0;
+        std::mutex oMutex;
+        std::condition_variable oDone;
+        std::exception_ptr pError;
+    };
+
+    struct Item {
+        Group *pGroup;
+        int nIndex;
+    };
+
+    struct Deque {
+        std::mutex oMutex;
+        std::deque<Item> aItems;
+    };
+
+    int m_nCores;
+    std::vector<std::unique_ptr<Deque>> m_aDeques;
+    std::vector<std::thread> m_aWorkers;
+    std::mutex m_oMutex;
+    std::condition_variable m_oWork;
+    bool m_bStop = false;
+    // tasks waiting in the deques, and tasks being run
+    std::atomic<int> m_nQueued{0};
+    std::atomic<int> m_nRunning{0};
+    std::atomic<unsigned> m_nNextDeque{0};
+    std::atomic<size_t> m_nTasks{0};
+    std::atomic<size_t> m_nSteals{0};
+
+    // The pool whose running slot the thread holds, if any: a worker while
+    // it runs a task, a caller while it helps with its own. A task that
+    // calls ParallelFor again, e.g. an image of a batch split into bands,
+    // works on in the slot it has instead of taking a second one.
+    static WorkStealingPool *&SlotHolder() {
+        static thread_local WorkStealingPool *pHolder = NULL;
+        return pHolder;
+    }
+
+    void Wake(bool bAll) {
+        // the lock orders the change the waiters check with their wait
+        { std::lock_guard<std::mutex> oLock(m_oMutex); }
+        if (bAll) {
+            m_oWork.notify_all();
+        } else {
+            m_oWork.notify_one();
+        }
+    }
+
+    // Claim one of the nCores running slots
+    bool Acquire() {
+        if (m_nRunning.fetch_add(1) < m_nCores) {
+            return true;
+        }
+        m_nRunning--;
+        return false;
+    }
+
+    void Release() {
+        m_nRunning--;
+        if (m_nQueued > 0) {
+            Wake(false);
+        }
+    }
+
+    // Take the newest task of deque nOwn, or else the oldest task of another
+    // deque. A caller (nOwn < 0) only takes tasks of its own pGroup.
+    bool Take(int nOwn, Group *pGroup, Item *pItem) {
+        const int nDeques = static_cast<int>(m_aDeques.size());
+        if (nOwn >= 0) {
+            Deque &rDeque = *m_aDeques[nOwn];
+            std::lock_guard<std::mutex> oLock(rDeque.oMutex);
+            if (!rDeque.aItems.empty()) {
+                *pItem = rDeque.aItems.back();
+                rDeque.aItems.pop_back();
+                m_nQueued--;
+                return true;
+            }
+        }
+        for (int k = 1; k <= nDeques; ++k) {
+            const int nDeque = (std::max(nOwn, 0) + k) % nDeques;
+            if (nDeque == nOwn) {
+                continue;
+            }
+            Deque &rDeque = *m_aDeques[nDeque];
+            std::lock_guard<std::mutex> oLock(rDeque.oMutex);
+            for (auto it = rDeque.aItems.begin(); it != rDeque.aItems.end();
+                 ++it) {
+                if (pGroup == NULL || it->pGroup == pGroup) {
+                    *pItem = *it;
+                    rDeque.aItems.erase(it);
+                    m_nQueued--;
+                    if (nOwn >= 0) {
+                        m_nSteals++;
+                    }
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    static void Run(const Item &rItem) {
+        Group *pGroup = rItem.pGroup;
+        std::exception_ptr pError;
+        try {
+            (*pGroup->pTask)(rItem.nIndex);
+        } catch (...) {
+            pError = std::current_exception();
+        }
+        // the caller may return as soon as the count drops to 0, so the
+        // group is not touched after the lock is released
+        std::lock_guard<std::mutex> oLock(pGroup->oMutex);
+        if (pError && !pGroup->pError) {
+            pGroup->pError = pError;
+        }
+        if (--pGroup->nPending == 0) {
+            pGroup->oDone.notify_all();
+        }
+    }
+
+    void Work(int nSelf) {
+        Item oItem;
+        for (;;) {
+            if (Acquire()) {
+                if (Take(nSelf, NULL, &oItem)) {
+                    SlotHolder() = this;
+                    Run(oItem);
+                    SlotHolder() = NULL;
+                    m_nTasks++;
+                    Release();
+                    continue;
+                }
+                Release();
+            }
+            std::unique_lock<std::mutex> oLock(m_oMutex);
+            m_oWork.wait(oLock, [this] {
+                return m_bStop || (m_nQueued > 0 && m_nRunning < m_nCores);
+            });
+            if (m_bStop) {
+                return;
+            }
+        }
+    }
+
+ public:
+    // nCores running tasks at most, callers included; nCores - 1 workers
+    explicit WorkStealingPool(int nCores) : m_nCores(std::max(nCores, 1)) {
+        for (int i = 0; i < m_nCores - 1; ++i) {
+            m_aDeques.push_back(std::make_unique<Deque>());
+        }
+        for (int i = 0; i < m_nCores - 1; ++i) {
+            m_aWorkers.emplace_back([this, i] { Work(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> oLock(m_oMutex);
+            m_bStop = true;
+        }
+        m_oWork.notify_all();
+        for (std::thread &rWorker : m_aWorkers) {
+            rWorker.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    int Cores() const { return m_nCores; }
+
+    // Run fTask(0) ... fTask(nTasks - 1) and return once all have finished.
+    // The first exception a task throws is rethrown here.
+    void ParallelFor(int nTasks, const std::function<void(int)> &fTask) {
+        if (m_aWorkers.empty() || nTasks <= 1) {
+            for (int i = 0; i < nTasks; ++i) {
+                fTask(i);
+            }
+            m_nTasks += std::max(nTasks, 0);
+            return;
+        }
+        Group oGroup;
+        oGroup.pTask = &fTask;
+        oGroup.nPending = nTasks;
+        // a contiguous run of tasks per deque, starting at another deque for
+        // every call so that concurrent callers spread out
+        const int nDeques = static_cast<int>(m_aDeques.size());
+        const unsigned nFirst = m_nNextDeque++;
+        for (int d = 0; d < nDeques; ++d) {
+            const int nBegin = nTasks * d / nDeques;
+            const int nEnd = nTasks * (d + 1) / nDeques;
+            Deque &rDeque = *m_aDeques[(nFirst + d) % nDeques];
+            std::lock_guard<std::mutex> oLock(rDeque.oMutex);
+            for (int i = nBegin; i < nEnd; ++i) {
+                rDeque.aItems.push_back({&oGroup, i});
+            }
+        }
+        m_nQueued += nTasks;
+        Wake(true);
+
+        // the caller is running already, so it counts against the budget
+        // while it helps, unless it is a task of this pool itself
+        const bool bNested = SlotHolder() == this;
+        if (!bNested) {
+            m_nRunning++;
+            SlotHolder() = this;
+        }
+        Item oItem;
+        while (Take(-1, &oGroup, &oItem)) {
+            Run(oItem);
+            m_nTasks++;
+        }
+        if (!bNested) {
+            SlotHolder() = NULL;
+            Release();
+        }
+
+        std::unique_lock<std::mutex> oLock(oGroup.oMutex);
+        oGroup.oDone.wait(oLock, [&oGroup] { return oGroup.nPending == 0; });
+        if (oGroup.pError) {
+            std::rethrow_exception(oGroup.pError);
+        }
+    }
+
+    // Counters as a JSON member for the summary of the processing log
+    std::string Summary() const {
+        std::ostringstream oJson;
+        oJson << "\"bands\":{\"threads\":" << m_nCores
+              << ",\"tasks\":" << m_nTasks << ",\"steals\":" << m_nSteals
+              << "}";
+        return oJson.str();
+    }
+};
+#endif  //  SRC_WORKSTEALINGPOOL_H_